@@ -19,6 +19,11 @@ extern int32_t ece391_open (const uint8_t* filename);
 extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
+/* Map an open file read-only and store its size in *length; (void*)-1 on failure */
+extern void* ece391_mmap (int32_t fd, uint32_t* length);
+extern int32_t ece391_munmap (void* addr, uint32_t length);
+/* Move the end of the heap, returns the old end or (void*)-1 */
+extern void* ece391_sbrk (int32_t increment);
 
 #endif /* ECE391SYSCALL_H */
 
@@ -18,14 +18,19 @@ uint8_t file1[] = "frame1.txt";
 extern int mp1_ioctl(unsigned long arg, unsigned long cmd);
 extern void mp1_rtc_tasklet(unsigned long trash);
 
-static struct mp1_blink_struct blink_array[80*25];
+/* Blink structs live on the heap, which grows BLINK_CHUNK entries at a time
+ * as the frames need them; the array stays contiguous */
+#define BLINK_CHUNK 64
+static struct mp1_blink_struct *blink_array;
+static int32_t blink_count;
 
 int main(void)
 {
     int rtc_fd, ret_val, i, garbage;
     struct mp1_blink_struct blink_struct;
 
-    ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
+    blink_array = ece391_sbrk(0);
+    blink_count = 0;
 
     if(mp1_set_video_mode() == NULL) {
         return -1;
@@ -75,11 +80,57 @@ int main(void)
     return 0;
 }
 
+/* A frame file, scanned in place when the kernel can map it and read a
+ * byte at a time otherwise */
+struct frame_file {
+    int32_t fd;
+    uint8_t* data;
+    uint32_t len;
+    uint32_t pos;
+};
+
+static int32_t
+frame_open(struct frame_file *f, uint8_t *name)
+{
+    if( (f->fd = ece391_open(name)) < 0 ) {
+        return -1;
+    }
+    f->pos = 0;
+    f->data = ece391_mmap(f->fd, &f->len);
+    if(f->data == (void*)-1) {
+        f->data = 0;
+    }
+    return 0;
+}
+
+static int32_t
+frame_getc(struct frame_file *f, uint8_t *c)
+{
+    if(f->data == 0) {
+        return ece391_read(f->fd, c, 1);
+    }
+    if(f->pos >= f->len) {
+        return 0;
+    }
+    *c = f->data[f->pos++];
+    return 1;
+}
+
+static void
+frame_close(struct frame_file *f)
+{
+    if(f->data != 0) {
+        ece391_munmap(f->data, f->len);
+        f->data = 0;
+    }
+    ece391_close(f->fd);
+}
+
 void
 add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 {
     int32_t row, col, offset = 40, eof0 = 0, eof1 = 0, num_bytes;
-    int32_t fd0, fd1;
+    struct frame_file fd0, fd1;
     struct mp1_blink_struct blink_struct;
     uint8_t c0 = '0', c1 = '0';
 
@@ -88,10 +139,10 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 
     row = 0;
 
-    if( (fd0 = ece391_open(f0)) < 0 ) {
+    if( frame_open(&fd0, f0) < 0 ) {
         ece391_halt(-1);
     }
-    if( (fd1 = ece391_open(f1)) < 0 ) {
+    if( frame_open(&fd1, f1) < 0 ) {
         ece391_halt(-1);
     }
 
@@ -100,7 +151,7 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
         while(1) {
 
             if(c0 != '\n') {
-                num_bytes = ece391_read(fd0, &c0, 1);
+                num_bytes = frame_getc(&fd0, &c0);
                 if(num_bytes == 0) {
                     c0 = '\n';
                     eof0 = 1;
@@ -108,7 +159,7 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
             }
 
             if(c1 != '\n') {
-                num_bytes = ece391_read(fd1, &c1, 1);
+                num_bytes = frame_getc(&fd1, &c1);
                 if(num_bytes == 0) {
                     c1 = '\n';
                     eof1 = 1;
@@ -131,14 +182,14 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 
         if(eof0) {
             c0 = '\n';
-            ece391_close(fd0);
+            frame_close(&fd0);
         } else {
             c0 = '0';
         }
 
         if(eof1) {
             c1 = '\n';
-            ece391_close(fd1);
+            frame_close(&fd1);
         } else {
             c1 = '0';
         }
@@ -160,13 +211,18 @@ mp1_set_video_mode (void)
 void* mp1_malloc(int32_t size)
 {
     int32_t i;
-    for(i=0; i< 80*25; i++) {
+    for(i=0; i< blink_count; i++) {
         if(blink_array[i].location == 0) {
             return &blink_array[i];
         }
     }
 
-    return NULL;
+    /* All in use, the kernel hands out zeroed memory */
+    if(ece391_sbrk(BLINK_CHUNK * sizeof(struct mp1_blink_struct)) == (void*)-1) {
+        return NULL;
+    }
+    blink_count += BLINK_CHUNK;
+    return &blink_array[i];
 }
 
 void mp1_free(void* memory)
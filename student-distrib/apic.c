@@ -0,0 +1,390 @@
+/* apic.c - Functions to detect and program the local APIC and the IOAPIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "i8259.h"
+#include "paging.h"
+#include "lib.h"
+
+/* Physical (identity mapped) addresses of the two controllers */
+static uint32_t lapic_base = LAPIC_DEFAULT_BASE;
+static uint32_t ioapic_base = IOAPIC_DEFAULT_BASE;
+
+/* IOAPIC input pin and redirection flags of each ISA IRQ */
+static uint32_t irq_to_gsi[ISA_IRQ_NUM];
+static uint32_t irq_flags[ISA_IRQ_NUM];
+
+/* Set when the firmware described a usable IOAPIC, and when the IMCR must be switched */
+static uint8_t apic_found;
+static uint8_t imcr_present;
+
+static void* scan_signature(uint32_t start, uint32_t length, const int8_t* sig, uint32_t sig_len, uint32_t check_len);
+static uint8_t table_checksum(const void* addr, uint32_t length);
+static uint16_t bda_read16(uint32_t addr);
+static uint32_t irq_flags_to_redir(uint16_t flags);
+static int32_t madt_parse(void);
+static int32_t mp_parse(void);
+static uint32_t lapic_read(uint32_t reg);
+static void lapic_write(uint32_t reg, uint32_t val);
+static uint32_t ioapic_read(uint32_t reg);
+static void ioapic_write(uint32_t reg, uint32_t val);
+
+/* int32_t apic_detect(void)
+ * Input:  none
+ * Return Value: 0 if an IOAPIC was found, -1 otherwise
+ * Function: Check CPUID for an on-chip local APIC, then look for the IOAPIC and
+ * the ISA IRQ routing in the ACPI MADT, falling back to the MP tables. The tables
+ * are read through physical addresses, so this must run before paging is enabled */
+int32_t apic_detect(void)
+{
+    uint32_t eax, ebx, ecx, edx, i;
+
+    /* ISA IRQs go to the IOAPIC pin of the same number unless a table overrides it */
+    for(i = 0; i < ISA_IRQ_NUM; i++)
+    {
+        irq_to_gsi[i] = i;
+        irq_flags[i] = 0;
+    }
+    apic_cpu_count = 0;
+    apic_found = 0;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if(!(edx & CPUID_EDX_APIC)) return -1;
+
+    if(madt_parse() == 0 || mp_parse() == 0)
+    {
+        apic_found = 1;
+        return 0;
+    }
+    return -1;
+}
+
+/* void apic_init(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Switch interrupt delivery from the PICs to the IOAPIC. Maps both
+ * register blocks, masks the PICs, enables the local APIC, and sets up a masked
+ * redirection entry for every ISA IRQ on its usual vector. Drivers unmask their
+ * lines afterwards through enable_irq, so this must run before any of them */
+void apic_init(void)
+{
+    uint32_t i, max_pin;
+
+    if(!apic_found) return;
+
+    mmio_mapping(lapic_base);
+    mmio_mapping(ioapic_base);
+
+    /* Disconnect the PICs from the processor and mask every line on them */
+    if(imcr_present)
+    {
+        outb(0x70, IMCR_ADDR);      //select the IMCR
+        outb(0x01, IMCR_DATA);      //route INTR and NMI through the APIC
+    }
+    outb(0xFF, MASTER_8259_DATA);
+    outb(0xFF, SLAVE_8259_DATA);
+
+    /* Globally enable the local APIC, accept every priority class, and set the spurious vector */
+    wrmsr(MSR_APIC_BASE, rdmsr(MSR_APIC_BASE) | MSR_APIC_BASE_ENABLE);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VEC);
+
+    /* Mask every redirection entry, then prepare one (still masked) entry per ISA IRQ,
+     * delivered in fixed, physical mode to the boot processor */
+    max_pin = (ioapic_read(IOAPIC_VER) >> 16) & 0xFF;
+    for(i = 0; i <= max_pin; i++)
+    {
+        ioapic_write(IOAPIC_REDTBL + 2*i + 1, 0);
+        ioapic_write(IOAPIC_REDTBL + 2*i, IOAPIC_MASKED);
+    }
+    for(i = 0; i < ISA_IRQ_NUM; i++)
+    {
+        if(i == ISA_CASCADE_IRQ || irq_to_gsi[i] > max_pin) continue;
+        ioapic_write(IOAPIC_REDTBL + 2*irq_to_gsi[i] + 1, lapic_read(LAPIC_ID) & 0xFF000000);
+        ioapic_write(IOAPIC_REDTBL + 2*irq_to_gsi[i], IOAPIC_MASKED | irq_flags[i] | (APIC_IRQ_BASE_VEC + i));
+    }
+
+    apic_enabled = 1;
+}
+
+/* void ioapic_enable_irq(uint32_t irq_num)
+ * Input:  ISA irq line number
+ * Return Value: none
+ * Function: Clear the mask bit of the redirection entry the IRQ is routed to */
+void ioapic_enable_irq(uint32_t irq_num)
+{
+    uint32_t reg;
+
+    if(irq_num >= ISA_IRQ_NUM || irq_num == ISA_CASCADE_IRQ) return;
+    reg = IOAPIC_REDTBL + 2*irq_to_gsi[irq_num];
+    ioapic_write(reg, ioapic_read(reg) & ~IOAPIC_MASKED);
+}
+
+/* void ioapic_disable_irq(uint32_t irq_num)
+ * Input:  ISA irq line number
+ * Return Value: none
+ * Function: Set the mask bit of the redirection entry the IRQ is routed to */
+void ioapic_disable_irq(uint32_t irq_num)
+{
+    uint32_t reg;
+
+    if(irq_num >= ISA_IRQ_NUM || irq_num == ISA_CASCADE_IRQ) return;
+    reg = IOAPIC_REDTBL + 2*irq_to_gsi[irq_num];
+    ioapic_write(reg, ioapic_read(reg) | IOAPIC_MASKED);
+}
+
+/* void lapic_send_eoi(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Acknowledge the highest priority in-service interrupt with a single
+ * MMIO write, replacing the one or two port writes the PICs need */
+void lapic_send_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/************** Helper Functions Are In This Section **************/
+
+/* void* scan_signature(uint32_t start, uint32_t length, const int8_t* sig, uint32_t sig_len, uint32_t check_len)
+ * Input:  start, length -- physical range to search, on 16 byte boundaries
+ *         sig, sig_len -- signature to look for
+ *         check_len -- number of bytes that must checksum to zero
+ * Return Value: address of the structure, NULL if not found
+ * Function: Find a firmware structure by its signature and checksum */
+static void* scan_signature(uint32_t start, uint32_t length, const int8_t* sig, uint32_t sig_len, uint32_t check_len)
+{
+    uint32_t addr;
+
+    for(addr = start; addr + check_len <= start + length; addr += 16)
+    {
+        if(strncmp((const int8_t*)addr, sig, sig_len) == 0 && table_checksum((void*)addr, check_len) == 0)
+            return (void*)addr;
+    }
+    return NULL;
+}
+
+/* uint8_t table_checksum(const void* addr, uint32_t length)
+ * Input:  table address and length
+ * Return Value: byte sum of the table, 0 for a valid table
+ * Function: Checksum used by both the ACPI and MP tables */
+static uint8_t table_checksum(const void* addr, uint32_t length)
+{
+    uint32_t i;
+    uint8_t sum = 0;
+
+    for(i = 0; i < length; i++) sum += ((const uint8_t*)addr)[i];
+    return sum;
+}
+
+/* uint16_t bda_read16(uint32_t addr)
+ * Input:  physical address of a word in the BIOS data area
+ * Return Value: the word
+ * Function: The empty asm hides the constant address from the optimizer,
+ * which otherwise takes a pointer near 0 for an empty object and warns
+ * with -Warray-bounds at -O2 and with LTO */
+static uint16_t bda_read16(uint32_t addr)
+{
+    const volatile uint16_t* word = (const volatile uint16_t*)addr;
+
+    asm("" : "+r"(word));
+    return *word;
+}
+
+/* uint32_t irq_flags_to_redir(uint16_t flags)
+ * Input:  MPS INTI flags, shared by the MADT overrides and MP interrupt entries
+ * Return Value: polarity and trigger bits of a redirection entry
+ * Function: Bus-conforming polarity and trigger mean active high, edge for ISA */
+static uint32_t irq_flags_to_redir(uint16_t flags)
+{
+    uint32_t redir = 0;
+
+    if((flags & MADT_POLARITY_MASK) == MADT_POLARITY_LOW) redir |= IOAPIC_ACTIVE_LOW;
+    if((flags & MADT_TRIGGER_MASK) == MADT_TRIGGER_LEVEL) redir |= IOAPIC_LEVEL;
+    return redir;
+}
+
+/* int32_t madt_parse(void)
+ * Input:  none
+ * Return Value: 0 if the MADT listed an IOAPIC, -1 otherwise
+ * Function: Find the RSDP in the EBDA or the BIOS area, walk the RSDT to the MADT,
+ * and record the processors, the IOAPIC handling GSI 0, and the ISA overrides */
+static int32_t madt_parse(void)
+{
+    acpi_rsdp_t* rsdp;
+    acpi_header_t* rsdt;
+    acpi_header_t* table;
+    acpi_madt_t* madt = NULL;
+    uint8_t* entry;
+    uint8_t* end;
+    uint32_t i, ebda, found = 0;
+
+    ebda = (uint32_t)bda_read16(BDA_EBDA_SEG) << 4;
+    rsdp = NULL;
+    if(ebda != 0) rsdp = scan_signature(ebda, 1024, "RSD PTR ", 8, sizeof(acpi_rsdp_t));
+    if(rsdp == NULL) rsdp = scan_signature(0xE0000, 0x20000, "RSD PTR ", 8, sizeof(acpi_rsdp_t));
+    if(rsdp == NULL) return -1;
+
+    rsdt = (acpi_header_t*)rsdp->rsdt_addr;
+    if(strncmp(rsdt->signature, "RSDT", 4) != 0 || table_checksum(rsdt, rsdt->length) != 0) return -1;
+
+    for(i = 0; i < (rsdt->length - sizeof(acpi_header_t)) / 4; i++)
+    {
+        table = (acpi_header_t*)((uint32_t*)(rsdt + 1))[i];
+        if(strncmp(table->signature, "APIC", 4) == 0 && table_checksum(table, table->length) == 0)
+        {
+            madt = (acpi_madt_t*)table;
+            break;
+        }
+    }
+    if(madt == NULL) return -1;
+
+    lapic_base = madt->lapic_addr;
+    entry = (uint8_t*)(madt + 1);
+    end = (uint8_t*)madt + madt->header.length;
+
+    /* Every entry starts with its type and length */
+    while(entry + 2 <= end && entry[1] >= 2)
+    {
+        switch(entry[0])
+        {
+            case MADT_LAPIC:    /* processor id, APIC id, flags (bit 0 enabled) */
+                if(*(uint32_t*)(entry + 4) & 1) apic_cpu_count++;
+                break;
+            case MADT_IOAPIC:   /* id, reserved, address, GSI base */
+                if(*(uint32_t*)(entry + 8) == 0)
+                {
+                    ioapic_base = *(uint32_t*)(entry + 4);
+                    found = 1;
+                }
+                break;
+            case MADT_ISO:      /* bus, source IRQ, GSI, flags */
+                if(entry[2] == 0 && entry[3] < ISA_IRQ_NUM)
+                {
+                    irq_to_gsi[entry[3]] = *(uint32_t*)(entry + 4);
+                    irq_flags[entry[3]] = irq_flags_to_redir(*(uint16_t*)(entry + 8));
+                }
+                break;
+            default:
+                break;
+        }
+        entry += entry[1];
+    }
+    return found ? 0 : -1;
+}
+
+/* int32_t mp_parse(void)
+ * Input:  none
+ * Return Value: 0 if the MP configuration table listed an IOAPIC, -1 otherwise
+ * Function: Find the MP floating pointer, then record the processors, the first
+ * IOAPIC and the pins the ISA bus IRQs are wired to. The default configurations
+ * without a configuration table are not supported */
+static int32_t mp_parse(void)
+{
+    mp_float_t* mpf;
+    mp_config_t* cfg;
+    uint8_t* entry;
+    uint8_t isa_bus[MP_MAX_BUS];
+    uint32_t i, ebda, base_kb, found = 0;
+
+    ebda = (uint32_t)bda_read16(BDA_EBDA_SEG) << 4;
+    base_kb = bda_read16(BDA_BASE_MEM);
+    mpf = NULL;
+    if(ebda != 0) mpf = scan_signature(ebda, 1024, "_MP_", 4, sizeof(mp_float_t));
+    if(mpf == NULL) mpf = scan_signature(base_kb * 1024 - 1024, 1024, "_MP_", 4, sizeof(mp_float_t));
+    if(mpf == NULL) mpf = scan_signature(0xF0000, 0x10000, "_MP_", 4, sizeof(mp_float_t));
+    if(mpf == NULL || mpf->config_addr == 0) return -1;
+
+    /* Bit 7 of the feature byte says the PICs sit behind the IMCR */
+    imcr_present = (mpf->imcr & 0x80) ? 1 : 0;
+
+    cfg = (mp_config_t*)mpf->config_addr;
+    if(strncmp(cfg->signature, "PCMP", 4) != 0 || table_checksum(cfg, cfg->length) != 0) return -1;
+
+    for(i = 0; i < MP_MAX_BUS; i++) isa_bus[i] = 0;
+
+    lapic_base = cfg->lapic_addr;
+    entry = (uint8_t*)(cfg + 1);
+    for(i = 0; i < cfg->entry_count; i++)
+    {
+        switch(entry[0])
+        {
+            case MP_PROCESSOR:  /* APIC id, version, flags (bit 0 enabled), ... 20 bytes */
+                if(entry[3] & 1) apic_cpu_count++;
+                entry += 20;
+                break;
+            case MP_BUS:        /* bus id, bus type string */
+                if(entry[1] < MP_MAX_BUS)
+                    isa_bus[entry[1]] = (strncmp((int8_t*)entry + 2, "ISA", 3) == 0);
+                entry += 8;
+                break;
+            case MP_IOAPIC:     /* id, version, flags (bit 0 usable), address */
+                if((entry[3] & 1) && !found)
+                {
+                    ioapic_base = *(uint32_t*)(entry + 4);
+                    found = 1;
+                }
+                entry += 8;
+                break;
+            case MP_IOINT:      /* interrupt type, flags, source bus, source IRQ, IOAPIC id, pin */
+                if(entry[1] == 0 && entry[4] < MP_MAX_BUS && isa_bus[entry[4]] && entry[5] < ISA_IRQ_NUM)
+                {
+                    irq_to_gsi[entry[5]] = entry[7];
+                    irq_flags[entry[5]] = irq_flags_to_redir(*(uint16_t*)(entry + 2));
+                }
+                entry += 8;
+                break;
+            default:            /* local interrupt assignments, 8 bytes */
+                entry += 8;
+                break;
+        }
+    }
+    return found ? 0 : -1;
+}
+
+/* uint32_t lapic_read(uint32_t reg)
+ * Input:  register offset
+ * Return Value: register value
+ * Function: Read a local APIC register */
+static uint32_t lapic_read(uint32_t reg)
+{
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+/* void lapic_write(uint32_t reg, uint32_t val)
+ * Input:  register offset and value
+ * Return Value: none
+ * Function: Write a local APIC register */
+static void lapic_write(uint32_t reg, uint32_t val)
+{
+    *(volatile uint32_t*)(lapic_base + reg) = val;
+}
+
+/* uint32_t ioapic_read(uint32_t reg)
+ * Input:  indirect register index
+ * Return Value: register value
+ * Function: Read an IOAPIC register through the select/window pair */
+static uint32_t ioapic_read(uint32_t reg)
+{
+    uint32_t flags, val;
+
+    cli_and_save(flags);
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    val = *(volatile uint32_t*)(ioapic_base + IOAPIC_WIN);
+    restore_flags(flags);
+    return val;
+}
+
+/* void ioapic_write(uint32_t reg, uint32_t val)
+ * Input:  indirect register index and value
+ * Return Value: none
+ * Function: Write an IOAPIC register through the select/window pair */
+static void ioapic_write(uint32_t reg, uint32_t val)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_WIN) = val;
+    restore_flags(flags);
+}
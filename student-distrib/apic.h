@@ -0,0 +1,144 @@
+/* apic.h - Defines used in interactions with the local APIC and the
+ * IOAPIC, and the firmware tables that describe them
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+/* Default physical addresses, replaced by what the MADT/MP tables report */
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+#define IOAPIC_DEFAULT_BASE     0xFEC00000
+
+/* CPUID leaf 1 EDX bit for an on-chip local APIC */
+#define CPUID_EDX_APIC          0x200
+
+/* BIOS data area words holding the EBDA segment and the base memory size in KB */
+#define BDA_EBDA_SEG            0x40E
+#define BDA_BASE_MEM            0x413
+
+/* Local APIC register offsets */
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_SVR_ENABLE        0x100
+
+/* IA32_APIC_BASE MSR and its global enable bit */
+#define MSR_APIC_BASE           0x1B
+#define MSR_APIC_BASE_ENABLE    0x800
+
+/* IOAPIC indirect registers */
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WIN              0x10
+#define IOAPIC_VER              0x01
+#define IOAPIC_REDTBL           0x10
+
+/* Redirection entry bits (low dword) */
+#define IOAPIC_MASKED           0x00010000
+#define IOAPIC_LEVEL            0x00008000
+#define IOAPIC_ACTIVE_LOW       0x00002000
+
+/* ISA IRQs are delivered on vectors 0x20-0x2F, the same vectors the PICs use,
+ * so the IDT does not change when the IOAPIC takes over */
+#define APIC_IRQ_BASE_VEC       0x20
+#define APIC_SPURIOUS_VEC       0xFF
+#define ISA_IRQ_NUM             16
+#define ISA_CASCADE_IRQ         2
+
+/* MADT entry types and interrupt source override flags */
+#define MADT_LAPIC              0
+#define MADT_IOAPIC             1
+#define MADT_ISO                2
+#define MADT_POLARITY_MASK      0x3
+#define MADT_POLARITY_LOW       0x3
+#define MADT_TRIGGER_MASK       0xC
+#define MADT_TRIGGER_LEVEL      0xC
+
+/* MP configuration table entry types */
+#define MP_PROCESSOR            0
+#define MP_BUS                  1
+#define MP_IOAPIC               2
+#define MP_IOINT                3
+#define MP_MAX_BUS              32
+
+/* IMCR ports, used to route the PIC lines away from the BSP's LINT0 */
+#define IMCR_ADDR               0x22
+#define IMCR_DATA               0x23
+
+/* ACPI root system description pointer (version 1 part) */
+typedef struct __attribute__((packed)) {
+    int8_t   signature[8];
+    uint8_t  checksum;
+    int8_t   oem_id[6];
+    uint8_t  revision;
+    uint32_t rsdt_addr;
+} acpi_rsdp_t;
+
+/* Header shared by every ACPI table */
+typedef struct __attribute__((packed)) {
+    int8_t   signature[4];
+    uint32_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    int8_t   oem_id[6];
+    int8_t   oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} acpi_header_t;
+
+/* Multiple APIC description table, followed by variable length entries */
+typedef struct __attribute__((packed)) {
+    acpi_header_t header;
+    uint32_t lapic_addr;
+    uint32_t flags;
+} acpi_madt_t;
+
+/* MP floating pointer structure */
+typedef struct __attribute__((packed)) {
+    int8_t   signature[4];
+    uint32_t config_addr;
+    uint8_t  length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    uint8_t  default_config;
+    uint8_t  imcr;
+} mp_float_t;
+
+/* MP configuration table header, followed by entry_count entries */
+typedef struct __attribute__((packed)) {
+    int8_t   signature[4];
+    uint16_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    int8_t   oem_id[8];
+    int8_t   product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t  ext_checksum;
+    uint8_t  reserved;
+} mp_config_t;
+
+/* Set once apic_init has routed the ISA IRQs through the IOAPIC */
+uint8_t apic_enabled;
+/* Number of enabled processors listed by the firmware */
+uint32_t apic_cpu_count;
+
+/* Look for an IOAPIC in the MADT, then in the MP tables. Must run with paging off */
+int32_t apic_detect(void);
+/* Program the local APIC and IOAPIC and mask both PICs */
+void apic_init(void);
+/* Unmask the IOAPIC entry of an ISA IRQ */
+void ioapic_enable_irq(uint32_t irq_num);
+/* Mask the IOAPIC entry of an ISA IRQ */
+void ioapic_disable_irq(uint32_t irq_num);
+/* Signal end-of-interrupt to the local APIC */
+void lapic_send_eoi(void);
+
+#endif /* _APIC_H */
@@ -0,0 +1,243 @@
+/* buddy.c - Buddy allocator of physical memory, built from the multiboot
+ * memory map, handing out naturally aligned blocks of 4kB to 4MB
+ * vim:ts=4 noexpandtab
+ */
+
+#include "buddy.h"
+#include "paging.h"
+#include "lib.h"
+
+#define BUDDY_FRAMES        (BUDDY_POOL_MAX / FRAME_SIZE)
+#define BLOCK_SIZE(order)   ((uint32_t)FRAME_SIZE << (order))
+
+/* Bit of frame_state set on the first frame of a free block, the low bits
+ * hold the block's order. Every other frame is 0 */
+#define BUDDY_FREE          0x80
+
+/* Struct buddy_block_t, the list links kept inside a free block itself,
+ * reached through the direct map
+ * next, prev : neighbours on the free list of the same order */
+typedef struct buddy_block {
+    struct buddy_block* next;
+    struct buddy_block* prev;
+} buddy_block_t;
+
+/* Struct buddy_region_t, one usable range of the memory map
+ * base, end : first byte and first byte past the range */
+typedef struct {
+    uint32_t base;
+    uint32_t end;
+} buddy_region_t;
+
+/* Struct buddy_stat_t, counters shown by buddyinfo
+ * free : blocks on the free list of each order
+ * allocs, frees : calls of buddy_alloc and buddy_free for each order
+ * fails : buddy_alloc calls with nothing large enough
+ * splits, merges : blocks halved by buddy_alloc and joined by buddy_free */
+typedef struct {
+    uint32_t free[BUDDY_ORDERS];
+    uint32_t allocs[BUDDY_ORDERS];
+    uint32_t frees[BUDDY_ORDERS];
+    uint32_t fails;
+    uint32_t splits;
+    uint32_t merges;
+} buddy_stat_t;
+
+static buddy_block_t* free_list[BUDDY_ORDERS];
+static uint8_t frame_state[BUDDY_FRAMES];
+static buddy_region_t regions[BUDDY_REGION_MAX];
+static uint32_t region_count;
+static buddy_stat_t buddy_stat;
+
+static void list_push(uint32_t addr, uint32_t order);
+static void list_remove(uint32_t addr, uint32_t order);
+static void block_free(uint32_t addr, uint32_t order);
+
+/* void buddy_add_region(uint32_t base, uint32_t len)
+ * Input:  base, len -- a range the memory map marks as usable RAM
+ * Return Value: none
+ * Function: Keep the range for buddy_init. Runs before paging, while the
+ * blocks cannot be written yet. Ranges past BUDDY_POOL_MAX are cut off */
+void buddy_add_region(uint32_t base, uint32_t len)
+{
+    uint32_t end = base + len;
+
+    if(end < base || end > BUDDY_POOL_MAX) end = BUDDY_POOL_MAX;
+    if(base >= end || region_count == BUDDY_REGION_MAX) return;
+
+    regions[region_count].base = base;
+    regions[region_count].end = end;
+    region_count++;
+}
+
+/* void buddy_init(uint32_t reserved_end)
+ * Input:  reserved_end -- everything below belongs to the kernel: its 4MB
+ *                         page, the PCBs and the filesystem image
+ * Return Value: none
+ * Function: Free each recorded range above reserved_end as the largest
+ * aligned blocks that fit. Needs the direct map, the free list links live in
+ * the blocks */
+void buddy_init(uint32_t reserved_end)
+{
+    uint32_t i, addr, end, order;
+
+    frames_free = 0;
+    for(i = 0; i < region_count; i++)
+    {
+        addr = (regions[i].base + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+        end = regions[i].end & ~(FRAME_SIZE - 1);
+        if(addr < reserved_end) addr = reserved_end;
+
+        while(addr < end)
+        {
+            for(order = BUDDY_MAX_ORDER; order > 0; order--)
+            {
+                if(!(addr & (BLOCK_SIZE(order) - 1)) && addr + BLOCK_SIZE(order) <= end) break;
+            }
+            block_free(addr, order);
+            addr += BLOCK_SIZE(order);
+        }
+    }
+
+    /* Joining the blocks of neighbouring ranges is not a real merge */
+    buddy_stat.merges = 0;
+}
+
+/* uint32_t buddy_alloc(uint32_t order)
+ * Input:  order -- the block is FRAME_SIZE << order bytes
+ * Return Value: physical address of the block, 0 if none is free
+ * Function: Take a block from the smallest nonempty list of at least this
+ * order, splitting it in halves and freeing the upper ones until it fits */
+uint32_t buddy_alloc(uint32_t order)
+{
+    uint32_t flags;
+    uint32_t o, addr;
+
+    if(order > BUDDY_MAX_ORDER) return 0;
+
+    cli_and_save(flags);
+    for(o = order; o <= BUDDY_MAX_ORDER && free_list[o] == NULL; o++);
+    if(o > BUDDY_MAX_ORDER)
+    {
+        buddy_stat.fails++;
+        restore_flags(flags);
+        return 0;
+    }
+
+    addr = (uint32_t)free_list[o] - PHYS_MAP_BASE;
+    list_remove(addr, o);
+    while(o > order)
+    {
+        o--;
+        list_push(addr + BLOCK_SIZE(o), o);
+        buddy_stat.splits++;
+    }
+
+    frames_free -= 1 << order;
+    buddy_stat.allocs[order]++;
+    restore_flags(flags);
+    return addr;
+}
+
+/* void buddy_free(uint32_t addr, uint32_t order)
+ * Input:  addr -- block from buddy_alloc
+ *         order -- order it was allocated with
+ * Return Value: none
+ * Function: Put the block back, joining it with its buddy as long as the
+ * buddy is free too */
+void buddy_free(uint32_t addr, uint32_t order)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    buddy_stat.frees[order]++;
+    block_free(addr, order);
+    restore_flags(flags);
+}
+
+/* void buddyinfo_show(special_buf_t* b)
+ * Input:  b -- buffer to fill
+ * Return Value: none
+ * Function: One line per order with the block size, free blocks, and the
+ * allocations and frees, then the totals */
+void buddyinfo_show(special_buf_t* b)
+{
+    uint32_t order;
+
+    special_puts(b, "order   size   free  allocs   frees\n");
+    for(order = 0; order <= BUDDY_MAX_ORDER; order++)
+    {
+        special_putu(b, order, 5);
+        special_putu(b, BLOCK_SIZE(order) >> 10, 6);
+        special_puts(b, "K");
+        special_putu(b, buddy_stat.free[order], 7);
+        special_putu(b, buddy_stat.allocs[order], 8);
+        special_putu(b, buddy_stat.frees[order], 8);
+        special_puts(b, "\n");
+    }
+    special_puts(b, "free frames: ");
+    special_putu(b, frames_free, 0);
+    special_puts(b, "\nsplits: ");
+    special_putu(b, buddy_stat.splits, 0);
+    special_puts(b, "  merges: ");
+    special_putu(b, buddy_stat.merges, 0);
+    special_puts(b, "  fails: ");
+    special_putu(b, buddy_stat.fails, 0);
+    special_puts(b, "\n");
+}
+
+/* void block_free(uint32_t addr, uint32_t order)
+ * Input:  addr, order -- block to free
+ * Return Value: none
+ * Function: Merge with free buddies of the same order, then push the
+ * result. The caller has interrupts off */
+static void block_free(uint32_t addr, uint32_t order)
+{
+    uint32_t buddy;
+
+    frames_free += 1 << order;
+    while(order < BUDDY_MAX_ORDER)
+    {
+        buddy = addr ^ BLOCK_SIZE(order);
+        if(buddy >= BUDDY_POOL_MAX || frame_state[buddy / FRAME_SIZE] != (BUDDY_FREE | order)) break;
+
+        list_remove(buddy, order);
+        if(buddy < addr) addr = buddy;
+        order++;
+        buddy_stat.merges++;
+    }
+    list_push(addr, order);
+}
+
+/* void list_push(uint32_t addr, uint32_t order)
+ * Input:  addr, order -- free block
+ * Return Value: none
+ * Function: Put the block at the head of its free list and mark it free */
+static void list_push(uint32_t addr, uint32_t order)
+{
+    buddy_block_t* block = phys_to_virt(addr);
+
+    block->prev = NULL;
+    block->next = free_list[order];
+    if(block->next != NULL) block->next->prev = block;
+    free_list[order] = block;
+
+    frame_state[addr / FRAME_SIZE] = BUDDY_FREE | order;
+    buddy_stat.free[order]++;
+}
+
+/* void list_remove(uint32_t addr, uint32_t order)
+ * Input:  addr, order -- block on the free list of this order
+ * Return Value: none
+ * Function: Unlink the block and mark it in use */
+static void list_remove(uint32_t addr, uint32_t order)
+{
+    buddy_block_t* block = phys_to_virt(addr);
+
+    if(block->prev != NULL) block->prev->next = block->next;
+    else free_list[order] = block->next;
+    if(block->next != NULL) block->next->prev = block->prev;
+
+    frame_state[addr / FRAME_SIZE] = 0;
+    buddy_stat.free[order]--;
+}
@@ -0,0 +1,41 @@
+/* buddy.h - Defines for the buddy allocator of physical memory
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BUDDY_H
+#define _BUDDY_H
+
+#include "types.h"
+#include "special_file.h"
+
+#define FRAME_SIZE          0x1000      /* 4kB */
+#define FRAME_LARGE_SIZE    0x400000    /* 4MB, one PSE page */
+#define FRAME_LARGE_PAGES   (FRAME_LARGE_SIZE / FRAME_SIZE)
+
+/* Blocks are FRAME_SIZE << order bytes, order 0 is 4kB and the largest
+ * order is one 4MB PSE page */
+#define BUDDY_MAX_ORDER     10
+#define BUDDY_ORDERS        (BUDDY_MAX_ORDER + 1)
+#define BUDDY_LARGE_ORDER   BUDDY_MAX_ORDER
+
+/* Nothing past 512MB is managed, that is where the direct map stops */
+#define BUDDY_POOL_MAX      0x20000000
+
+/* Most usable ranges kept from the multiboot memory map */
+#define BUDDY_REGION_MAX    16
+
+/* Number of free 4kB frames in the pool */
+uint32_t frames_free;
+
+/* Record a usable range of physical memory, before buddy_init */
+void buddy_add_region(uint32_t base, uint32_t len);
+/* Free every recorded range above reserved_end into the allocator */
+void buddy_init(uint32_t reserved_end);
+/* A naturally aligned block of FRAME_SIZE << order bytes, 0 if none is free */
+uint32_t buddy_alloc(uint32_t order);
+/* Give back a block from buddy_alloc of the same order */
+void buddy_free(uint32_t addr, uint32_t order);
+/* Special file "buddyinfo": free lists and counters per order */
+void buddyinfo_show(special_buf_t* b);
+
+#endif /* _BUDDY_H */
@@ -0,0 +1,171 @@
+/* elf.c - ELF32 executables: header checks and mapping of the PT_LOAD
+ * segments, sharing their pages with the filesystem image where possible
+ * vim:ts=4 noexpandtab
+ */
+
+#include "elf.h"
+#include "file_system.h"
+#include "paging.h"
+#include "lib.h"
+
+#define PAGE_UP(addr)   (((addr) + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1))
+#define PAGE_DOWN(addr) ((addr) & ~(FRAME_SIZE - 1))
+
+static int32_t elf_map_page(uint32_t pcb_number, const elf_image_t* img, const elf_phdr_t* ph, uint32_t page);
+
+/* int32_t elf_check(uint32_t inode, elf_image_t* img)
+ * Input:  inode -- file to run
+ *         img -- filled in with what elf_map needs
+ * Return Value: 0 if it is an executable we can run, -1 otherwise
+ * Function: Check the file header, then keep each PT_LOAD segment after
+ * checking it lies in the program region and inside the file. The entry
+ * point has to be in an executable segment.
+ * Images made by elfconvert are still taken: every segment sits at its
+ * distance from ELF_FLAT_BASE, with .bss stored as zeros, and the program
+ * headers kept from the original file no longer give the right offsets.
+ * Such a file ends exactly where its last segment ends in memory, which
+ * a real executable, having section headers after its segments, never does */
+int32_t elf_check(uint32_t inode, elf_image_t* img)
+{
+    elf_ehdr_t eh;
+    elf_phdr_t load;
+    elf_phdr_t* ph;
+    uint32_t lowest = 0xFFFFFFFF, top = 0;
+    uint32_t i, flat, entry_ok = 0;
+
+    img->inode = inode;
+    img->size = inodeblk[inode].size;
+    img->nload = 0;
+
+    if(read_data(inode, 0, (uint8_t*)&eh, sizeof(elf_ehdr_t)) != sizeof(elf_ehdr_t)) return -1;
+    if(*(uint32_t*)eh.e_ident != ELF_MAGIC) return -1;
+    if(eh.e_ident[EI_CLASS] != ELFCLASS32 || eh.e_ident[EI_DATA] != ELFDATA2LSB) return -1;
+    if(eh.e_type != ET_EXEC || eh.e_machine != EM_386) return -1;
+    if(eh.e_phentsize != sizeof(elf_phdr_t)) return -1;
+
+    if(eh.e_phoff > img->size || eh.e_phnum * sizeof(elf_phdr_t) > img->size - eh.e_phoff) return -1;
+    for(i = 0; i < eh.e_phnum; i++)
+    {
+        if(read_data(inode, eh.e_phoff + i * sizeof(elf_phdr_t), (uint8_t*)&load, sizeof(elf_phdr_t)) != sizeof(elf_phdr_t)) return -1;
+        if(load.p_type != PT_LOAD || load.p_memsz == 0) continue;
+
+        if(img->nload == ELF_LOAD_MAX) return -1;
+        if(load.p_filesz > load.p_memsz || load.p_vaddr < USER_VIRTUAL_START) return -1;
+        if(load.p_vaddr + load.p_memsz < load.p_vaddr || load.p_vaddr + load.p_memsz > HEAP_END) return -1;
+
+        if(load.p_vaddr < lowest) lowest = load.p_vaddr;
+        if(load.p_vaddr + load.p_memsz > top) top = load.p_vaddr + load.p_memsz;
+        img->load[img->nload++] = load;
+    }
+    if(img->nload == 0) return -1;
+
+    flat = (lowest == ELF_FLAT_BASE && img->size == top - ELF_FLAT_BASE);
+    for(i = 0; i < img->nload; i++)
+    {
+        ph = &img->load[i];
+        if(flat) ph->p_offset = ph->p_vaddr - ELF_FLAT_BASE;
+        if(ph->p_offset + ph->p_filesz < ph->p_offset || ph->p_offset + ph->p_filesz > img->size) return -1;
+        if((ph->p_flags & PF_X) && eh.e_entry >= ph->p_vaddr && eh.e_entry < ph->p_vaddr + ph->p_memsz) entry_ok = 1;
+    }
+    if(!entry_ok) return -1;
+
+    img->entry = eh.e_entry;
+    img->heap_start = PAGE_UP(top);
+    return 0;
+}
+
+/* int32_t elf_map(uint32_t pcb_number, const elf_image_t* img)
+ * Input:  pcb_number -- process with a page directory from user_dir_init
+ *         img -- from elf_check
+ * Return Value: 0 on success, -1 if the file is not all in the image or
+ *               memory ran out. The caller releases the directory
+ * Function: Map every page holding file data of a segment. Pages of .bss
+ * past the file data are left to be filled with zeros on first touch. The
+ * caller flushes, user_dir_switch does */
+int32_t elf_map(uint32_t pcb_number, const elf_image_t* img)
+{
+    const elf_phdr_t* ph;
+    uint32_t i, page;
+
+    for(i = 0; i < img->nload; i++)
+    {
+        ph = &img->load[i];
+        for(page = PAGE_DOWN(ph->p_vaddr); page < ph->p_vaddr + ph->p_filesz; page += FRAME_SIZE)
+        {
+            if(elf_map_page(pcb_number, img, ph, page) == -1) return -1;
+        }
+    }
+    return 0;
+}
+
+/* int32_t elf_map_page(uint32_t pcb_number, const elf_image_t* img, const elf_phdr_t* ph, uint32_t page)
+ * Input:  pcb_number -- process being loaded
+ *         img -- the executable
+ *         ph -- segment with file data in the page
+ *         page -- user page to map
+ * Return Value: 0 on success, -1 on failure
+ * Function: A page lined up with a block of the file, with no .bss in it,
+ * runs in place from the filesystem image: copied on the first write in a
+ * writable segment, and read only for good otherwise. Any other page gets
+ * a private frame with the segment's file bytes read in and its .bss
+ * cleared. A page two segments share is writable if either one is. There
+ * is no execute permission to give, 32-bit paging without PAE has no NX bit */
+static int32_t elf_map_page(uint32_t pcb_number, const elf_image_t* img, const elf_phdr_t* ph, uint32_t page)
+{
+    uint32_t file_end = ph->p_vaddr + ph->p_filesz;
+    uint32_t mem_end = ph->p_vaddr + ph->p_memsz;
+    uint32_t lo = (ph->p_vaddr > page) ? ph->p_vaddr : page;
+    uint32_t hi = (file_end < page + FRAME_SIZE) ? file_end : page + FRAME_SIZE;
+    uint32_t zero_end = (mem_end < page + FRAME_SIZE) ? mem_end : page + FRAME_SIZE;
+    uint32_t writable = ph->p_flags & PF_W;
+    uint32_t* entry;
+    uint32_t old, frame = 0;
+    uint8_t* mem;
+
+    entry = user_pte(pcb_number, page, 1);
+    if(entry == NULL) return -1;
+    old = *entry;
+
+    if(((ph->p_offset ^ ph->p_vaddr) & (FRAME_SIZE - 1)) == 0 && zero_end == hi)
+    {
+        frame = file_block_addr(img->inode, (ph->p_offset - (ph->p_vaddr - page)) / FRAME_SIZE);
+        if(frame == 0) return -1;
+
+        if(!(old & 0x1))
+        {
+            if(writable) return user_tab_xip(pcb_number, page, frame);
+            return user_tab_shared(pcb_number, page, frame);
+        }
+        if(!(old & PTE_ANON) && (old & 0xFFFFF000) == frame)
+        {
+            if(writable) *entry = old | PTE_XIP;
+            return 0;
+        }
+    }
+
+    /* Private frame: a new zeroed one, or a copy of the page mapped already */
+    if(!(old & 0x1))
+    {
+        if(anon_page_map(entry) == -1) return -1;
+    }
+    else if(!(old & PTE_ANON))
+    {
+        frame = buddy_alloc(0);
+        if(frame == 0) return -1;
+        memcpy(phys_to_virt(frame), phys_to_virt(old & 0xFFFFF000), FRAME_SIZE);
+        *entry = frame | PTE_ANON | 0x7;
+        if(old & PTE_XIP) writable = 1;
+    }
+    else if(old & 0x2)
+    {
+        writable = 1;
+    }
+
+    mem = phys_to_virt(*entry & 0xFFFFF000);
+    if(read_data(img->inode, ph->p_offset + (lo - ph->p_vaddr), mem + (lo - page), hi - lo) != (int32_t)(hi - lo)) return -1;
+    if(zero_end > hi) memset(mem + (hi - page), 0, zero_end - hi);
+
+    /* Or with 0x02 gives the user write access */
+    *entry = (*entry & ~0x2) | (writable ? 0x2 : 0);
+    return 0;
+}
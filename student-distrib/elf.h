@@ -0,0 +1,83 @@
+/* elf.h - Defines for loading ELF32 executables from the filesystem image
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+
+/* e_ident: magic, 32-bit, little endian */
+#define ELF_MAGIC           0x464C457F  /* "\x7fELF" read as a uint32_t */
+#define ELFCLASS32          1
+#define ELFDATA2LSB         1
+#define EI_CLASS            4
+#define EI_DATA             5
+#define EI_NIDENT           16
+
+#define ET_EXEC             2
+#define EM_386              3
+
+/* p_type of a segment to load, and p_flags */
+#define PT_LOAD             1
+#define PF_X                0x1
+#define PF_W                0x2
+#define PF_R                0x4
+
+/* Most PT_LOAD segments an executable may have */
+#define ELF_LOAD_MAX        8
+
+/* Where elfconvert's flat images start, the first byte of the file */
+#define ELF_FLAT_BASE       0x08048000
+
+/* Struct elf_ehdr_t, the ELF file header */
+typedef struct {
+    uint8_t e_ident[EI_NIDENT];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf_ehdr_t;
+
+/* Struct elf_phdr_t, one program header */
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} elf_phdr_t;
+
+/* Struct elf_image_t, what elf_check learns about an executable
+ * inode, size : its file
+ * entry : first instruction
+ * heap_start : first page past every segment, .bss included
+ * nload : number of PT_LOAD segments
+ * load : those segments, p_offset already pointing at their data */
+typedef struct {
+    uint32_t inode;
+    uint32_t size;
+    uint32_t entry;
+    uint32_t heap_start;
+    uint32_t nload;
+    elf_phdr_t load[ELF_LOAD_MAX];
+} elf_image_t;
+
+/* Read and check the headers of an executable, -1 if it is not one we can run */
+int32_t elf_check(uint32_t inode, elf_image_t* img);
+/* Map the segments into a process's fresh page directory, -1 if memory ran out */
+int32_t elf_map(uint32_t pcb_number, const elf_image_t* img);
+
+#endif /* _ELF_H */
@@ -2,6 +2,7 @@
 #include "lib.h"
 #include "x86_desc.h"
 #include "types.h"
+#include "paging.h"
 
 uint32_t dentry_number = 0;
 uint32_t inode_number = 0;
@@ -53,24 +54,22 @@ int32_t fs_init (uint32_t fs_start_addr, uint32_t fs_end_addr)
 int32_t read_dentry_by_name (const int8_t* fname, dentry_t* dentry)
 {
 
-    int index, f1_length, f2_length;
+    int index, f1_length;
 
     /* Check for invalid filename and dentry */
     if(fname == NULL || dentry == NULL) return -1;
 
+    /* Names are at most 32 bytes, those of exactly 32 have no NULL */
     f1_length = strlen(fname);
-    for(index = 0; index < MAX_FILE_DENTRIES; index++){ 
+    if(f1_length == 0 || f1_length > MAX_FILENAME_LENGTH) return -1;
 
-        /* Get length of the second file and truncate to 32 if exceeding maximum file length */
-        f2_length = strlen(fs_dentry[index].filename);
-        if(f2_length >= MAX_FILENAME_LENGTH) f2_length = MAX_FILENAME_LENGTH;
+    for(index = 0; index < MAX_FILE_DENTRIES; index++){ 
 
-        /* Compare names of the two files */
-        if(strncmp((fs_dentry[index].filename), (fname), f1_length) == 0 
-        && strncmp((fs_dentry[index].filename), (fname), f2_length) == 0
-        && fname[0] != '\0') 
+        /* Compare names of the two files. One strncmp over the 32 bytes of
+         * the dentry name stops at its NULL, where fname must end too */
+        if(strncmp((fs_dentry[index].filename), (fname), MAX_FILENAME_LENGTH) == 0)
         {
-            strcpy(dentry->filename, fs_dentry[index].filename);
+            strncpy(dentry->filename, fs_dentry[index].filename, MAX_FILENAME_LENGTH);
 			dentry->filetype = fs_dentry[index].filetype;
 			dentry->inode = fs_dentry[index].inode;
 			return 0;
@@ -151,6 +150,20 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t * buf, uint32_t leng
     return copied_bytes_done;
 }
 
+/*
+ * uint32_t file_block_addr (uint32_t inode, uint32_t blk)
+ * Input: inode : inode of the file
+ *        blk : index of the block within the file
+ * Return value : physical address of the data block in the filesystem image,
+ *                0 if the inode points outside the image
+ * Function: Locate a file's data in place. The image is a page aligned
+ * module, so every data block is a whole 4kB frame that can be mapped */
+uint32_t file_block_addr (uint32_t inode, uint32_t blk)
+{
+    if(blk >= DATA_BLK || inodeblk[inode].data_blocks[blk] >= bootblk.num_datablocks) return 0;
+    return virt_to_phys(first_datablk + inodeblk[inode].data_blocks[blk] * FS_BLOCK_SIZE);
+}
+
 /*
  * int32_t file_open (const uint8_t* file_name)
  * Inputs : file name
@@ -196,6 +209,42 @@ int32_t file_write (int32_t fd, const void* buf, int32_t nbytes)
 	return -1; 
 }
 
+/*
+ * int32_t file_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Inputs : fd: file descriptor
+ *          iov : the buffers to fill, in order
+ *          iovcnt : number of buffers
+ * Return value : total bytes read, -1 if the first read fails
+ * Function: read consecutive file data into several buffers, stopping at
+ * end of file */
+int32_t file_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    pcb_t* curr_pcb = get_cur_pcb();
+    uint32_t inode = curr_pcb->fds[fd].inode;
+    int32_t i, cnt, total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        cnt = read_data(inode, curr_pcb->fds[fd].file_position, (uint8_t*)iov[i].base, iov[i].len);
+        if (cnt < 0) return (total == 0) ? -1 : total;
+        curr_pcb->fds[fd].file_position += cnt;
+        total += cnt;
+        if (cnt < (int32_t)iov[i].len) break;
+    }
+    return total;
+}
+
+/*
+ * int32_t file_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Inputs : fd: file descriptor
+ *          iov : the buffers to write
+ *          iovcnt : number of buffers
+ * Return value : -1 (always FAIL, the file system is read only)
+ * Function: write file */
+int32_t file_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+	return -1;
+}
+
 /*
  * int32_t file_close (int32_t fd)
  * Inputs : fd :file descriptor
@@ -3,6 +3,7 @@
 
 #include "lib.h"
 #include "types.h"
+#include "iovec.h"
 #include "paging.h"
 #include "system_call.h"
 
@@ -59,12 +60,15 @@ int32_t fs_init (uint32_t fs_start_addr, uint32_t fs_end_addr);
 
 int32_t read_dentry_by_name (const int8_t* fname, dentry_t* dentry);
 int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
+uint32_t file_block_addr (uint32_t inode, uint32_t blk);
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t * buf, uint32_t length);
 
 int32_t file_open (const uint8_t* file_name);
 int32_t file_read (int32_t fd, void* buf, int32_t nbytes);
 int32_t file_write (int32_t fd, const void* buf, int32_t nbytes);
 int32_t file_close (int32_t fd);
+int32_t file_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t file_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
 
 int32_t dir_open (const uint8_t* file_name);
 int32_t dir_read (int32_t fd, void* buf, int32_t nbytes);
@@ -0,0 +1,225 @@
+/* fpu.c - Lazy switching of the x87 FPU and SSE registers. A switch only
+ * sets CR0.TS, the registers are saved and loaded in the #NM handler when
+ * a process touches them, so processes that never do pay nothing
+ * vim:ts=4 noexpandtab
+ */
+
+#include "fpu.h"
+#include "lib.h"
+#include "slab.h"
+#include "system_call.h"
+#include "idt.h"
+
+/* Offsets in a clean saved state. FXSAVE: control word, abridged tag word
+ * (0 is all empty) and MXCSR. FNSAVE: control word and full tag word */
+#define FX_FCW              0
+#define FX_FTW              4
+#define FX_MXCSR            24
+#define FN_FCW              0
+#define FN_FTW              8
+
+#define FCW_DEFAULT         0x037F      /* every exception masked, extended precision */
+#define MXCSR_DEFAULT       0x1F80      /* every exception masked, round to nearest */
+
+/* PCB number of the process whose state is in the registers */
+static int32_t fpu_owner = FPU_NO_OWNER;
+
+/* Set between kernel_fpu_begin and kernel_fpu_end. Interrupts are off
+ * there, but a page fault on the buffer can still run a copy of its own,
+ * which must leave the registers of the interrupted loop alone */
+static volatile uint8_t kernel_fpu_active;
+
+/* Set when the CPU has FXSAVE/FXRSTOR, FNSAVE/FRSTOR otherwise */
+static uint8_t fpu_fxsr;
+
+/* What a process sees on its first FPU instruction: FNINIT defaults,
+ * zeroed registers */
+static uint8_t fpu_init_state[FPU_STATE_SIZE] __attribute__((aligned (16)));
+
+static void fpu_save(uint8_t* state);
+static void fpu_restore(uint8_t* state);
+
+/* Clear and set CR0.TS */
+#define clts()  asm volatile("clts" : : : "memory")
+#define stts()                              \
+do {                                        \
+    uint32_t cr0;                           \
+    asm volatile("movl %%cr0, %0" : "=r"(cr0)); \
+    asm volatile("movl %0, %%cr0" : : "r"(cr0 | CR0_TS) : "memory"); \
+} while (0)
+
+/* void fpu_init(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Let FPU instructions run natively, with errors reported through
+ * #MF, and turn on SSE when the CPU has FXSR and SSE. Builds the clean state
+ * new users start from, then sets CR0.TS so the first use traps */
+void fpu_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t cr0, cr4;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    fpu_fxsr = (edx & CPUID_EDX_FXSR) ? 1 : 0;
+
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+    asm volatile("movl %0, %%cr0" : : "r"(cr0) : "memory");
+
+    if(fpu_fxsr)
+    {
+        asm volatile("movl %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR;
+        if(edx & CPUID_EDX_SSE) cr4 |= CR4_OSXMMEXCPT;
+        asm volatile("movl %0, %%cr4" : : "r"(cr4) : "memory");
+    }
+    asm volatile("fninit");
+
+    memset(fpu_init_state, 0, FPU_STATE_SIZE);
+    if(fpu_fxsr)
+    {
+        *(uint16_t*)(fpu_init_state + FX_FCW) = FCW_DEFAULT;
+        *(uint32_t*)(fpu_init_state + FX_MXCSR) = (edx & CPUID_EDX_SSE) ? MXCSR_DEFAULT : 0;
+    }
+    else
+    {
+        *(uint32_t*)(fpu_init_state + FN_FCW) = FCW_DEFAULT;
+        *(uint32_t*)(fpu_init_state + FN_FTW) = 0xFFFF;
+    }
+
+    fpu_owner = FPU_NO_OWNER;
+    stts();
+}
+
+/* void fpu_switch(uint32_t pcb_number)
+ * Input:  pcb_number -- process about to run
+ * Return Value: none
+ * Function: Nothing is saved here. If the registers still hold this
+ * process's state it runs with TS clear, otherwise TS is set and its first
+ * FPU or SSE instruction raises #NM */
+void fpu_switch(uint32_t pcb_number)
+{
+    if(fpu_owner == (int32_t)pcb_number) clts();
+    else stts();
+}
+
+/* void fpu_release(uint32_t pcb_number)
+ * Input:  pcb_number -- process that is halting
+ * Return Value: none
+ * Function: Forget the registers if they are its, there is nothing left
+ * to save them for, and free its saved state. A fault inside a kernel FPU
+ * section that kills the process never reaches kernel_fpu_end, so that
+ * section is closed here too */
+void fpu_release(uint32_t pcb_number)
+{
+    pcb_t* pcb = get_pcb_from_id(pcb_number);
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(kernel_fpu_active)
+    {
+        kernel_fpu_active = 0;
+        stts();
+    }
+    if(fpu_owner == (int32_t)pcb_number) fpu_owner = FPU_NO_OWNER;
+    kfree(pcb->fpu_state);
+    pcb->fpu_state = NULL;
+    restore_flags(flags);
+}
+
+/* void fpu_nm_handler(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Called from the #NM stub with interrupts off. Save the owner's
+ * registers, load the running process's, which start out clean on first
+ * use, and make it the owner. A process whose state cannot be allocated is
+ * halted like any other faulting program */
+void fpu_nm_handler(void)
+{
+    pcb_t* pcb = get_cur_pcb();
+
+    clts();
+    if(fpu_owner == pcb->process_number) return;
+
+    if(pcb->fpu_state == NULL)
+    {
+        pcb->fpu_state = kmalloc(FPU_STATE_SIZE);
+        if(pcb->fpu_state == NULL)
+        {
+            /* Set interrupt flag to 1 for halt return 256 */
+            interrupt_halt_flag = 1;
+            printf("Device Not Available Exception\n");
+            halt(0);
+        }
+        memcpy(pcb->fpu_state, fpu_init_state, FPU_STATE_SIZE);
+    }
+
+    if(fpu_owner != FPU_NO_OWNER) fpu_save(get_pcb_from_id(fpu_owner)->fpu_state);
+    fpu_restore(pcb->fpu_state);
+    fpu_owner = pcb->process_number;
+}
+
+/* uint32_t kernel_fpu_begin(void)
+ * Input:  none
+ * Return Value: the flags to hand to kernel_fpu_end
+ * Function: Turn interrupts off so nothing else can run on the registers,
+ * clear TS, and save the owner's registers since the kernel is about to
+ * overwrite them. The owner then reloads them through #NM like after any
+ * other switch */
+uint32_t kernel_fpu_begin(void)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    clts();
+    if(fpu_owner != FPU_NO_OWNER)
+    {
+        fpu_save(get_pcb_from_id(fpu_owner)->fpu_state);
+        fpu_owner = FPU_NO_OWNER;
+    }
+    kernel_fpu_active = 1;
+    return flags;
+}
+
+/* uint32_t kernel_fpu_busy(void)
+ * Input:  none
+ * Return Value: 1 inside a kernel FPU section, 0 otherwise
+ * Function: Lets code that may run nested in one, from a page fault on
+ * its buffer, keep off the registers */
+uint32_t kernel_fpu_busy(void)
+{
+    return kernel_fpu_active;
+}
+
+/* void kernel_fpu_end(uint32_t flags)
+ * Input:  flags -- from kernel_fpu_begin
+ * Return Value: none
+ * Function: Set TS again, the registers hold nobody's state now, and
+ * restore the interrupt flag */
+void kernel_fpu_end(uint32_t flags)
+{
+    kernel_fpu_active = 0;
+    stts();
+    restore_flags(flags);
+}
+
+/* void fpu_save(uint8_t* state)
+ * Input:  state -- FPU_STATE_SIZE bytes, 16 byte aligned
+ * Return Value: none
+ * Function: Store the registers. FNSAVE also reinitializes the FPU, which
+ * does not matter since a restore follows */
+static void fpu_save(uint8_t* state)
+{
+    if(fpu_fxsr) asm volatile("fxsave (%0)" : : "r"(state) : "memory");
+    else asm volatile("fnsave (%0)" : : "r"(state) : "memory");
+}
+
+/* void fpu_restore(uint8_t* state)
+ * Input:  state -- from fpu_save or fpu_init_state
+ * Return Value: none
+ * Function: Load the registers */
+static void fpu_restore(uint8_t* state)
+{
+    if(fpu_fxsr) asm volatile("fxrstor (%0)" : : "r"(state) : "memory");
+    else asm volatile("frstor (%0)" : : "r"(state) : "memory");
+}
@@ -0,0 +1,46 @@
+/* fpu.h - Defines for lazy switching of the x87 FPU and SSE registers
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+
+/* Bytes of one saved register state, the FXSAVE layout. The FNSAVE layout
+ * used without FXSR is 108 bytes and fits too. kmalloc gives it the 16 byte
+ * alignment FXSAVE needs */
+#define FPU_STATE_SIZE      512
+
+/* CPUID leaf 1 EDX bits */
+#define CPUID_EDX_FXSR      0x1000000
+#define CPUID_EDX_SSE       0x2000000
+
+/* CR0 and CR4 bits the FPU depends on */
+#define CR0_MP              0x2         /* WAIT honours TS */
+#define CR0_EM              0x4         /* no FPU, every FPU instruction traps */
+#define CR0_TS              0x8         /* set on switch, the next FPU instruction raises #NM */
+#define CR0_NE              0x20        /* FPU errors raise #MF, not IRQ 13 */
+#define CR4_OSFXSR          0x200       /* FXSAVE/FXRSTOR cover the SSE registers */
+#define CR4_OSXMMEXCPT      0x400       /* SSE errors raise #XF */
+
+/* fpu_owner when the registers belong to no live process */
+#define FPU_NO_OWNER        -1
+
+/* Turn on the FPU and SSE, with CR0.TS set */
+void fpu_init(void);
+/* Called on every switch to a process: trap its first FPU instruction
+ * unless the registers already hold its state */
+void fpu_switch(uint32_t pcb_number);
+/* Drop a halting process's FPU state */
+void fpu_release(uint32_t pcb_number);
+/* #NM: give the registers to the running process */
+void fpu_nm_handler(void);
+/* Take the registers for kernel code, with interrupts off until kernel_fpu_end */
+uint32_t kernel_fpu_begin(void);
+/* 1 between kernel_fpu_begin and kernel_fpu_end */
+uint32_t kernel_fpu_busy(void);
+/* Give them back, the next process to use them traps and reloads its own */
+void kernel_fpu_end(uint32_t flags);
+
+#endif /* _FPU_H */
@@ -3,6 +3,7 @@
  */
 
 #include "i8259.h"
+#include "apic.h"
 #include "lib.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
@@ -38,6 +39,10 @@ void enable_irq(uint32_t irq_num)
 {
     uint8_t cur_enabled=0x01;       //initialize the bit we are comparing
     if(irq_num>15||irq_num<0)   return;
+    if(apic_enabled){               //the IOAPIC has taken over from the PICs
+        ioapic_enable_irq(irq_num);
+        return;
+    }
     if(irq_num<8){
         cur_enabled = cur_enabled << irq_num;   //find the bit we want to operate
         master_mask &= ~cur_enabled;            //set that bit to 0(enabled) and "and" to master_mask
@@ -58,14 +63,18 @@ void disable_irq(uint32_t irq_num)
 {
     uint8_t cur_disabled=0x01;       //initialize the bit we are comparing
     if(irq_num>15||irq_num<0)   return;
+    if(apic_enabled){               //the IOAPIC has taken over from the PICs
+        ioapic_disable_irq(irq_num);
+        return;
+    }
     if(irq_num<8){
         cur_disabled = cur_disabled << irq_num;   //find the bit we want to operate
-        master_mask |= ~cur_disabled;            //set that bit to 1(disabled) and "or" to master_mask
+        master_mask |= cur_disabled;             //set that bit to 1(disabled) and "or" to master_mask
         outb(master_mask,MASTER_8259_DATA);
     }
     else{
         cur_disabled = cur_disabled << (irq_num-8);       //8 is total num of IRQ port on master
-        slave_mask |= ~cur_disabled;                     //set that bit to 1(disabled) and "or" to slave_mask
+        slave_mask |= cur_disabled;                      //set that bit to 1(disabled) and "or" to slave_mask
         outb(slave_mask,SLAVE_8259_DATA);
     }
 }
@@ -77,6 +86,10 @@ void disable_irq(uint32_t irq_num)
 void send_eoi(uint32_t irq_num)
 {
     if(irq_num>15||irq_num<0) return;
+    if(apic_enabled){               //one MMIO write, even for slave IRQs
+        lapic_send_eoi();
+        return;
+    }
     if(irq_num<8){
         outb(EOI | irq_num , MASTER_8259_CMD);          //eoi "or" with irq_num, and send to master command port
     }
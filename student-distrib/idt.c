@@ -27,7 +27,6 @@ idt_table (BP, "Breakpoint Exception");
 idt_table (OF, "Overflow Exception");
 idt_table (BR, "BOUND Range Exceeded Exception");
 idt_table (UD, "Invalid Opcode Exception");
-idt_table (NM, "Device Not Available Exception");
 idt_table (DF, "Double Fault Exception");
 idt_table (CSO, "Coprocessor Segment Overrun");
 idt_table (TS, "Invalid TSS Exception");
@@ -91,11 +90,33 @@ void idt_init() {
     SET_IDT_ENTRY(idt[18], MC);  /* Interrupt 18: Machine-Check Exception */
     SET_IDT_ENTRY(idt[19], XF);  /* Interrupt 19: SIMD Floating-Point Exception */
 
-    SET_IDT_ENTRY(idt[KBD_VEC], kbd_handler);
-    SET_IDT_ENTRY(idt[RTC_VEC], rtc_handler);
+    /* Every IRQ line goes through the generic layer in irq.c */
+    for(index = 0; index < NR_IRQS; index++)
+    {
+        SET_IDT_ENTRY(idt[IRQ_BASE_VEC + index], irq_stub_table[index]);
+    }
+
     SET_IDT_ENTRY(idt[SYS_VEC], syc_handler);
-    SET_IDT_ENTRY(idt[PIT_VEC], pit_handler);
-    SET_IDT_ENTRY(idt[MSE_VEC], mse_handler);
+    SET_IDT_ENTRY(idt[SPURIOUS_VEC], spurious_handler);
+}
+
+/* void sysenter_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: Point the SYSENTER MSRs at the fast system call entry if the CPU
+ * has them. Processor signatures below 0x633 (early Pentium Pro) report SEP
+ * without supporting it. int $0x80 keeps working either way */
+void sysenter_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if(!(edx & CPUID_EDX_SEP)) return;
+    if((eax & CPUID_SIGNATURE_MASK) < CPUID_SEP_MIN_SIGNATURE) return;
+
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)sysenter_stack_top);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_handler);
+    sysenter_enabled = 1;
 }
 
 /* void undef_interrupt();
@@ -107,6 +128,18 @@ void undef_interrupt() {
 }
 
 void pf_handler(int32_t cr,int32_t error){
+    uint32_t addr = (uint32_t)cr;
+    pcb_t* pcb;
+
+    /* A page of the program region or the stack touched for the first time
+     * gets a frame, and a write to one still shared with the filesystem
+     * image gets a private copy, then the faulting instruction runs again */
+    if(addr >= USER_START && addr < PHYS_MAP_BASE)
+    {
+        pcb = get_cur_pcb();
+        if(vmem_fault(pcb->process_number, pcb->heap_start, addr, error) == 0) return;
+    }
+
     cli();
     /* Set interrupt flag to 1 for halt return 256 */
     interrupt_halt_flag = 1;
@@ -10,16 +10,26 @@
 #include "lib.h"
 #include "idt_handler.h"
 #include "system_call.h"
+#include "irq.h"
 
 int32_t interrupt_halt_flag;
 
-#define KBD_VEC 0x21
-#define RTC_VEC 0x28
 #define SYS_VEC 0x80
-#define PIT_VEC 0x20
-#define MSE_VEC 0x2C
+
+/* SYSENTER MSRs and the CPUID leaf 1 EDX bit that reports them */
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+#define CPUID_EDX_SEP       0x800
+#define CPUID_SIGNATURE_MASK    0xFFF   /* family, model, stepping */
+#define CPUID_SEP_MIN_SIGNATURE 0x633
+
+/* Set once the SYSENTER MSRs point at sysenter_handler */
+uint8_t sysenter_enabled;
+#define SPURIOUS_VEC 0xFF
 
 void idt_init();
+void sysenter_init(void);
 void undef_interrupt();
 
 #endif
@@ -7,15 +7,21 @@
 
 #include "x86_desc.h"
 
+/* Highest system call number in syc_jumptable */
+#define NUM_SYSCALLS 21
+
 #ifndef ASM
 
-extern void kbd_handler();
-extern void rtc_handler();
 extern void syc_handler();
-extern void pit_handler();
-extern void mse_handler();
+extern void sysenter_handler();
+extern uint32_t sysenter_stack_top[];
+extern void spurious_handler();
 
 extern void PF();
+extern void NM();
+
+/* Entry stubs for IRQ lines 0-15 */
+extern uint32_t irq_stub_table[];
 #endif
 
 #endif
@@ -0,0 +1,21 @@
+/* iovec.h - Buffer list used by the vectored I/O calls
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IOVEC_H
+#define _IOVEC_H
+
+#include "types.h"
+
+/* Most buffers one readv/writev call accepts */
+#define IOV_MAX 16
+
+/* Struct iovec_t
+ * base : start of the buffer
+ * len : size of the buffer in bytes */
+typedef struct {
+    void* base;
+    uint32_t len;
+} iovec_t;
+
+#endif /* _IOVEC_H */
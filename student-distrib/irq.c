@@ -0,0 +1,170 @@
+/* irq.c - Generic IRQ registration, dispatch and statistics
+ * vim:ts=4 noexpandtab
+ */
+
+#include "irq.h"
+#include "i8259.h"
+#include "softirq.h"
+#include "slab.h"
+#include "lib.h"
+
+/* Per line descriptors, their actions come from kmalloc */
+static irq_desc_t irq_desc[NR_IRQS];
+
+/* Line and time stamp of the interrupt being handled. These are globals
+ * rather than locals of do_irq because the PIT handler switches kernel stacks,
+ * so do_irq can finish in a different frame from the one it started in.
+ * Interrupt gates keep IF clear until iret, so there is never more than one */
+static uint32_t irq_cur;
+static uint64_t irq_entry_tsc;
+
+/* int32_t request_irq(uint32_t irq, irq_handler_t handler, const int8_t* name, void* dev)
+ * Input:  irq -- ISA IRQ line
+ *         handler -- function to call when the line fires
+ *         name -- device name shown in irqstat
+ *         dev -- cookie passed to handler, must be unique on a shared line
+ * Return Value: 0 on success, -1 if the line is invalid or memory ran out
+ * Function: Append a handler to the line's action list. The line is unmasked
+ * when its first handler is registered */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, const int8_t* name, void* dev)
+{
+    irqaction_t* action;
+    irqaction_t** tail;
+    uint32_t flags;
+
+    if(irq >= NR_IRQS || handler == NULL) return -1;
+
+    action = kmalloc(sizeof(irqaction_t));
+    if(action == NULL) return -1;
+
+    action->handler = handler;
+    action->dev = dev;
+    action->name = name;
+    action->next = NULL;
+
+    cli_and_save(flags);
+    for(tail = &irq_desc[irq].action; *tail != NULL; tail = &(*tail)->next);
+    *tail = action;
+
+    /* First handler on this line */
+    if(tail == &irq_desc[irq].action) enable_irq(irq);
+    restore_flags(flags);
+    return 0;
+}
+
+/* void free_irq(uint32_t irq, void* dev)
+ * Input:  irq -- ISA IRQ line
+ *         dev -- cookie the handler was registered with
+ * Return Value: none
+ * Function: Remove a handler from the line, masking the line when it was the
+ * last one */
+void free_irq(uint32_t irq, void* dev)
+{
+    irqaction_t** link;
+    irqaction_t* action;
+    uint32_t flags;
+
+    if(irq >= NR_IRQS) return;
+
+    cli_and_save(flags);
+    for(link = &irq_desc[irq].action; *link != NULL; link = &(*link)->next)
+    {
+        if((*link)->dev == dev)
+        {
+            action = *link;
+            *link = action->next;
+            kfree(action);
+            break;
+        }
+    }
+    if(irq_desc[irq].action == NULL) disable_irq(irq);
+    restore_flags(flags);
+}
+
+/* void do_irq(uint32_t irq)
+ * Input:  irq -- line number pushed by the vector's stub
+ * Return Value: none
+ * Function: Acknowledge the controller, run every handler on the line and
+ * account the time spent. EOI goes out before the handlers because some of
+ * them never return here: the PIT handler can start a new shell, and ctrl-c
+ * halts the current program from the keyboard handler. IF stays clear
+ * through the handlers, so the early EOI cannot cause nesting; deferred work
+ * then runs with interrupts enabled in softirq_run */
+void do_irq(uint32_t irq)
+{
+    irq_desc_t* desc;
+    irqaction_t* action;
+    int32_t handled = IRQ_NONE;
+    uint32_t cycles;
+    int32_t bucket;
+
+    /* The interrupt gate cleared IF on entry */
+    trace_irqs_off(_THIS_IP_);
+
+    irq_entry_tsc = rdtsc();
+    irq_cur = irq;
+    irq_desc[irq].count++;
+
+    send_eoi(irq);
+    for(action = irq_desc[irq].action; action != NULL; action = action->next)
+    {
+        handled |= action->handler(irq, action->dev);
+    }
+
+    /* Re-read the line, this may be a different stack from the one that
+     * entered (see irq_cur) */
+    desc = &irq_desc[irq_cur];
+    cycles = (uint32_t)(rdtsc() - irq_entry_tsc);
+
+    if(handled == IRQ_NONE) desc->unhandled++;
+    desc->cycles += cycles;
+
+    for(bucket = 0; bucket < IRQ_HIST_BUCKETS - 1 && (cycles >> (bucket + 1)) != 0; bucket++);
+    desc->hist[bucket]++;
+
+    softirq_run();
+
+    /* iret sets IF again */
+    trace_irqs_on(_THIS_IP_);
+}
+
+/* void irqstat_show(special_buf_t* b)
+ * Input:  b -- buffer to fill
+ * Return Value: none
+ * Function: Print, for every line with a handler, the interrupt count, the
+ * unclaimed count, the total handler time in units of 1024 cycles, the device
+ * names, and the non-empty buckets of the log2 cycle histogram */
+void irqstat_show(special_buf_t* b)
+{
+    irqaction_t* action;
+    uint32_t irq;
+    int32_t i;
+
+    special_puts(b, "IRQ      count  unhandled    kcycles  devices\n");
+    for(irq = 0; irq < NR_IRQS; irq++)
+    {
+        if(irq_desc[irq].action == NULL && irq_desc[irq].count == 0) continue;
+
+        special_putu(b, irq, 3);
+        special_putu(b, irq_desc[irq].count, 11);
+        special_putu(b, irq_desc[irq].unhandled, 11);
+        special_putu(b, (uint32_t)(irq_desc[irq].cycles >> 10), 11);
+        special_puts(b, " ");
+        for(action = irq_desc[irq].action; action != NULL; action = action->next)
+        {
+            special_puts(b, " ");
+            special_puts(b, action->name);
+        }
+        special_puts(b, "\n   ");
+
+        for(i = 0; i < IRQ_HIST_BUCKETS; i++)
+        {
+            if(irq_desc[irq].hist[i] == 0) continue;
+            special_puts(b, " 2^");
+            special_putu(b, i, 0);
+            special_puts(b, ":");
+            special_putu(b, irq_desc[irq].hist[i], 0);
+        }
+        special_puts(b, "\n");
+    }
+}
@@ -0,0 +1,66 @@
+/* irq.h - Defines for the generic IRQ registration layer
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IRQ_H
+#define _IRQ_H
+
+#include "types.h"
+#include "special_file.h"
+
+/* ISA IRQ lines, delivered on vectors 0x20-0x2F by either controller */
+#define NR_IRQS             16
+#define IRQ_BASE_VEC        0x20
+
+/* Cycle-time histogram buckets, bucket i counts handlers that took
+ * [2^i, 2^(i+1)) cycles */
+#define IRQ_HIST_BUCKETS    32
+
+/* Return values of an IRQ handler */
+#define IRQ_NONE            0
+#define IRQ_HANDLED         1
+
+#ifndef ASM
+
+/* A handler gets the IRQ line and the cookie it registered with, and returns
+ * IRQ_HANDLED if its device raised the interrupt */
+typedef int32_t (*irq_handler_t)(uint32_t irq, void* dev);
+
+/* Struct irqaction_t
+ * handler : function to call for this line
+ * dev : cookie passed to the handler, also identifies the action in free_irq
+ * name : device name shown in irqstat
+ * next : next action sharing the same line */
+typedef struct irqaction {
+    irq_handler_t handler;
+    void* dev;
+    const int8_t* name;
+    struct irqaction* next;
+} irqaction_t;
+
+/* Struct irq_desc_t
+ * action : list of handlers registered on this line
+ * count : number of interrupts taken
+ * unhandled : interrupts no handler claimed
+ * cycles : total cycles spent in the handlers
+ * hist : log2 histogram of the cycles spent per interrupt */
+typedef struct {
+    irqaction_t* action;
+    uint32_t count;
+    uint32_t unhandled;
+    uint64_t cycles;
+    uint32_t hist[IRQ_HIST_BUCKETS];
+} irq_desc_t;
+
+/* Register a handler on an IRQ line, enabling the line on first use */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, const int8_t* name, void* dev);
+/* Remove the handler registered with dev, disabling the line on last use */
+void free_irq(uint32_t irq, void* dev);
+/* Common C entry point for every IRQ vector */
+void do_irq(uint32_t irq);
+/* Contents of the irqstat special file */
+void irqstat_show(special_buf_t* b);
+
+#endif /* ASM */
+
+#endif /* _IRQ_H */
@@ -0,0 +1,91 @@
+/* irqsoff.c - Measures how long the kernel runs with interrupts disabled
+ * vim:ts=4 noexpandtab
+ */
+
+#include "irqsoff.h"
+#include "lib.h"
+
+/* The window currently open, if any */
+static uint8_t irqsoff_open;
+static uint32_t irqsoff_start_ip;
+static uint64_t irqsoff_start_tsc;
+
+/* void trace_irqs_off(uint32_t ip)
+ * Input:  ip -- address of the cli, or of the interrupt entry
+ * Return Value: none
+ * Function: Open a window if none is open. Nested disables (cli with
+ * interrupts already off) keep the original start */
+void trace_irqs_off(uint32_t ip)
+{
+    uint32_t flags;
+
+    raw_cli_and_save(flags);
+    if(!irqsoff_open)
+    {
+        irqsoff_open = 1;
+        irqsoff_start_ip = ip;
+        irqsoff_start_tsc = rdtsc();
+    }
+    raw_restore_flags(flags);
+}
+
+/* void trace_irqs_on(uint32_t ip)
+ * Input:  ip -- address of the sti, or of the interrupt exit
+ * Return Value: none
+ * Function: Close the open window and keep it if it is the longest so far */
+void trace_irqs_on(uint32_t ip)
+{
+    uint32_t flags;
+    uint32_t cycles;
+
+    raw_cli_and_save(flags);
+    if(irqsoff_open)
+    {
+        cycles = (uint32_t)(rdtsc() - irqsoff_start_tsc);
+        irqsoff_open = 0;
+
+        irqsoff_stat.windows++;
+        irqsoff_stat.total_cycles += cycles;
+        if(cycles > irqsoff_stat.max_cycles)
+        {
+            irqsoff_stat.max_cycles = cycles;
+            irqsoff_stat.max_start_ip = irqsoff_start_ip;
+            irqsoff_stat.max_end_ip = ip;
+        }
+    }
+    raw_restore_flags(flags);
+}
+
+/* void irqsoff_reset(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Clear the statistics so a test can measure one stretch of code */
+void irqsoff_reset(void)
+{
+    uint32_t flags;
+
+    raw_cli_and_save(flags);
+    memset(&irqsoff_stat, 0, sizeof(irqsoff_stat));
+    raw_restore_flags(flags);
+}
+
+/* void irqsoff_show(special_buf_t* b)
+ * Input:  b -- buffer to fill
+ * Return Value: none
+ * Function: Print the number of windows, the total time with interrupts off
+ * in units of 1024 cycles, and the longest window with the addresses that
+ * opened and closed it. Look the addresses up with nm on the kernel image */
+void irqsoff_show(special_buf_t* b)
+{
+    special_puts(b, "windows:    ");
+    special_putu(b, irqsoff_stat.windows, 0);
+    special_puts(b, "\ntotal kcycles: ");
+    special_putu(b, (uint32_t)(irqsoff_stat.total_cycles >> 10), 0);
+    special_puts(b, "\nmax cycles: ");
+    special_putu(b, irqsoff_stat.max_cycles, 0);
+    special_puts(b, "\nmax start:  ");
+    special_putx(b, irqsoff_stat.max_start_ip);
+    special_puts(b, "\nmax end:    ");
+    special_putx(b, irqsoff_stat.max_end_ip);
+    special_puts(b, "\n");
+}
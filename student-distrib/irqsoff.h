@@ -0,0 +1,33 @@
+/* irqsoff.h - Defines for the interrupts-off latency tracer
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IRQSOFF_H
+#define _IRQSOFF_H
+
+#include "types.h"
+#include "special_file.h"
+
+/* Struct irqsoff_stat_t
+ * windows : number of closed interrupts-off windows
+ * total_cycles : cycles spent with interrupts off
+ * max_cycles : longest window
+ * max_start_ip : where the longest window began (cli or interrupt entry)
+ * max_end_ip : where the longest window ended (sti or interrupt exit) */
+typedef struct {
+    uint32_t windows;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+    uint32_t max_start_ip;
+    uint32_t max_end_ip;
+} irqsoff_stat_t;
+
+/* Statistics since boot or the last irqsoff_reset */
+irqsoff_stat_t irqsoff_stat;
+
+/* Forget the recorded windows, keeping the one currently open */
+void irqsoff_reset(void);
+/* Contents of the irqsoff special file */
+void irqsoff_show(special_buf_t* b);
+
+#endif /* _IRQSOFF_H */
@@ -8,12 +8,17 @@
 #include "idt.h"
 #include "idt_handler.h"
 #include "i8259.h"
+#include "apic.h"
 #include "rtc.h"
 #include "keyboard.h"
 #include "mouse.h"
 #include "debug.h"
 #include "tests.h"
 #include "paging.h"
+#include "buddy.h"
+#include "slab.h"
+#include "fpu.h"
+#include "memops.h"
 #include "system_call.h"
 #include "scheduling.h"
 
@@ -21,6 +26,7 @@
 
 uint32_t start_addr = 0;
 uint32_t end_addr = 0;
+uint32_t mem_end = 0;
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
@@ -48,8 +54,11 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
     /* Are mem_* valid? */
-    if (CHECK_FLAG(mbi->flags, 0))
+    if (CHECK_FLAG(mbi->flags, 0)) {
         printf("mem_lower = %uKB, mem_upper = %uKB\n", (unsigned)mbi->mem_lower, (unsigned)mbi->mem_upper);
+        /* mem_upper counts the KB above 1MB */
+        mem_end = (mbi->mem_upper + 1024) * 1024;
+    }
 
     /* Is boot_device valid? */
     if (CHECK_FLAG(mbi->flags, 1))
@@ -104,7 +113,7 @@ void entry(unsigned long magic, unsigned long addr) {
                 (unsigned)mbi->mmap_addr, (unsigned)mbi->mmap_length);
         for (mmap = (memory_map_t *)mbi->mmap_addr;
                 (unsigned long)mmap < mbi->mmap_addr + mbi->mmap_length;
-                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size)))
+                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size))) {
             printf("    size = 0x%x, base_addr = 0x%#x%#x\n    type = 0x%x,  length    = 0x%#x%#x\n",
                     (unsigned)mmap->size,
                     (unsigned)mmap->base_addr_high,
@@ -112,6 +121,20 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->type,
                     (unsigned)mmap->length_high,
                     (unsigned)mmap->length_low);
+
+            /* Type 1 is usable RAM, keep what lies below 4GB for the buddy
+             * allocator. A length over 4GB is cut off there */
+            if (mmap->type == 1 && mmap->base_addr_high == 0) {
+                buddy_add_region(mmap->base_addr_low, mmap->length_high ? BUDDY_POOL_MAX : mmap->length_low);
+                if (mmap->length_high || mmap->base_addr_low + mmap->length_low < mmap->base_addr_low)
+                    mem_end = BUDDY_POOL_MAX;
+                else if (mmap->base_addr_low + mmap->length_low > mem_end)
+                    mem_end = mmap->base_addr_low + mmap->length_low;
+            }
+        }
+    } else if (mem_end != 0) {
+        /* No memory map, trust mem_upper: RAM from 1MB up */
+        buddy_add_region(0x100000, mem_end - 0x100000);
     }
 
     /* Construct an LDT entry in the GDT */
@@ -151,7 +174,7 @@ void entry(unsigned long magic, unsigned long addr) {
 
         tss.ldt_segment_selector = KERNEL_LDT;
         tss.ss0 = KERNEL_DS;
-        tss.esp0 = 0x800000;
+        tss.esp0 = KERNEL_STACK_TOP;
         ltr(KERNEL_TSS);
     }
 
@@ -162,9 +185,39 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("Enabling Interrupts\n");
     idt_init();
 
+    /* Fast system call entry, used by programs that see SEP in CPUID */
+    sysenter_init();
+
+    /* Look for an IOAPIC in the firmware tables while they are still
+     * reachable through physical addresses */
+    apic_detect();
+
     /* Initialize PIC */
     i8259_init();
 
+    /* Initialize paging, before the APIC registers get mapped */
+    paging_init();
+
+    /* Map physical memory for the kernel, then hand everything past the
+     * kernel page, the PCBs and the filesystem image to the buddy allocator */
+    paging_direct_map(mem_end);
+    buddy_init(end_addr > 0x800000 ? end_addr : 0x800000);
+    printf("Free frames: %u (%uMB)\n", frames_free, frames_free / 256);
+
+    /* Kernel objects and kmalloc, slabs come from the buddy allocator */
+    kmem_init();
+
+    /* FPU and SSE for user programs, switched lazily through #NM */
+    fpu_init();
+
+    /* Pick memcpy and memset for large buffers, SSE2 needs fpu_init */
+    mem_init();
+
+    /* Route interrupts through the IOAPIC when there is one, the PIC stays as
+     * the fallback. Must come before the drivers enable their IRQs */
+    apic_init();
+    printf("Interrupt controller: %s, %u CPU(s)\n", apic_enabled ? "IOAPIC" : "8259 PIC", apic_cpu_count);
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
     
@@ -180,11 +233,9 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Initialize Mouse */
     mouse_init();
 
-    /* Initialize paging */
-    paging_init();
-
-    /* put this line here temporialy to see some of the results */
-    fs_init(start_addr, end_addr);
+    /* put this line here temporialy to see some of the results, the module
+     * is reached through the direct map now */
+    fs_init((uint32_t)phys_to_virt(start_addr), (uint32_t)phys_to_virt(end_addr));
 
     /* Initialzie terminal */
     term_init();
@@ -196,5 +247,5 @@ void entry(unsigned long magic, unsigned long addr) {
 #endif
 
     /* Spin (nicely, so we don't chew up cycles) */
-    asm volatile (".1: hlt; jmp .1;");
+    asm volatile ("1: hlt; jmp 1b;");
 }
@@ -37,6 +37,15 @@ static uint8_t scancode_map[4][59]={
 	 'b', 'n', 'm', '<', '>', '?', '\0', '*', '\0', ' ', '\0'}
 };
 
+/* Scancodes read by the top half, consumed by the bottom half */
+static volatile uint8_t scancode_ring[SCANCODE_RING_SIZE];
+static volatile uint32_t scancode_head=0;
+static volatile uint32_t scancode_tail=0;
+static tasklet_t keyboard_tasklet;
+
+static void keyboard_bottom_half(uint32_t data);
+static void keyboard_process(uint8_t scancode_idx);
+
 /* key buffer and buffer index used to display in terminal */
 volatile uint8_t key_buf[KEY_BUF_MAX];
 volatile uint8_t key_buf_idx=0;
@@ -46,21 +55,55 @@ volatile uint8_t key_buf_idx=0;
  * Return Value: none
  * Function: initialize keyboard on PIC */
 void keyboard_init(){
-    enable_irq(KEYBOARD_IRQ);
+    tasklet_init(&keyboard_tasklet, "keyboard", keyboard_bottom_half, 0);
+    request_irq(KEYBOARD_IRQ, keyboard_interrupt_handler, "keyboard", NULL);
 }
 
-/* void keyboard_interrupt_handler(void)
- * Input:  none
+/* int32_t keyboard_interrupt_handler(uint32_t irq, void* dev)
+ * Input:  irq -- line number, dev -- unused
+ * Return Value: IRQ_HANDLED
+ * Function: called when keyboard interrupt occurs. Only reads the scancode and
+ * queues it, the key is handled by the bottom half with interrupts enabled */
+int32_t keyboard_interrupt_handler(uint32_t irq, void* dev){
+    uint8_t scancode_idx;
+    //if scancode available, load it
+    scancode_idx = inb(KEYBOARD_DATA);
+    //drop the key if the bottom half has fallen a whole ring behind
+    if(scancode_head-scancode_tail<SCANCODE_RING_SIZE){
+        scancode_ring[scancode_head%SCANCODE_RING_SIZE]=scancode_idx;
+        scancode_head++;
+    }
+    tasklet_schedule(&keyboard_tasklet);
+    return IRQ_HANDLED;
+}
+
+/* void keyboard_bottom_half(uint32_t data)
+ * Input:  data -- unused
  * Return Value: none
- * Function: called when keyboard interrupt occurs, echo key pressed (if possible) to screen */
-void keyboard_interrupt_handler(){
-    cli();
+ * Function: handle every queued scancode. ctrl+c halts the current program,
+ * leaving the rest of the queue for the next run */
+static void keyboard_bottom_half(uint32_t data){
     uint8_t scancode_idx;
+    while(scancode_tail!=scancode_head){
+        scancode_idx=scancode_ring[scancode_tail%SCANCODE_RING_SIZE];
+        scancode_tail++;
+        keyboard_process(scancode_idx);
+        if(ctrl_c_flag){
+            if(scancode_tail!=scancode_head) tasklet_schedule(&keyboard_tasklet);
+            softirq_abort();                    //halt does not come back here
+            halt(1);                            //ctrl_c still has problem
+        }
+    }
+}
+
+/* void keyboard_process(uint8_t scancode_idx)
+ * Input:  scancode_idx -- scancode read from the keyboard
+ * Return Value: none
+ * Function: echo key pressed (if possible) to screen */
+static void keyboard_process(uint8_t scancode_idx){
     uint8_t key;
     keyboard_enabled = 1;
     ctrl_c_flag = 0;
-    //if scancode available, load it
-    scancode_idx = inb(KEYBOARD_DATA);
     //check for different key cases
     switch(scancode_idx){
         //handle special characters
@@ -96,6 +139,8 @@ void keyboard_interrupt_handler(){
                 key_buf[key_buf_idx]='\n';
                 key_buf_idx++;
                 term[cur_term_id].enter_state = 1; 
+                term[cur_term_id].waiting = 0;
+                tick_restart();             //the terminal is runnable again
                 enter();
             }
             break;
@@ -151,8 +196,6 @@ void keyboard_interrupt_handler(){
             break;
     }
     keyboard_enabled = 0;
-    send_eoi(KEYBOARD_IRQ);                     //send eoi
-    if(ctrl_c_flag) halt(1);                    //ctrl_c still has problem
 }
 
 /* void buf_clear(void)
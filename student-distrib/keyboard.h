@@ -10,6 +10,8 @@
 #include "i8259.h"
 #include "terminal.h"
 #include "system_call.h"
+#include "irq.h"
+#include "softirq.h"
 
 /* interrupt request vector number for keyboard */
 #define KEYBOARD_IRQ 1
@@ -33,6 +35,8 @@
 #define F3          0x3D
 /* key buffer max size */
 #define KEY_BUF_MAX 128
+/* scancodes the top half can queue before the bottom half runs, power of two */
+#define SCANCODE_RING_SIZE 64
 
 /* global variable */
 extern volatile uint8_t key_buf[KEY_BUF_MAX];
@@ -43,7 +47,7 @@ int32_t ctrl_c_flag;
 /* keyboard initialization */
 void keyboard_init(void);
 /* keyboard interrupt handler */
-void keyboard_interrupt_handler(void);
+int32_t keyboard_interrupt_handler(uint32_t irq, void* dev);
 /* clear key buffer */
 void buf_clear(void);
 
@@ -2,11 +2,22 @@
  * vim:ts=4 noexpandtab */
 
 #include "lib.h"
+#include "memops.h"
 
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
 
+/* Word-at-a-time string scanning. HAS_ZERO is nonzero exactly when one of
+ * the four bytes of w is 0, and a word load at p stays inside p's page
+ * unless PAGE_TAIL(p), so no scan touches a page past the string. str_word_t
+ * may alias the int8_t strings it is loaded from */
+typedef uint32_t __attribute__((may_alias)) str_word_t;
+#define WORD_ONES       0x01010101
+#define WORD_HIGHS      0x80808080
+#define HAS_ZERO(w)     (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+#define PAGE_TAIL(p)    (((uint32_t)(p) & 0xFFF) > 0xFFC)
+
 /* user-defined function section */
 
 /* void set_screen_cursor(uint32_t new_x,uint32_t new_y)
@@ -106,20 +117,24 @@ void scroll_up()
 void multi_scroll_up()
 {
     int32_t i;
+    uint8_t* mem = term[now_term_id].video_mem;
+    uint8_t attrib;
 
     //move each line up by 1
     for(i=0;i<(NUM_ROWS-1)*(NUM_COLS);i++){
-        *(uint8_t *)(term[now_term_id].video_mem + (i << 1)) = *(uint8_t *)(term[now_term_id].video_mem + ((i+NUM_COLS) << 1));
-        *(uint8_t *)(term[now_term_id].video_mem + (i << 1) + 1) = *(uint8_t *)(term[now_term_id].video_mem + ((i+NUM_COLS) << 1) + 1);
+        *(uint8_t *)(mem + (i << 1)) = *(uint8_t *)(mem + ((i+NUM_COLS) << 1));
+        *(uint8_t *)(mem + (i << 1) + 1) = *(uint8_t *)(mem + ((i+NUM_COLS) << 1) + 1);
     }
 
+    if(now_term_id==0)  attrib = ATTRIB_T1;
+    else if(now_term_id==1)  attrib = ATTRIB_T2;
+    else if(now_term_id==2)  attrib = ATTRIB_T3;
+    else attrib = ATTRIB;
+
     //clear bottom line
     for(i=(NUM_ROWS-1)*(NUM_COLS);i<NUM_ROWS*NUM_COLS;i++){
-        *(uint8_t *)(term[now_term_id].video_mem + (i << 1)) = ' ';
-        if(now_term_id==0)  *(uint8_t *)(term[now_term_id].video_mem + (i << 1) + 1) = ATTRIB_T1;
-        else if(now_term_id==1)  *(uint8_t *)(term[now_term_id].video_mem + (i << 1) + 1) = ATTRIB_T2;
-        else if(now_term_id==2)  *(uint8_t *)(term[now_term_id].video_mem + (i << 1) + 1) = ATTRIB_T3;
-        else *(uint8_t *)(term[now_term_id].video_mem + (i << 1) + 1) = ATTRIB;
+        *(uint8_t *)(mem + (i << 1)) = ' ';
+        *(uint8_t *)(mem + (i << 1) + 1) = attrib;
     }
 }
 
@@ -189,258 +204,355 @@ void clear(void) {
     }
 }
 
-/* Standard printf().
- * Only supports the following format strings:
- * %%  - print a literal '%' character
- * %x  - print a number in hexadecimal
- * %u  - print a number as an unsigned integer
- * %d  - print a number as a signed integer
- * %c  - print a character
- * %s  - print a string
- * %#x - print a number in 32-bit aligned hexadecimal, i.e.
- *       print 8 hexadecimal digits, zero-padded on the left.
- *       For example, the hex number "E" would be printed as
- *       "0000000E".
- *       Note: This is slightly different than the libc specification
- *       for the "#" modifier (this implementation doesn't add a "0x" at
- *       the beginning), but I think it's more flexible this way.
- *       Also note: %x is the only conversion specifier that can use
- *       the "#" modifier to alter output. */
-int32_t printf(int8_t *format, ...) {
-
-    /* Pointer to the format string */
-    int8_t* buf = format;
-
-    /* Stack pointer for the other parameters */
-    int32_t* esp = (void *)&format;
-    esp++;
+/* Struct fmt_out_t, where fmt_format puts its output
+ * buf, size : buffer and its capacity
+ * len : bytes in buf
+ * total : bytes the whole output takes, written or not
+ * flush : called with the full buffer, which then starts over. NULL for
+ *         vsnprintf, which drops what does not fit */
+typedef struct {
+    int8_t* buf;
+    uint32_t size;
+    uint32_t len;
+    uint32_t total;
+    void (*flush)(const int8_t* s, uint32_t n);
+} fmt_out_t;
+
+/* Flag bits of one conversion */
+#define FMT_LEFT    0x1     /* '-', pad on the right */
+#define FMT_ZERO    0x2     /* '0', pad numbers with zeros */
+#define FMT_ALT     0x4     /* '#', %x as 8 digits */
+#define FMT_UPPER   0x8     /* %X */
+
+static void fmt_format(fmt_out_t* out, const int8_t* format, va_list ap);
+
+/* uint8_t term_attrib(uint32_t id)
+ * Input:  id -- terminal number
+ * Return Value: its text attribute
+ * Function: Each terminal has its own text color */
+static uint8_t term_attrib(uint32_t id)
+{
+    if(id==0) return ATTRIB_T1;
+    if(id==1) return ATTRIB_T2;
+    if(id==2) return ATTRIB_T3;
+    return ATTRIB;
+}
 
-    while (*buf != '\0') {
-        switch (*buf) {
-            case '%':
-                {
-                    int32_t alternate = 0;
-                    buf++;
-
-format_char_switch:
-                    /* Conversion specifiers */
-                    switch (*buf) {
-                        /* Print a literal '%' character */
-                        case '%':
-                            putc('%');
-                            break;
-
-                        /* Use alternate formatting */
-                        case '#':
-                            alternate = 1;
-                            buf++;
-                            /* Yes, I know gotos are bad.  This is the
-                             * most elegant and general way to do this,
-                             * IMHO. */
-                            goto format_char_switch;
-
-                        /* Print a number in hexadecimal form */
-                        case 'x':
-                            {
-                                int8_t conv_buf[64];
-                                if (alternate == 0) {
-                                    itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
-                                } else {
-                                    int32_t starting_index;
-                                    int32_t i;
-                                    itoa(*((uint32_t *)esp), &conv_buf[8], 16);
-                                    i = starting_index = strlen(&conv_buf[8]);
-                                    while(i < 8) {
-                                        conv_buf[i] = '0';
-                                        i++;
-                                    }
-                                    puts(&conv_buf[starting_index]);
-                                }
-                                esp++;
-                            }
-                            break;
-
-                        /* Print a number in unsigned int form */
-                        case 'u':
-                            {
-                                int8_t conv_buf[36];
-                                itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
-                                esp++;
-                            }
-                            break;
-
-                        /* Print a number in signed int form */
-                        case 'd':
-                            {
-                                int8_t conv_buf[36];
-                                int32_t value = *((int32_t *)esp);
-                                if(value < 0) {
-                                    conv_buf[0] = '-';
-                                    itoa(-value, &conv_buf[1], 10);
-                                } else {
-                                    itoa(value, conv_buf, 10);
-                                }
-                                puts(conv_buf);
-                                esp++;
-                            }
-                            break;
-
-                        /* Print a single character */
-                        case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
-                            esp++;
-                            break;
-
-                        /* Print a NULL-terminated string */
-                        case 's':
-                            puts(*((int8_t **)esp));
-                            esp++;
-                            break;
-
-                        default:
-                            break;
-                    }
+/* void console_write(const int8_t* s, uint32_t n)
+ * Input:  s, n -- characters to show
+ * Return Value: none
+ * Function: Put n characters on the screen at the cursor, wrapping and
+ * scrolling like putc, and move the hardware cursor once at the end */
+void console_write(const int8_t* s, uint32_t n)
+{
+    uint8_t attrib = term_attrib(cur_term_id);
+    uint32_t i;
 
-                }
-                break;
+    video_mem = (char*)VIDEO;
+    for(i = 0; i < n; i++){
+        if(s[i] == '\n' || s[i] == '\r'){
+            screen_x = 0;
+            screen_y++;
+        }
+        else{
+            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = s[i];
+            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = attrib;
+            if(++screen_x == NUM_COLS){
+                screen_x = 0;
+                screen_y++;
+            }
+        }
+        if(screen_y == NUM_ROWS){
+            scroll_up();
+            screen_y = NUM_ROWS - 1;
+        }
+    }
+    set_screen_cursor(screen_x, screen_y);
+}
 
-            default:
-                putc(*buf);
-                break;
+/* void multi_console_write(const int8_t* s, uint32_t n)
+ * Input:  s, n -- characters to show
+ * Return Value: none
+ * Function: console_write into the video buffer of the running terminal
+ * Only used when current shown terminal is not the terminal being executed */
+void multi_console_write(const int8_t* s, uint32_t n)
+{
+    term_t* t = &term[now_term_id];
+    uint8_t attrib = term_attrib(now_term_id);
+    uint32_t i;
+
+    for(i = 0; i < n; i++){
+        if(s[i] == '\n' || s[i] == '\r'){
+            t->cursor_x = 0;
+            t->cursor_y++;
+        }
+        else{
+            *(uint8_t *)(t->video_mem + ((NUM_COLS * t->cursor_y + t->cursor_x) << 1)) = s[i];
+            *(uint8_t *)(t->video_mem + ((NUM_COLS * t->cursor_y + t->cursor_x) << 1) + 1) = attrib;
+            if(++t->cursor_x == NUM_COLS){
+                t->cursor_x = 0;
+                t->cursor_y++;
+            }
+        }
+        if(t->cursor_y == NUM_ROWS){
+            multi_scroll_up();
+            t->cursor_y = NUM_ROWS - 1;
         }
-        buf++;
     }
-    return (buf - format);
 }
 
+/* Standard printf().
+ * Formats like vsnprintf into a buffer on the stack, which goes to the
+ * screen in one console_write whenever it fills up and at the end */
+int32_t printf(int8_t *format, ...) {
+    int8_t buf[PRINTF_BUF_SIZE];
+    fmt_out_t out = {buf, PRINTF_BUF_SIZE, 0, 0, console_write};
+    va_list ap;
+
+    va_start(ap, format);
+    fmt_format(&out, format, ap);
+    va_end(ap);
+    console_write(buf, out.len);
+    return out.total;
+}
 
 /* multi-printf().
- * Only supports the following format strings:
- * %%  - print a literal '%' character
- * %x  - print a number in hexadecimal
- * %u  - print a number as an unsigned integer
- * %d  - print a number as a signed integer
- * %c  - print a character
- * %s  - print a string
- * %#x - print a number in 32-bit aligned hexadecimal, i.e.
- *       print 8 hexadecimal digits, zero-padded on the left.
- *       For example, the hex number "E" would be printed as
- *       "0000000E".
- *       Note: This is slightly different than the libc specification
- *       for the "#" modifier (this implementation doesn't add a "0x" at
- *       the beginning), but I think it's more flexible this way.
- *       Also note: %x is the only conversion specifier that can use
- *       the "#" modifier to alter output. 
+ * printf through multi_console_write
  * Only used when current shown terminal is not the terminal being executed */
 int32_t multi_printf(int8_t *format, ...) {
+    int8_t buf[PRINTF_BUF_SIZE];
+    fmt_out_t out = {buf, PRINTF_BUF_SIZE, 0, 0, multi_console_write};
+    va_list ap;
+
+    va_start(ap, format);
+    fmt_format(&out, format, ap);
+    va_end(ap);
+    multi_console_write(buf, out.len);
+    return out.total;
+}
+
+/* int32_t vsnprintf(int8_t* buf, uint32_t size, const int8_t* format, va_list ap);
+ * Inputs: int8_t* buf = buffer to format into
+ *         uint32_t size = capacity of buf, the NULL included
+ *         const int8_t* format = format string
+ *         va_list ap = its arguments
+ * Return Value: length of the whole output, which was cut short if it is
+ *               size or more
+ * Function: Format into memory. Supports the conversions
+ * %% %c %s %d %i %u %x %X %p, the flags '-', '0' and '#', a width that may
+ * be '*', a precision for %s, and the "l" and "ll" sizes, "ll" being 64-bit.
+ * %#x prints eight zero-padded hex digits without a "0x". buf always ends
+ * in a NULL unless size is 0 */
+int32_t vsnprintf(int8_t* buf, uint32_t size, const int8_t* format, va_list ap) {
+    fmt_out_t out = {buf, (size > 0) ? size - 1 : 0, 0, 0, NULL};
+
+    fmt_format(&out, format, ap);
+    if(size > 0) buf[out.len] = '\0';
+    return out.total;
+}
+
+/* int32_t snprintf(int8_t* buf, uint32_t size, const int8_t* format, ...);
+ * Inputs: as for vsnprintf, with the arguments inline
+ * Return Value: as for vsnprintf
+ * Function: vsnprintf with a variable argument list */
+int32_t snprintf(int8_t* buf, uint32_t size, const int8_t* format, ...) {
+    va_list ap;
+    int32_t n;
+
+    va_start(ap, format);
+    n = vsnprintf(buf, size, format, ap);
+    va_end(ap);
+    return n;
+}
+
+/* void fmt_putc(fmt_out_t* out, int8_t c)
+ * Input:  out -- output
+ *         c -- character to add
+ * Return Value: none
+ * Function: Add one character, flushing a full buffer first if out has a
+ * flush, or only counting it if not */
+static void fmt_putc(fmt_out_t* out, int8_t c)
+{
+    out->total++;
+    if(out->len == out->size){
+        if(out->flush == NULL) return;
+        out->flush(out->buf, out->len);
+        out->len = 0;
+    }
+    out->buf[out->len++] = c;
+}
+
+/* void fmt_pad(fmt_out_t* out, int8_t c, int32_t n)
+ * Input:  out -- output
+ *         c, n -- padding character and count, nothing if n <= 0
+ * Return Value: none
+ * Function: Add padding */
+static void fmt_pad(fmt_out_t* out, int8_t c, int32_t n)
+{
+    while(n-- > 0) fmt_putc(out, c);
+}
 
-    /* Pointer to the format string */
-    int8_t* buf = format;
+/* uint32_t fmt_div(uint64_t* value, uint32_t base)
+ * Input:  value -- number to divide, replaced by the quotient
+ *         base -- divisor, at most 16
+ * Return Value: the remainder
+ * Function: 64-bit division done as 32-bit ones: the high word, then the
+ * low word 16 bits at a time. Dividing a uint64_t directly would need
+ * libgcc, which is not linked */
+static uint32_t fmt_div(uint64_t* value, uint32_t base)
+{
+    uint32_t hi = (uint32_t)(*value >> 32);
+    uint32_t lo = (uint32_t)*value;
+    uint32_t rem, cur, q_lo;
+
+    rem = hi % base;
+    hi = hi / base;
+    cur = (rem << 16) | (lo >> 16);
+    q_lo = (cur / base) << 16;
+    rem = cur % base;
+    cur = (rem << 16) | (lo & 0xFFFF);
+    q_lo |= cur / base;
+    rem = cur % base;
+
+    *value = ((uint64_t)hi << 32) | q_lo;
+    return rem;
+}
 
-    /* Stack pointer for the other parameters */
-    int32_t* esp = (void *)&format;
-    esp++;
+/* void fmt_number(fmt_out_t* out, uint64_t value, uint32_t base, uint32_t neg, uint32_t flags, int32_t width)
+ * Input:  out -- output
+ *         value -- magnitude of the number
+ *         base -- 10 or 16
+ *         neg -- 1 to print a minus sign
+ *         flags, width -- from the conversion
+ * Return Value: none
+ * Function: Print a number padded to width with spaces or zeros */
+static void fmt_number(fmt_out_t* out, uint64_t value, uint32_t base, uint32_t neg, uint32_t flags, int32_t width)
+{
+    const int8_t* digits = (flags & FMT_UPPER) ? "0123456789ABCDEF" : "0123456789abcdef";
+    int8_t num[20];         /* 20 decimal digits of a uint64_t */
+    int32_t n = 0, pad;
+
+    do {
+        num[n++] = digits[fmt_div(&value, base)];
+    } while(value != 0);
+
+    pad = width - n - (neg ? 1 : 0);
+    if(!(flags & (FMT_LEFT | FMT_ZERO))) fmt_pad(out, ' ', pad);
+    if(neg) fmt_putc(out, '-');
+    if(flags & FMT_ZERO && !(flags & FMT_LEFT)) fmt_pad(out, '0', pad);
+    while(n > 0) fmt_putc(out, num[--n]);
+    if(flags & FMT_LEFT) fmt_pad(out, ' ', pad);
+}
 
-    while (*buf != '\0') {
-        switch (*buf) {
+/* void fmt_format(fmt_out_t* out, const int8_t* format, va_list ap)
+ * Input:  out -- output
+ *         format, ap -- format string and its arguments
+ * Return Value: none
+ * Function: The formatting engine behind printf and vsnprintf, see
+ * vsnprintf for the conversions. Unknown conversions print nothing */
+static void fmt_format(fmt_out_t* out, const int8_t* format, va_list ap)
+{
+    const int8_t* str;
+    uint32_t flags, longs, len, i;
+    int32_t width, prec;
+    int64_t sval;
+    uint64_t uval;
+
+    for(; *format != '\0'; format++){
+        if(*format != '%'){
+            fmt_putc(out, *format);
+            continue;
+        }
+
+        /* Flags, width, precision and size */
+        flags = 0;
+        for(;;){
+            format++;
+            if(*format == '-') flags |= FMT_LEFT;
+            else if(*format == '0') flags |= FMT_ZERO;
+            else if(*format == '#') flags |= FMT_ALT;
+            else break;
+        }
+        width = 0;
+        if(*format == '*'){
+            width = va_arg(ap, int32_t);
+            if(width < 0){
+                flags |= FMT_LEFT;
+                width = -width;
+            }
+            format++;
+        }
+        while(*format >= '0' && *format <= '9') width = width * 10 + (*format++ - '0');
+        prec = -1;
+        if(*format == '.'){
+            format++;
+            prec = 0;
+            if(*format == '*'){
+                prec = va_arg(ap, int32_t);
+                format++;
+            }
+            while(*format >= '0' && *format <= '9') prec = prec * 10 + (*format++ - '0');
+        }
+        for(longs = 0; *format == 'l'; format++) longs++;
+
+        switch(*format){
             case '%':
-                {
-                    int32_t alternate = 0;
-                    buf++;
-
-format_char_switch:
-                    /* Conversion specifiers */
-                    switch (*buf) {
-                        /* Print a literal '%' character */
-                        case '%':
-                            multi_putc('%');
-                            break;
-
-                        /* Use alternate formatting */
-                        case '#':
-                            alternate = 1;
-                            buf++;
-                            /* Yes, I know gotos are bad.  This is the
-                             * most elegant and general way to do this,
-                             * IMHO. */
-                            goto format_char_switch;
-
-                        /* Print a number in hexadecimal form */
-                        case 'x':
-                            {
-                                int8_t conv_buf[64];
-                                if (alternate == 0) {
-                                    itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    multi_puts(conv_buf);
-                                } else {
-                                    int32_t starting_index;
-                                    int32_t i;
-                                    itoa(*((uint32_t *)esp), &conv_buf[8], 16);
-                                    i = starting_index = strlen(&conv_buf[8]);
-                                    while(i < 8) {
-                                        conv_buf[i] = '0';
-                                        i++;
-                                    }
-                                    multi_puts(&conv_buf[starting_index]);
-                                }
-                                esp++;
-                            }
-                            break;
-
-                        /* Print a number in unsigned int form */
-                        case 'u':
-                            {
-                                int8_t conv_buf[36];
-                                itoa(*((uint32_t *)esp), conv_buf, 10);
-                                multi_puts(conv_buf);
-                                esp++;
-                            }
-                            break;
-
-                        /* Print a number in signed int form */
-                        case 'd':
-                            {
-                                int8_t conv_buf[36];
-                                int32_t value = *((int32_t *)esp);
-                                if(value < 0) {
-                                    conv_buf[0] = '-';
-                                    itoa(-value, &conv_buf[1], 10);
-                                } else {
-                                    itoa(value, conv_buf, 10);
-                                }
-                                multi_puts(conv_buf);
-                                esp++;
-                            }
-                            break;
-
-                        /* Print a single character */
-                        case 'c':
-                            multi_putc((uint8_t) *((int32_t *)esp));
-                            esp++;
-                            break;
-
-                        /* Print a NULL-terminated string */
-                        case 's':
-                            multi_puts(*((int8_t **)esp));
-                            esp++;
-                            break;
-
-                        default:
-                            break;
-                    }
+                fmt_putc(out, '%');
+                break;
+
+            case 'c':
+                if(!(flags & FMT_LEFT)) fmt_pad(out, ' ', width - 1);
+                fmt_putc(out, (int8_t)va_arg(ap, int32_t));
+                if(flags & FMT_LEFT) fmt_pad(out, ' ', width - 1);
+                break;
+
+            case 's':
+                str = va_arg(ap, const int8_t*);
+                if(str == NULL) str = "(null)";
+                for(len = 0; str[len] != '\0' && (prec < 0 || len < (uint32_t)prec); len++);
+                if(!(flags & FMT_LEFT)) fmt_pad(out, ' ', width - len);
+                for(i = 0; i < len; i++) fmt_putc(out, str[i]);
+                if(flags & FMT_LEFT) fmt_pad(out, ' ', width - len);
+                break;
+
+            case 'd':
+            case 'i':
+                sval = (longs >= 2) ? va_arg(ap, int64_t) : va_arg(ap, int32_t);
+                uval = (sval < 0) ? -(uint64_t)sval : (uint64_t)sval;
+                fmt_number(out, uval, 10, sval < 0, flags, width);
+                break;
 
+            case 'u':
+                uval = (longs >= 2) ? va_arg(ap, uint64_t) : va_arg(ap, uint32_t);
+                fmt_number(out, uval, 10, 0, flags, width);
+                break;
+
+            case 'X':
+                flags |= FMT_UPPER;
+                /* fall through */
+            case 'x':
+                uval = (longs >= 2) ? va_arg(ap, uint64_t) : va_arg(ap, uint32_t);
+                if((flags & FMT_ALT) && width == 0){
+                    flags |= FMT_ZERO;
+                    width = (longs >= 2) ? 16 : 8;
                 }
+                fmt_number(out, uval, 16, 0, flags, width);
+                break;
+
+            case 'p':
+                fmt_putc(out, '0');
+                fmt_putc(out, 'x');
+                fmt_number(out, (uint32_t)va_arg(ap, void*), 16, 0, FMT_ZERO, 8);
                 break;
 
+            case '\0':
+                /* A '%' at the very end */
+                return;
+
             default:
-                multi_putc(*buf);
                 break;
         }
-        buf++;
     }
-    return (buf - format);
 }
 
 /* int32_t puts(int8_t* s);
@@ -448,12 +560,9 @@ format_char_switch:
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index]);
-        index++;
-    }
-    return index;
+    uint32_t n = strlen(s);
+    console_write(s, n);
+    return n;
 }
 
 /* int32_t multi_puts(int8_t* s);
@@ -462,12 +571,9 @@ int32_t puts(int8_t* s) {
  * Function: Output a string to the console 
  * Only used when current shown terminal is not the terminal being executed */
 int32_t multi_puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        multi_putc(s[index]);
-        index++;
-    }
-    return index;
+    uint32_t n = strlen(s);
+    multi_console_write(s, n);
+    return n;
 }
 
 /* void putc(uint8_t c);
@@ -475,21 +581,7 @@ int32_t multi_puts(int8_t* s) {
  * Return Value: void
  * Function: Output a character to the console */
 void putc(uint8_t c) {
-    if(c == '\n' || c == '\r') {
-        enter();
-    } 
-    else {
-        video_mem = (char*)VIDEO;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-
-        if(cur_term_id==0)  *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB_T1;
-        else if(cur_term_id==1)  *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB_T2;
-        else if(cur_term_id==2)  *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB_T3;
-        else *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-
-        screen_x++;
-        set_screen_cursor(screen_x, screen_y);
-    }
+    console_write((int8_t*)&c, 1);
 }
 
 /* void multi_putc(uint8_t c);
@@ -498,20 +590,7 @@ void putc(uint8_t c) {
  * Function: Output a character to the console 
  * Only used when current shown terminal is not the terminal being executed */
 void multi_putc(uint8_t c) {
-    if(c == '\n' || c == '\r') {
-        multi_enter();
-    } 
-    else {
-        *(uint8_t *)(term[now_term_id].video_mem + ((NUM_COLS * term[now_term_id].cursor_y + term[now_term_id].cursor_x) << 1)) = c;
-
-        if(cur_term_id==0)  *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB_T1;
-        else if(cur_term_id==1)  *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB_T2;
-        else if(cur_term_id==2)  *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB_T3;
-        else *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-
-        term[now_term_id].cursor_x++;
-        multi_set_screen_cursor(term[now_term_id].cursor_x, term[now_term_id].cursor_y);
-    }
+    multi_console_write((int8_t*)&c, 1);
 }
 
 /* end of user-defined function */
@@ -576,12 +655,46 @@ int8_t* strrev(int8_t* s) {
 /* uint32_t strlen(const int8_t* s);
  * Inputs: const int8_t* s = string to take length of
  * Return Value: length of string s
- * Function: return length of string s */
+ * Function: return length of string s, scanning a word at a time */
 uint32_t strlen(const int8_t* s) {
-    register uint32_t len = 0;
-    while (s[len] != '\0')
-        len++;
-    return len;
+    const int8_t* p = s;
+
+    /* Aligned words never cross a page */
+    while ((uint32_t)p & 0x3) {
+        if (*p == '\0')
+            return p - s;
+        p++;
+    }
+    while (!HAS_ZERO(*(const str_word_t*)p))
+        p += 4;
+    while (*p != '\0')
+        p++;
+    return p - s;
+}
+
+/* int8_t* strchrnul(const int8_t* s, int8_t c);
+ * Inputs: const int8_t* s = string to search
+ *                int8_t c = character to look for
+ * Return Value: pointer to the first c in s, or to its terminating NULL
+ * Function: strlen that also stops at c, a word at a time */
+int8_t* strchrnul(const int8_t* s, int8_t c) {
+    uint32_t pattern = (uint8_t)c * WORD_ONES;
+    uint32_t w;
+
+    while ((uint32_t)s & 0x3) {
+        if (*s == '\0' || *s == c)
+            return (int8_t*)s;
+        s++;
+    }
+    for (;;) {
+        w = *(const str_word_t*)s;
+        if (HAS_ZERO(w) || HAS_ZERO(w ^ pattern))
+            break;
+        s += 4;
+    }
+    while (*s != '\0' && *s != c)
+        s++;
+    return (int8_t*)s;
 }
 
 /* void* memset(void* s, int32_t c, uint32_t n);
@@ -589,20 +702,25 @@ uint32_t strlen(const int8_t* s) {
  *          int32_t c = value to set memory to
  *         uint32_t n = number of bytes to set
  * Return Value: new string
- * Function: set n consecutive bytes of pointer s to value c */
+ * Function: set n consecutive bytes of pointer s to value c. Buffers of
+ * MEM_LARGE_MIN bytes or more go to memset_large once mem_init has run */
 void* memset(void* s, int32_t c, uint32_t n) {
+    void* d = s;
+    if(n >= MEM_LARGE_MIN && mem_features) return memset_large(s, c, n);
     c &= 0xFF;
+    /* EDI and ECX move, so they are outputs too, or an optimizing build
+     * would reuse them after the asm. Numeric labels keep it inlinable */
     asm volatile ("                 \n\
-            .memset_top:            \n\
+            1:                      \n\
             testl   %%ecx, %%ecx    \n\
-            jz      .memset_done    \n\
+            jz      3f              \n\
             testl   $0x3, %%edi     \n\
-            jz      .memset_aligned \n\
+            jz      2f              \n\
             movb    %%al, (%%edi)   \n\
             addl    $1, %%edi       \n\
             subl    $1, %%ecx       \n\
-            jmp     .memset_top     \n\
-            .memset_aligned:        \n\
+            jmp     1b              \n\
+            2:                      \n\
             movw    %%ds, %%dx      \n\
             movw    %%dx, %%es      \n\
             movl    %%ecx, %%edx    \n\
@@ -610,17 +728,17 @@ void* memset(void* s, int32_t c, uint32_t n) {
             andl    $0x3, %%edx     \n\
             cld                     \n\
             rep     stosl           \n\
-            .memset_bottom:         \n\
+            4:                      \n\
             testl   %%edx, %%edx    \n\
-            jz      .memset_done    \n\
+            jz      3f              \n\
             movb    %%al, (%%edi)   \n\
             addl    $1, %%edi       \n\
             subl    $1, %%edx       \n\
-            jmp     .memset_bottom  \n\
-            .memset_done:           \n\
+            jmp     4b              \n\
+            3:                      \n\
             "
-            :
-            : "a"(c << 24 | c << 16 | c << 8 | c), "D"(s), "c"(n)
+            : "+D"(d), "+c"(n)
+            : "a"(c << 24 | c << 16 | c << 8 | c)
             : "edx", "memory", "cc"
     );
     return s;
@@ -634,14 +752,15 @@ void* memset(void* s, int32_t c, uint32_t n) {
  * Return Value: new string
  * Function: set lower 16 bits of n consecutive memory locations of pointer s to value c */
 void* memset_word(void* s, int32_t c, uint32_t n) {
+    void* d = s;
     asm volatile ("                 \n\
             movw    %%ds, %%dx      \n\
             movw    %%dx, %%es      \n\
             cld                     \n\
             rep     stosw           \n\
             "
-            :
-            : "a"(c), "D"(s), "c"(n)
+            : "+D"(d), "+c"(n)
+            : "a"(c)
             : "edx", "memory", "cc"
     );
     return s;
@@ -654,14 +773,15 @@ void* memset_word(void* s, int32_t c, uint32_t n) {
  * Return Value: new string
  * Function: set n consecutive memory locations of pointer s to value c */
 void* memset_dword(void* s, int32_t c, uint32_t n) {
+    void* d = s;
     asm volatile ("                 \n\
             movw    %%ds, %%dx      \n\
             movw    %%dx, %%es      \n\
             cld                     \n\
             rep     stosl           \n\
             "
-            :
-            : "a"(c), "D"(s), "c"(n)
+            : "+D"(d), "+c"(n)
+            : "a"(c)
             : "edx", "memory", "cc"
     );
     return s;
@@ -672,21 +792,24 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
  *         const void* src = source of copy
  *              uint32_t n = number of byets to copy
  * Return Value: pointer to dest
- * Function: copy n bytes of src to dest */
+ * Function: copy n bytes of src to dest. Buffers of MEM_LARGE_MIN bytes
+ * or more go to memcpy_large once mem_init has run */
 void* memcpy(void* dest, const void* src, uint32_t n) {
+    void* d = dest;
+    if(n >= MEM_LARGE_MIN && mem_features) return memcpy_large(dest, src, n);
     asm volatile ("                 \n\
-            .memcpy_top:            \n\
+            1:                      \n\
             testl   %%ecx, %%ecx    \n\
-            jz      .memcpy_done    \n\
+            jz      3f              \n\
             testl   $0x3, %%edi     \n\
-            jz      .memcpy_aligned \n\
+            jz      2f              \n\
             movb    (%%esi), %%al   \n\
             movb    %%al, (%%edi)   \n\
             addl    $1, %%edi       \n\
             addl    $1, %%esi       \n\
             subl    $1, %%ecx       \n\
-            jmp     .memcpy_top     \n\
-            .memcpy_aligned:        \n\
+            jmp     1b              \n\
+            2:                      \n\
             movw    %%ds, %%dx      \n\
             movw    %%dx, %%es      \n\
             movl    %%ecx, %%edx    \n\
@@ -694,19 +817,19 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
             andl    $0x3, %%edx     \n\
             cld                     \n\
             rep     movsl           \n\
-            .memcpy_bottom:         \n\
+            4:                      \n\
             testl   %%edx, %%edx    \n\
-            jz      .memcpy_done    \n\
+            jz      3f              \n\
             movb    (%%esi), %%al   \n\
             movb    %%al, (%%edi)   \n\
             addl    $1, %%edi       \n\
             addl    $1, %%esi       \n\
             subl    $1, %%edx       \n\
-            jmp     .memcpy_bottom  \n\
-            .memcpy_done:           \n\
+            jmp     4b              \n\
+            3:                      \n\
             "
+            : "+S"(src), "+D"(d), "+c"(n)
             :
-            : "S"(src), "D"(dest), "c"(n)
             : "eax", "edx", "memory", "cc"
     );
     return dest;
@@ -720,20 +843,23 @@ void* memcpy(void* dest, const void* src, uint32_t n) {
  * Return Value: pointer to dest
  * Function: move n bytes of src to dest */
 void* memmove(void* dest, const void* src, uint32_t n) {
+    void* d = dest;
+    /* A backward copy sets DF, which the C code around expects clear */
     asm volatile ("                             \n\
             movw    %%ds, %%dx                  \n\
             movw    %%dx, %%es                  \n\
             cld                                 \n\
             cmp     %%edi, %%esi                \n\
-            jae     .memmove_go                 \n\
+            jae     1f                          \n\
             leal    -1(%%esi, %%ecx), %%esi     \n\
             leal    -1(%%edi, %%ecx), %%edi     \n\
             std                                 \n\
-            .memmove_go:                        \n\
+            1:                                  \n\
             rep     movsb                       \n\
+            cld                                 \n\
             "
+            : "+D"(d), "+S"(src), "+c"(n)
             :
-            : "D"(dest), "S"(src), "c"(n)
             : "edx", "memory", "cc"
     );
     return dest;
@@ -749,35 +875,59 @@ void* memmove(void* dest, const void* src, uint32_t n) {
  *               character that does not match has a greater value
  *               in str1 than in str2; And a value less than zero
  *               indicates the opposite.
- * Function: compares string 1 and string 2 for equality */
+ * Function: compares string 1 and string 2 for equality, a word at a
+ * time while the words match */
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n) {
-    int32_t i;
-    for (i = 0; i < n; i++) {
-        if ((s1[i] != s2[i]) || (s1[i] == '\0') /* || s2[i] == '\0' */) {
-
-            /* The s2[i] == '\0' is unnecessary because of the short-circuit
-             * semantics of 'if' expressions in C.  If the first expression
-             * (s1[i] != s2[i]) evaluates to false, that is, if s1[i] ==
-             * s2[i], then we only need to test either s1[i] or s2[i] for
-             * '\0', since we know they are equal. */
-            return s1[i] - s2[i];
+    uint32_t w;
+
+    for (;;) {
+        /* Equal words without a NULL are skipped whole. The two strings
+         * need not share an alignment, so both are checked for the end
+         * of a page */
+        while (n >= 4 && !PAGE_TAIL(s1) && !PAGE_TAIL(s2)) {
+            w = *(const str_word_t*)s1;
+            if (w != *(const str_word_t*)s2 || HAS_ZERO(w))
+                break;
+            s1 += 4;
+            s2 += 4;
+            n -= 4;
         }
+        if (n == 0)
+            return 0;
+
+        /* s2 == '\0' need not be tested: if the first test fails the two
+         * characters are equal */
+        if ((*s1 != *s2) || (*s1 == '\0'))
+            return *s1 - *s2;
+        s1++;
+        s2++;
+        n--;
     }
-    return 0;
 }
 
 /* int8_t* strcpy(int8_t* dest, const int8_t* src)
  * Inputs:      int8_t* dest = destination string of copy
  *         const int8_t* src = source string of copy
  * Return Value: pointer to dest
- * Function: copy the source string into the destination string */
+ * Function: copy the source string into the destination string, a word
+ * at a time once the source is aligned */
 int8_t* strcpy(int8_t* dest, const int8_t* src) {
-    int32_t i = 0;
-    while (src[i] != '\0') {
-        dest[i] = src[i];
-        i++;
+    int8_t* d = dest;
+    uint32_t w;
+
+    while ((uint32_t)src & 0x3) {
+        if ((*d++ = *src++) == '\0')
+            return dest;
+    }
+    for (;;) {
+        w = *(const str_word_t*)src;
+        if (HAS_ZERO(w))
+            break;
+        *(str_word_t*)d = w;
+        d += 4;
+        src += 4;
     }
-    dest[i] = '\0';
+    while ((*d++ = *src++) != '\0');
     return dest;
 }
 
@@ -786,16 +936,34 @@ int8_t* strcpy(int8_t* dest, const int8_t* src) {
  *         const int8_t* src = source string of copy
  *                uint32_t n = number of bytes to copy
  * Return Value: pointer to dest
- * Function: copy n bytes of the source string into the destination string */
+ * Function: copy n bytes of the source string into the destination
+ * string, a word at a time once the source is aligned */
 int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n) {
-    int32_t i = 0;
-    while (src[i] != '\0' && i < n) {
-        dest[i] = src[i];
-        i++;
+    int8_t* d = dest;
+    uint32_t w;
+
+    while (n > 0 && ((uint32_t)src & 0x3) && *src != '\0') {
+        *d++ = *src++;
+        n--;
+    }
+    if (!((uint32_t)src & 0x3)) {
+        while (n >= 4) {
+            w = *(const str_word_t*)src;
+            if (HAS_ZERO(w))
+                break;
+            *(str_word_t*)d = w;
+            d += 4;
+            src += 4;
+            n -= 4;
+        }
+    }
+    while (n > 0 && *src != '\0') {
+        *d++ = *src++;
+        n--;
     }
-    while (i < n) {
-        dest[i] = '\0';
-        i++;
+    while (n > 0) {
+        *d++ = '\0';
+        n--;
     }
     return dest;
 }
@@ -6,10 +6,13 @@
 #define _LIB_H
 
 #include "types.h"
+#include "x86_desc.h"
 #include "terminal.h"
 
 /* moved macro from lib.c to lib.h, so they can be used by other files */
-#define VIDEO       0xB8000
+/* text mode video memory, the kernel reaches it in the higher half */
+#define VIDEO_PHYS  0xB8000
+#define VIDEO       (KERNEL_VIRTUAL_BASE + VIDEO_PHYS)
 #define NUM_COLS    80
 #define NUM_ROWS    25
 #define ATTRIB      0x7
@@ -25,6 +28,16 @@
 #define ATTRIB_T2   0xA
 #define ATTRIB_T3   0xE
 
+/* printf formats into a buffer of this size on the stack and writes it to
+ * the screen each time it fills */
+#define PRINTF_BUF_SIZE 128
+
+/* variable arguments, from the compiler since there is no stdarg.h */
+typedef __builtin_va_list va_list;
+#define va_start(ap, last)  __builtin_va_start(ap, last)
+#define va_arg(ap, type)    __builtin_va_arg(ap, type)
+#define va_end(ap)          __builtin_va_end(ap)
+
 /* user-defined function section */
 void set_screen_cursor(uint32_t new_x,uint32_t new_y);
 void multi_set_screen_cursor(uint32_t new_x,uint32_t new_y);
@@ -40,6 +53,10 @@ void set_vidmem(char* addr);
 
 int32_t printf(int8_t *format, ...);
 int32_t multi_printf(int8_t *format, ...);
+int32_t vsnprintf(int8_t* buf, uint32_t size, const int8_t* format, va_list ap);
+int32_t snprintf(int8_t* buf, uint32_t size, const int8_t* format, ...);
+void console_write(const int8_t* s, uint32_t n);
+void multi_console_write(const int8_t* s, uint32_t n);
 void putc(uint8_t c);
 void multi_putc(uint8_t);
 int32_t puts(int8_t *s);
@@ -47,6 +64,7 @@ int32_t multi_puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
+int8_t* strchrnul(const int8_t* s, int8_t c);
 void clear(void);
 void test_interrupts(void);
 
@@ -137,8 +155,58 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Executes CPUID for the given leaf (subleaf 0) and stores the four
+ * result registers */
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx,
+                         uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid"
+            : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+            : "a"(leaf), "c"(0)
+    );
+}
+
+/* Reads the low 32 bits of a model specific register */
+static inline uint32_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile ("rdmsr"
+            : "=a"(low), "=d"(high)
+            : "c"(msr)
+    );
+    return low;
+}
+
+/* Reads the time stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t low, high;
+    asm volatile ("rdtsc"
+            : "=a"(low), "=d"(high)
+    );
+    return ((uint64_t)high << 32) | low;
+}
+
+/* Writes a model specific register, upper 32 bits zero */
+#define wrmsr(msr, low)                 \
+do {                                    \
+    asm volatile ("wrmsr"               \
+            :                           \
+            : "c"(msr), "a"(low), "d"(0)\
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* Address of the instruction where this expression appears, used to tag
+ * interrupt flag transitions with their caller */
+#define _THIS_IP_  ({ __label__ __here; __here: (uint32_t)&&__here; })
+
+/* EFLAGS interrupt enable bit */
+#define EFLAGS_IF   0x200
+
+/* irqsoff tracer hooks (irqsoff.c), called with interrupts disabled */
+void trace_irqs_off(uint32_t ip);
+void trace_irqs_on(uint32_t ip);
+
 /* Clear interrupt flag - disables interrupts on this processor */
-#define cli()                           \
+#define raw_cli()                       \
 do {                                    \
     asm volatile ("cli"                 \
             :                           \
@@ -150,7 +218,7 @@ do {                                    \
 /* Save flags and then clear interrupt flag
  * Saves the EFLAGS register into the variable "flags", and then
  * disables interrupts on this processor */
-#define cli_and_save(flags)             \
+#define raw_cli_and_save(flags)         \
 do {                                    \
     asm volatile ("                   \n\
             pushfl                    \n\
@@ -164,7 +232,7 @@ do {                                    \
 } while (0)
 
 /* Set interrupt flag - enable interrupts on this processor */
-#define sti()                           \
+#define raw_sti()                       \
 do {                                    \
     asm volatile ("sti"                 \
             :                           \
@@ -173,10 +241,22 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Enable interrupts and halt until the next one arrives. The interrupt
+ * shadow of sti covers the hlt, so an interrupt cannot be taken (and
+ * missed) between the two instructions */
+#define raw_sti_and_hlt()               \
+do {                                    \
+    asm volatile ("sti; hlt"            \
+            :                           \
+            :                           \
+            : "memory", "cc"            \
+    );                                  \
+} while (0)
+
 /* Restore flags
  * Puts the value in "flags" into the EFLAGS register.  Most often used
  * after a cli_and_save_flags(flags) */
-#define restore_flags(flags)            \
+#define raw_restore_flags(flags)        \
 do {                                    \
     asm volatile ("                   \n\
             pushl %0                  \n\
@@ -188,4 +268,39 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* The versions used by the rest of the kernel report every transition of
+ * the interrupt flag to the irqsoff tracer. The raw versions are only for
+ * the tracer itself */
+#define cli()                           \
+do {                                    \
+    raw_cli();                          \
+    trace_irqs_off(_THIS_IP_);          \
+} while (0)
+
+#define cli_and_save(flags)             \
+do {                                    \
+    raw_cli_and_save(flags);            \
+    if ((flags) & EFLAGS_IF)            \
+        trace_irqs_off(_THIS_IP_);      \
+} while (0)
+
+#define sti()                           \
+do {                                    \
+    trace_irqs_on(_THIS_IP_);           \
+    raw_sti();                          \
+} while (0)
+
+#define sti_and_hlt()                   \
+do {                                    \
+    trace_irqs_on(_THIS_IP_);           \
+    raw_sti_and_hlt();                  \
+} while (0)
+
+#define restore_flags(flags)            \
+do {                                    \
+    if ((flags) & EFLAGS_IF)            \
+        trace_irqs_on(_THIS_IP_);       \
+    raw_restore_flags(flags);           \
+} while (0)
+
 #endif /* _LIB_H */
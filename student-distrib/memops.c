@@ -0,0 +1,284 @@
+/* memops.c - memcpy and memset of large buffers, picked once at boot from
+ * what CPUID reports: fast rep movsb/stosb (ERMS), SSE2 loops of 64 bytes,
+ * and non-temporal stores past the size where caching the data only
+ * evicts everything else
+ * vim:ts=4 noexpandtab
+ */
+
+#include "memops.h"
+#include "lib.h"
+#include "fpu.h"
+
+/* The SSE loops use XMM0-XMM3 without naming them as clobbered. The rest
+ * of the kernel is built with -mno-sse and friends (NO_SIMD in the
+ * Makefile), so the compiler never keeps anything there */
+
+static void rep_movsb(void* dest, const void* src, uint32_t n);
+static void rep_stosb(void* s, uint8_t c, uint32_t n);
+static void sse2_copy(uint8_t* d, const uint8_t* s, uint32_t n, uint32_t nt);
+static void sse2_fill(uint8_t* d, uint8_t c, uint32_t n, uint32_t nt);
+
+/* void mem_init(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Note ERMS and SSE2. SSE2 only counts once fpu_init has turned
+ * on CR4.OSFXSR, which needs FXSR */
+void mem_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t max_leaf;
+
+    mem_features = 0;
+    cpuid(0, &max_leaf, &ebx, &ecx, &edx);
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if((edx & CPUID_EDX_SSE2) && (edx & CPUID_EDX_FXSR)) mem_features |= MEM_SSE2;
+
+    if(max_leaf >= 7)
+    {
+        cpuid(7, &eax, &ebx, &ecx, &edx);
+        if(ebx & CPUID_7_EBX_ERMS) mem_features |= MEM_ERMS;
+    }
+}
+
+/* void* memcpy_large(void* dest, const void* src, uint32_t n)
+ * Input:  dest, src, n -- as for memcpy, n at least MEM_LARGE_MIN
+ * Return Value: dest
+ * Function: Non-temporal SSE2 stores for huge copies, then rep movsb where
+ * the CPU makes it fast, then the SSE2 loop, then rep movsb anyway when
+ * neither is there */
+void* memcpy_large(void* dest, const void* src, uint32_t n)
+{
+    if((mem_features & MEM_SSE2) && n >= MEM_NT_MIN) return memcpy_nt(dest, src, n);
+    if(!(mem_features & MEM_ERMS) && (mem_features & MEM_SSE2))
+        sse2_copy(dest, src, n, 0);
+    else
+        rep_movsb(dest, src, n);
+    return dest;
+}
+
+/* void* memset_large(void* s, int32_t c, uint32_t n)
+ * Input:  s, c, n -- as for memset, n at least MEM_LARGE_MIN
+ * Return Value: s
+ * Function: The same choice as memcpy_large */
+void* memset_large(void* s, int32_t c, uint32_t n)
+{
+    if((mem_features & MEM_SSE2) && n >= MEM_NT_MIN) return memset_nt(s, c, n);
+    if(!(mem_features & MEM_ERMS) && (mem_features & MEM_SSE2))
+        sse2_fill(s, c, n, 0);
+    else
+        rep_stosb(s, c, n);
+    return s;
+}
+
+/* void* memcpy_nt(void* dest, const void* src, uint32_t n)
+ * Input:  dest, src, n -- as for memcpy
+ * Return Value: dest
+ * Function: Copy with MOVNTDQ, which writes around the cache */
+void* memcpy_nt(void* dest, const void* src, uint32_t n)
+{
+    if(!(mem_features & MEM_SSE2)) return memcpy(dest, src, n);
+    sse2_copy(dest, src, n, 1);
+    return dest;
+}
+
+/* void* memset_nt(void* s, int32_t c, uint32_t n)
+ * Input:  s, c, n -- as for memset
+ * Return Value: s
+ * Function: Fill with MOVNTDQ, which writes around the cache */
+void* memset_nt(void* s, int32_t c, uint32_t n)
+{
+    if(!(mem_features & MEM_SSE2)) return memset(s, c, n);
+    sse2_fill(s, c, n, 1);
+    return s;
+}
+
+/* void sse2_copy(uint8_t* d, const uint8_t* s, uint32_t n, uint32_t nt)
+ * Input:  d, s, n -- destination, source and length
+ *         nt -- 1 for non-temporal stores
+ * Return Value: none
+ * Function: Bring the destination to a 16 byte boundary with rep movsb,
+ * move 64 bytes per iteration with unaligned loads and aligned stores, one
+ * MEM_SIMD_CHUNK per kernel FPU section, and finish the tail with rep
+ * movsb. SFENCE orders the non-temporal stores before anything after.
+ * Nested in another SSE loop it is all rep movsb */
+static void sse2_copy(uint8_t* d, const uint8_t* s, uint32_t n, uint32_t nt)
+{
+    uint32_t head = (0 - (uint32_t)d) & 0xF;
+    uint32_t blocks, chunk, flags;
+
+    if(kernel_fpu_busy()) head = n;
+    if(head > n) head = n;
+    rep_movsb(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    while(n >= 64)
+    {
+        chunk = (n < MEM_SIMD_CHUNK) ? (n & ~63) : MEM_SIMD_CHUNK;
+        blocks = chunk / 64;
+
+        flags = kernel_fpu_begin();
+        if(nt)
+        {
+            asm volatile ("                         \n\
+                    1:                              \n\
+                    prefetchnta 256(%1)             \n\
+                    movdqu  (%1), %%xmm0            \n\
+                    movdqu  16(%1), %%xmm1          \n\
+                    movdqu  32(%1), %%xmm2          \n\
+                    movdqu  48(%1), %%xmm3          \n\
+                    movntdq %%xmm0, (%0)            \n\
+                    movntdq %%xmm1, 16(%0)          \n\
+                    movntdq %%xmm2, 32(%0)          \n\
+                    movntdq %%xmm3, 48(%0)          \n\
+                    addl    $64, %1                 \n\
+                    addl    $64, %0                 \n\
+                    decl    %2                      \n\
+                    jnz     1b                      \n\
+                    sfence                          \n\
+                    "
+                    : "+r"(d), "+r"(s), "+r"(blocks)
+                    :
+                    : "memory", "cc"
+            );
+        }
+        else
+        {
+            asm volatile ("                         \n\
+                    1:                              \n\
+                    movdqu  (%1), %%xmm0            \n\
+                    movdqu  16(%1), %%xmm1          \n\
+                    movdqu  32(%1), %%xmm2          \n\
+                    movdqu  48(%1), %%xmm3          \n\
+                    movdqa  %%xmm0, (%0)            \n\
+                    movdqa  %%xmm1, 16(%0)          \n\
+                    movdqa  %%xmm2, 32(%0)          \n\
+                    movdqa  %%xmm3, 48(%0)          \n\
+                    addl    $64, %1                 \n\
+                    addl    $64, %0                 \n\
+                    decl    %2                      \n\
+                    jnz     1b                      \n\
+                    "
+                    : "+r"(d), "+r"(s), "+r"(blocks)
+                    :
+                    : "memory", "cc"
+            );
+        }
+        kernel_fpu_end(flags);
+        n -= chunk;
+    }
+
+    rep_movsb(d, s, n);
+}
+
+/* void sse2_fill(uint8_t* d, uint8_t c, uint32_t n, uint32_t nt)
+ * Input:  d, n -- destination and length
+ *         c -- byte to fill with
+ *         nt -- 1 for non-temporal stores
+ * Return Value: none
+ * Function: sse2_copy's layout with one register holding 16 copies of c */
+static void sse2_fill(uint8_t* d, uint8_t c, uint32_t n, uint32_t nt)
+{
+    uint32_t head = (0 - (uint32_t)d) & 0xF;
+    uint32_t pattern = c * 0x01010101;
+    uint32_t blocks, chunk, flags;
+
+    if(kernel_fpu_busy()) head = n;
+    if(head > n) head = n;
+    rep_stosb(d, c, head);
+    d += head;
+    n -= head;
+
+    while(n >= 64)
+    {
+        chunk = (n < MEM_SIMD_CHUNK) ? (n & ~63) : MEM_SIMD_CHUNK;
+        blocks = chunk / 64;
+
+        flags = kernel_fpu_begin();
+        asm volatile ("                             \n\
+                movd    %0, %%xmm0                  \n\
+                pshufd  $0, %%xmm0, %%xmm0          \n\
+                "
+                :
+                : "r"(pattern)
+        );
+        if(nt)
+        {
+            asm volatile ("                         \n\
+                    1:                              \n\
+                    movntdq %%xmm0, (%0)            \n\
+                    movntdq %%xmm0, 16(%0)          \n\
+                    movntdq %%xmm0, 32(%0)          \n\
+                    movntdq %%xmm0, 48(%0)          \n\
+                    addl    $64, %0                 \n\
+                    decl    %1                      \n\
+                    jnz     1b                      \n\
+                    sfence                          \n\
+                    "
+                    : "+r"(d), "+r"(blocks)
+                    :
+                    : "memory", "cc"
+            );
+        }
+        else
+        {
+            asm volatile ("                         \n\
+                    1:                              \n\
+                    movdqa  %%xmm0, (%0)            \n\
+                    movdqa  %%xmm0, 16(%0)          \n\
+                    movdqa  %%xmm0, 32(%0)          \n\
+                    movdqa  %%xmm0, 48(%0)          \n\
+                    addl    $64, %0                 \n\
+                    decl    %1                      \n\
+                    jnz     1b                      \n\
+                    "
+                    : "+r"(d), "+r"(blocks)
+                    :
+                    : "memory", "cc"
+            );
+        }
+        kernel_fpu_end(flags);
+        n -= chunk;
+    }
+
+    rep_stosb(d, c, n);
+}
+
+/* void rep_movsb(void* dest, const void* src, uint32_t n)
+ * Input:  dest, src, n -- as for memcpy
+ * Return Value: none
+ * Function: Byte string move. With ERMS the CPU moves whole lines
+ * internally, otherwise it is only used for heads and tails */
+static void rep_movsb(void* dest, const void* src, uint32_t n)
+{
+    asm volatile ("                 \n\
+            movw    %%ds, %%dx      \n\
+            movw    %%dx, %%es      \n\
+            cld                     \n\
+            rep     movsb           \n\
+            "
+            : "+D"(dest), "+S"(src), "+c"(n)
+            :
+            : "edx", "memory", "cc"
+    );
+}
+
+/* void rep_stosb(void* s, uint8_t c, uint32_t n)
+ * Input:  s, c, n -- as for memset
+ * Return Value: none
+ * Function: Byte string store, the fill counterpart of rep_movsb */
+static void rep_stosb(void* s, uint8_t c, uint32_t n)
+{
+    asm volatile ("                 \n\
+            movw    %%ds, %%dx      \n\
+            movw    %%dx, %%es      \n\
+            cld                     \n\
+            rep     stosb           \n\
+            "
+            : "+D"(s), "+c"(n)
+            : "a"(c)
+            : "edx", "memory", "cc"
+    );
+}
@@ -0,0 +1,46 @@
+/* memops.h - Defines for the large buffer memcpy and memset picked at boot
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _MEMOPS_H
+#define _MEMOPS_H
+
+#include "types.h"
+
+/* CPUID bits: leaf 1 EDX SSE2, leaf 7 EBX fast rep movsb/stosb */
+#define CPUID_EDX_SSE2      0x4000000
+#define CPUID_7_EBX_ERMS    0x200
+
+/* mem_features bits */
+#define MEM_ERMS            0x1
+#define MEM_SSE2            0x2
+
+/* memcpy and memset hand buffers of MEM_LARGE_MIN bytes or more to the
+ * routines here. Below that the rep movsl in lib.c wins, and saving a
+ * process's SSE registers would not pay off */
+#define MEM_LARGE_MIN       1024
+
+/* From this size on a copy or fill would push everything else out of the
+ * cache, so it goes around it with non-temporal stores */
+#define MEM_NT_MIN          0x40000     /* 256kB */
+
+/* SSE loops run with interrupts off. They give them back between chunks
+ * of this many bytes */
+#define MEM_SIMD_CHUNK      0x10000     /* 64kB */
+
+/* What mem_init found, 0 until it has run */
+uint32_t mem_features;
+
+/* Read CPUID and choose the copy and fill routines, after fpu_init */
+void mem_init(void);
+/* Copy of n >= MEM_LARGE_MIN bytes, called by memcpy */
+void* memcpy_large(void* dest, const void* src, uint32_t n);
+/* Fill of n >= MEM_LARGE_MIN bytes, called by memset */
+void* memset_large(void* s, int32_t c, uint32_t n);
+/* Copy or fill with non-temporal stores whatever the size, for buffers that
+ * will not be read again soon: video memory backups and fresh large pages.
+ * Fall back to memcpy and memset without SSE2 */
+void* memcpy_nt(void* dest, const void* src, uint32_t n);
+void* memset_nt(void* s, int32_t c, uint32_t n);
+
+#endif /* _MEMOPS_H */
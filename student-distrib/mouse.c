@@ -4,21 +4,34 @@
 
 #include "mouse.h"
 
+static tasklet_t mouse_tasklet;
+
+static void mouse_bottom_half(uint32_t data);
+
 /* void mouse_init(void)
  * Input:  none
  * Return Value: none
  * Function: initialize mouse on PIC */
 void mouse_init(){
-    enable_irq(MOUSE_IRQ);
+    tasklet_init(&mouse_tasklet, "mouse", mouse_bottom_half, 0);
+    request_irq(MOUSE_IRQ, mouse_interrupt_handler, "mouse", NULL);
 }
 
-/* void mouse_interrupt_handler(void)
- * Input:  none
+/* int32_t mouse_interrupt_handler(uint32_t irq, void* dev)
+ * Input:  irq -- line number, dev -- unused
+ * Return Value: IRQ_HANDLED
+ * Function: called when mouse interrupt occurs. Reads the data byte so the
+ * controller can send the next one and leaves the rest to the bottom half */
+int32_t mouse_interrupt_handler(uint32_t irq, void* dev){
+    inb(MOUSE_DATA);
+    tasklet_schedule(&mouse_tasklet);
+    return IRQ_HANDLED;
+}
+
+/* void mouse_bottom_half(uint32_t data)
+ * Input:  data -- unused
  * Return Value: none
- * Function: called when mouse interrupt occurs, move cursor and set screen cursor upon press */
-void mouse_interrupt_handler(){
-    cli();
+ * Function: move cursor and set screen cursor upon press */
+static void mouse_bottom_half(uint32_t data){
     printf("Mouse interrupt has occurred!");
-    send_eoi(MOUSE_IRQ);
-    sti();
 }
@@ -10,6 +10,8 @@
 #include "i8259.h"
 #include "terminal.h"
 #include "system_call.h"
+#include "irq.h"
+#include "softirq.h"
 
 /* interrupt request vector number for mouse (We are using the USB port) */
 #define MOUSE_IRQ 12
@@ -19,6 +21,6 @@
 /* Initialization function for mouse */
 void mouse_init();
 /* Handler for the mouse interrupt */
-void mouse_interrupt_handler();
+int32_t mouse_interrupt_handler(uint32_t irq, void* dev);
 
 #endif
@@ -3,6 +3,7 @@
  */
 
 #include "paging.h"
+#include "memops.h"
 
 /* void paging_init(void);
  * Inputs: void
@@ -10,57 +11,128 @@
  * Function: Initialize the page directory, page table, and enable paging */
 void paging_init (void)
 {   
-    /* use memset to initialize page directory, number 2 enables read/write */
-    memset(page_dir, 0x00000002, dir_size*sizeof(uint32_t));
-    /* memset(page_tab, 0, tab_size*sizeof(uint32_t)); */
-
-    unsigned int i;
-    /* fill all 1024 entries in the table, mapping 4GB */
-    for(i=0; i<1024; i++)
-    {   
-        /* only need to specify the the address starting at the thirteenth bit 
-           or 3 to make the register in supervisor level, read/write, present */
-        page_tab[i] = (i*0x1000) | 2;
-    }
+    /* Nothing below KERNEL_VIRTUAL_BASE is mapped, user space starts empty */
+    memset(page_dir, 0, dir_size*sizeof(uint32_t));
 
-    /* put the newly created page table into our blank page directory, each page has size 4kB */
-    page_dir[0] = ((unsigned int)page_tab) | 3;
-    /* put the single 4MB page into the second entry of the page_dir */
-    page_dir[1] = 0x400000 | 0x83;
-    /* in lib.c, it states that video memory occupies 4kB starting at address 0xB8000 */
-    page_tab[0xB8] = page_tab[0xB8] | 3;
+    /* The first 8MB of physical memory at KERNEL_VIRTUAL_BASE: the low 1MB with
+     * video memory, the kernel's 4MB page, then the PCBs and kernel stacks.
+     * 0x183 sets the global, size, read/write and present bits */
+    page_dir[KERNEL_PDE] = 0x0 | PDE_GLOBAL | 0x83;
+    page_dir[KERNEL_PDE + 1] = 0x400000 | PDE_GLOBAL | 0x83;
+    /* the vidmap page table, its only entry stays empty until vidmap is called */
+    page_dir[VIDMAP_PDE] = virt_to_phys(page_video_tab) | 0x7;
 
     asm volatile(
-                "pushl %%eax;"
                 "movl %0, %%eax;"
                 "movl %%eax, %%cr3;"        /* load the page directory address into CR3 register */
                 "movl %%cr4, %%eax;"
-                "orl  $0x00000010, %%eax;"  /* set the fourth bit to 1 to allow mixed page size */
+                "orl  $0x00000090, %%eax;"  /* set the fourth bit to 1 to allow mixed page size,
+                                               and the seventh to keep global pages across CR3 loads */
                 "movl %%eax, %%cr4;"
                 "movl %%cr0, %%eax;"
-                "orl  $0x80000001, %%eax;"  /* enable paging and protection mode in cr0 register */
+                "orl  $0x80010001, %%eax;"  /* enable paging, write protect and protection mode in cr0 register,
+                                               write protect makes kernel writes to read-only user pages fault too */
                 "movl %%eax, %%cr0;"
                 :                           /* there is no output here */
-                :"r"(page_dir)              /* input is page_dir here */
-                :"%eax"                     /* clobbered register */
+                :"r"(virt_to_phys(page_dir)) /* input is the physical address of page_dir */
+                :"%eax", "memory"           /* clobbered register, and the directory must be written first */
     );
 }
 
-/* void pcb_mapping (uint32_t virtual_address, uint32_t physical_address)
- * Inputs: virtual address, physical address
- * Return Value: none
- * Function: Map from virtual address to physical address in page directory for our PCB */
-void pcb_mapping (uint32_t virtual_address, uint32_t physical_address)
-{   
-    /* Calculate the offset we should set as the index to the page directory, 0x400000 is 4MB */
-    uint32_t offset = virtual_address/0x400000;
+/* uint32_t* user_pte (uint32_t pcb_number, uint32_t address, uint32_t alloc)
+ * Inputs: PCB number, user address, nonzero to make a missing page table
+ * Return Value: the page table entry mapping address, reached through the
+ *               direct map, NULL if there is no page table and alloc is 0,
+ *               memory ran out, or the address is mapped by a 4MB page
+ * Function: Page tables come zeroed from the buddy allocator and are marked
+ * PTE_ANON in the directory, so user_dir_release frees them */
+uint32_t* user_pte (uint32_t pcb_number, uint32_t address, uint32_t alloc)
+{
+    uint32_t* pde = &page_proc_dir[pcb_number][address / 0x400000];
+    uint32_t* tab;
 
-    /* Set the directory to point to the physcial address we want */
-    /* Set user bit, resent bit, read/write bit, and size bit to 1 */
-    page_dir[offset] = physical_address | 0x87;
+    if(*pde & 0x80) return NULL;
+    if(!(*pde & 0x1))
+    {
+        if(!alloc) return NULL;
+        if(anon_page_map(pde) == -1) return NULL;
+    }
 
-    /* Flush the tlb */
-    flush();
+    tab = phys_to_virt(*pde & 0xFFFFF000);
+    return &tab[(address / page_align_bytes) % tab_size];
+}
+
+/* int32_t user_tab_xip (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address)
+ * Inputs: PCB number, page inside the program region, 4kB aligned frame of the filesystem image
+ * Return Value: 0 on success, -1 if no page table could be made
+ * Function: Run the page in place from the filesystem image. It is read only
+ * and marked PTE_XIP so the first write makes a private copy. The caller
+ * flushes, user_dir_switch does */
+int32_t user_tab_xip (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address)
+{
+    uint32_t* entry = user_pte(pcb_number, virtual_address, 1);
+
+    if(entry == NULL) return -1;
+
+    /* Or with 0x05 activates user level bit and enable bit, read only */
+    *entry = (physical_address & 0xFFFFF000) | PTE_XIP | 0x5;
+    return 0;
+}
+
+/* int32_t user_tab_shared (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address)
+ * Inputs: PCB number, page inside the program region, 4kB aligned frame of the filesystem image
+ * Return Value: 0 on success, -1 if no page table could be made
+ * Function: Run a page of a read only segment in place from the filesystem
+ * image. Without PTE_XIP a write to it is a fault like any other. The
+ * caller flushes, user_dir_switch does */
+int32_t user_tab_shared (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address)
+{
+    uint32_t* entry = user_pte(pcb_number, virtual_address, 1);
+
+    if(entry == NULL) return -1;
+
+    /* Or with 0x05 activates user level bit and enable bit, read only */
+    *entry = (physical_address & 0xFFFFF000) | 0x5;
+    return 0;
+}
+
+/* int32_t user_page_fault (uint32_t pcb_number, uint32_t address, uint32_t error)
+ * Inputs: PCB number of the running process, faulting address (CR2), page fault error code
+ * Return Value: 0 if the fault has been fixed, -1 if it is a real fault or memory ran out
+ * Function: A page that is not present yet gets a zeroed frame. A write to
+ * a page shared with the filesystem image gets a frame holding a copy of
+ * it, both reached through the direct map. The caller decides which
+ * addresses may be filled.
+ * Works for kernel accesses too since CR0.WP is set */
+int32_t user_page_fault (uint32_t pcb_number, uint32_t address, uint32_t error)
+{
+    uint32_t* entry;
+    uint32_t pte, frame;
+
+    entry = user_pte(pcb_number, address, 1);
+    if(entry == NULL) return -1;
+    pte = *entry;
+
+    if(!(error & 0x1))
+    {
+        /* Not present (bit 0 clear): first touch */
+        if(pte & 0x1) return -1;
+        if(anon_page_map(entry) == -1) return -1;
+    }
+    else
+    {
+        /* Only a write (bit 1) to a shared page can be copy on write */
+        if(!(error & 0x2) || !(pte & PTE_XIP)) return -1;
+        frame = buddy_alloc(0);
+        if(frame == 0) return -1;
+        memcpy(phys_to_virt(frame), phys_to_virt(pte & 0xFFFFF000), page_align_bytes);
+
+        /* Or with 0x07 activates user level bit, read/write bit, and enable bit */
+        *entry = frame | PTE_ANON | 0x7;
+    }
+
+    asm volatile("invlpg (%0)" : : "r"(address & 0xFFFFF000) : "memory");
+    return 0;
 }
 
 /* void syscall_video_mapping (uint32_t physical_address)
@@ -69,14 +141,8 @@ void pcb_mapping (uint32_t virtual_address, uint32_t physical_address)
  * Function: Map from virtual address to physical address for our video memory */
 void syscall_video_mapping (uint32_t physical_address)
 {   
-    /* 33 (132MB/4MB) is the offset we should set as the index to the page directory */
-    uint32_t offset = 33;
-
-    /* Make the page_dir points the page table points to our video memory */
-    /* Or with 0x07 activates user level bit, read/write bit, and enable bit */
-    page_dir[offset] = ((unsigned int)page_video_tab) | 0x7;
-
-    /* Make the 0th entry of the page_video_table points to physical address of video memory */
+    /* Every page directory points VIDMAP_START at page_video_tab, so only its
+     * 0th entry changes: make it point to physical address of video memory */
     /* Or with 0x07 activates user level bit, read/write bit, and enable bit */
     page_video_tab[0] = physical_address|0x7;
 
@@ -84,43 +150,260 @@ void syscall_video_mapping (uint32_t physical_address)
     flush();
 }
 
-/* void terminal_video_mapping (uint32_t physical_address, uint32_t page_idx)
- * Inputs: physical address, page index
+/* void scheduling_video_mapping (uint32_t physical_address)
+ * Inputs: physical address fordifferent terminal
  * Return Value: none
- * Function: Map from virtual address to physical address for our terminal video memory */
-void terminal_video_mapping (uint32_t physical_address, uint32_t page_idx)
+ * Function: Map from virtual address to physical address for our video memory */
+void scheduling_video_mapping (uint32_t physical_address)
 {   
-    /* Make the page_dir points the page table points to our video memory for each terminal */
+    /* Every page directory points VIDMAP_START at page_video_tab, so only its
+     * 0th entry changes: make it point to physical address of video memory */
     /* Or with 0x07 activates user level bit, read/write bit, and enable bit */
-    page_dir[0] = ((unsigned int)page_tab) | 0x3;
-
-    /* Make the specific entry of the page_table points to physical address of video memory of each terminal starting from 0xB9000 */
-    /* Or with 0x03 deactivates user level bit, activates read/write bit, and enable bit */
-    page_tab[0xB9+page_idx] = physical_address|0x3;
+    page_video_tab[0] = physical_address|0x7;
 
     /* Flush the tlb */
     flush();
 }
 
-/* void scheduling_video_mapping (uint32_t physical_address)
- * Inputs: physical address fordifferent terminal
+/* void mmio_mapping (uint32_t physical_address)
+ * Inputs: physical address of a device register block
  * Return Value: none
- * Function: Map from virtual address to physical address for our video memory */
-void scheduling_video_mapping (uint32_t physical_address)
-{   
-    /* 33 (132MB/4MB) is the offset we should set as the index to the page directory */
-    uint32_t offset = 33;
+ * Function: Identity map the 4MB region holding a device's registers, supervisor only and uncached.
+ * The APIC registers near 4GB land in the kernel half, shared by every page directory */
+void mmio_mapping (uint32_t physical_address)
+{
+    /* Calculate the offset we should set as the index to the page directory, 0x400000 is 4MB */
+    uint32_t offset = physical_address/0x400000;
 
-    /* Make the page_dir points the page table points to our video memory */
-    /* Or with 0x07 activates user level bit, read/write bit, and enable bit */
-    page_dir[offset] = ((unsigned int)page_video_tab) | 0x7;
+    /* Set global bit, size bit, cache disable bit, write through bit, read/write bit and present bit */
+    page_dir[offset] = (physical_address & 0xFFC00000) | PDE_GLOBAL | 0x9B;
+
+    /* Flush the tlb */
+    flush_global();
+}
+
+/* void paging_direct_map (uint32_t mem_end)
+ * Inputs: first byte past the end of physical memory
+ * Return Value: none
+ * Function: Map physical memory at PHYS_MAP_BASE with supervisor 4MB pages,
+ * up to the part the buddy allocator manages. The kernel's own 8MB is
+ * already there. Must run before any process page directory is built, they
+ * copy the kernel entries from page_dir */
+void paging_direct_map (uint32_t mem_end)
+{
+    uint32_t addr;
+
+    if(mem_end > BUDDY_POOL_MAX) mem_end = BUDDY_POOL_MAX;
+
+    /* Set global bit, size bit, read/write bit and present bit */
+    for(addr = 0; addr < mem_end; addr += FRAME_LARGE_SIZE)
+        page_dir[(PHYS_MAP_BASE + addr) / 0x400000] = addr | PDE_GLOBAL | 0x83;
+
+    /* Flush the tlb */
+    flush_global();
+}
+
+/* void load_page_dir (uint32_t* dir)
+ * Inputs: page directory
+ * Return Value: none
+ * Function: Switch to the page directory, which also flushes the tlb of
+ * everything but the global kernel entries */
+void load_page_dir (uint32_t* dir)
+{
+    asm volatile(
+        "movl %0, %%cr3;"
+        :                       /* there is no output */
+        :"r"(virt_to_phys(dir)) /* input is the physical address of the directory */
+        :"memory"
+    );
+}
+
+/* void user_dir_init (uint32_t pcb_number)
+ * Inputs: PCB number of a process being created
+ * Return Value: none
+ * Function: Copy the kernel's entries, and the shared vidmap table, from
+ * page_dir. Everything below KERNEL_VIRTUAL_BASE is the process's own, its
+ * page tables are added as it uses memory */
+void user_dir_init (uint32_t pcb_number)
+{
+    memcpy(page_proc_dir[pcb_number], page_dir, dir_size*sizeof(uint32_t));
+}
+
+/* void user_dir_switch (uint32_t pcb_number)
+ * Inputs: PCB number of the process about to run
+ * Return Value: none
+ * Function: Load the process's page directory */
+void user_dir_switch (uint32_t pcb_number)
+{
+    load_page_dir(page_proc_dir[pcb_number]);
+}
+
+/* void user_dir_release (uint32_t pcb_number)
+ * Inputs: PCB number of a process that is halting
+ * Return Value: none
+ * Function: Unmap all of user space, freeing the frames, 4MB pages and page
+ * tables that came from the allocator. Shared entries, like the vidmap
+ * table and pages of the filesystem image, are only cleared. The caller
+ * switches to another directory afterwards */
+void user_dir_release (uint32_t pcb_number)
+{
+    uint32_t* dir = page_proc_dir[pcb_number];
+    uint32_t* tab;
+    uint32_t i, j;
+
+    for(i=0; i<KERNEL_PDE; i++)
+    {
+        if((dir[i] & (PTE_ANON | 0x81)) == (PTE_ANON | 0x1))
+        {
+            tab = phys_to_virt(dir[i] & 0xFFFFF000);
+            for(j=0; j<tab_size; j++)
+                anon_unmap(&tab[j], 0);
+        }
+        anon_unmap(&dir[i], dir[i] & 0x80);
+    }
+}
+
+/* int32_t user_mapped (uint32_t address, uint32_t len, uint32_t write)
+ * Inputs: start and length of a user buffer
+ *         write -- nonzero if the kernel is going to write the buffer
+ * Return Value: 1 if every page is present and user accessible in the current
+ *               page directory, and writable or copy on write if asked, 0 otherwise
+ * Function: Validate user pointers outside the demand filled regions. With
+ * CR0.WP set a kernel write to a read-only page faults and halts the
+ * process, so buffers the kernel fills are checked with write set */
+int32_t user_mapped (uint32_t address, uint32_t len, uint32_t write)
+{
+    uint32_t* dir;
+    uint32_t* tab;
+    uint32_t pde, pte, page, last;
+
+    if(len == 0) len = 1;
+    if(address + len < address || address + len > PHYS_MAP_BASE) return 0;
+
+    asm volatile("movl %%cr3, %0" : "=r"(dir));
+    dir = phys_to_virt(dir);
+    last = (address + len - 1) & 0xFFFFF000;
+    for(page = address & 0xFFFFF000; ; page += page_align_bytes)
+    {
+        /* 0x05 is the user level bit and enable bit */
+        pde = dir[page / 0x400000];
+        if((pde & 0x5) != 0x5) return 0;
+        if(write && !(pde & 0x2)) return 0;
+        if(!(pde & 0x80))
+        {
+            tab = phys_to_virt(pde & 0xFFFFF000);
+            pte = tab[(page / page_align_bytes) % tab_size];
+            if((pte & 0x5) != 0x5) return 0;
+            /* 0x2 is the read/write bit, PTE_XIP pages are copied on the write */
+            if(write && !(pte & (0x2 | PTE_XIP))) return 0;
+        }
+        if(page == last) break;
+    }
+    return 1;
+}
+
+/* int32_t anon_page_map (uint32_t* entry)
+ * Inputs: an empty page table entry
+ * Return Value: 0 on success, -1 if there are no free frames
+ * Function: Fill the entry with a zeroed read/write user frame. The caller flushes */
+int32_t anon_page_map (uint32_t* entry)
+{
+    uint32_t frame = buddy_alloc(0);
+
+    if(frame == 0) return -1;
+    memset(phys_to_virt(frame), 0, FRAME_SIZE);
 
-    /* Make the 0th entry of the page_video_table points to physical address of video memory */
     /* Or with 0x07 activates user level bit, read/write bit, and enable bit */
-    page_video_tab[0] = physical_address|0x7;
+    *entry = frame | PTE_ANON | 0x7;
+    return 0;
+}
+
+/* int32_t anon_large_map (uint32_t* entry)
+ * Inputs: an empty page directory entry
+ * Return Value: 0 on success, -1 if no 4MB block is free
+ * Function: Fill the entry with a zeroed read/write user 4MB page. The caller flushes */
+int32_t anon_large_map (uint32_t* entry)
+{
+    uint32_t frame = buddy_alloc(BUDDY_LARGE_ORDER);
+
+    if(frame == 0) return -1;
+    /* 4MB of zeroes would only evict the cache, they go around it */
+    memset_nt(phys_to_virt(frame), 0, FRAME_LARGE_SIZE);
+
+    /* Set size bit, user level bit, read/write bit, and enable bit */
+    *entry = frame | PTE_ANON | 0x87;
+    return 0;
+}
+
+/* void anon_unmap (uint32_t* entry, uint32_t large)
+ * Inputs: page table entry, or page directory entry of a 4MB page if large is set
+ * Return Value: none
+ * Function: Clear the entry, freeing the frame if it is PTE_ANON. Entries of
+ * shared filesystem pages are cleared only. The caller flushes */
+void anon_unmap (uint32_t* entry, uint32_t large)
+{
+    if((*entry & (PTE_ANON | 0x1)) == (PTE_ANON | 0x1))
+    {
+        if(large) buddy_free(*entry & 0xFFC00000, BUDDY_LARGE_ORDER);
+        else buddy_free(*entry & 0xFFFFF000, 0);
+    }
+    *entry = 0;
+}
+
+/* uint32_t mmap_reserve (uint32_t pcb_number, uint32_t npages)
+ * Inputs: PCB number, number of 4kB pages wanted
+ * Return Value: virtual address of the first free run long enough, 0 if none
+ * Function: First fit search of the process's mmap window, making its page
+ * table first if needed. Nothing is marked, the caller fills the run with
+ * mmap_page before anything else can run */
+uint32_t mmap_reserve (uint32_t pcb_number, uint32_t npages)
+{
+    uint32_t* tab = user_pte(pcb_number, MMAP_START, 1);
+    uint32_t i, run = 0;
+
+    if(tab == NULL || npages == 0 || npages > tab_size) return 0;
+
+    for(i=0; i<tab_size; i++)
+    {
+        run = (tab[i] & 0x1) ? 0 : run + 1;
+        if(run == npages) return MMAP_START + (i + 1 - npages) * page_align_bytes;
+    }
+    return 0;
+}
+
+/* void mmap_page (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address)
+ * Inputs: PCB number, page inside a run from mmap_reserve, 4kB aligned frame
+ * Return Value: none
+ * Function: Map the frame read-only for user level. The caller flushes the
+ * tlb once after mapping the whole run */
+void mmap_page (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address)
+{
+    /* Or with 0x05 activates user level bit and enable bit, read only */
+    *user_pte(pcb_number, virtual_address, 0) = (physical_address & 0xFFFFF000) | 0x5;
+}
+
+/* int32_t munmap_pages (uint32_t pcb_number, uint32_t virtual_address, uint32_t npages)
+ * Inputs: PCB number, first page of the run, number of pages
+ * Return Value: 0 on success, -1 if the run leaves the window or any page in it is not mapped
+ * Function: Unmap a run of pages and flush the tlb */
+int32_t munmap_pages (uint32_t pcb_number, uint32_t virtual_address, uint32_t npages)
+{
+    uint32_t* tab = user_pte(pcb_number, MMAP_START, 0);
+    uint32_t first, i;
+
+    if(tab == NULL) return -1;
+    if(virtual_address < MMAP_START || (virtual_address & (page_align_bytes - 1))) return -1;
+    first = (virtual_address - MMAP_START) / page_align_bytes;
+    if(npages == 0 || first + npages > tab_size) return -1;
+
+    for(i=first; i<first+npages; i++)
+        if(!(tab[i] & 0x1)) return -1;
+    for(i=first; i<first+npages; i++)
+        anon_unmap(&tab[i], 0);
 
     /* Flush the tlb */
     flush();
+    return 0;
 }
 
 /* void flush(void);
@@ -134,6 +417,25 @@ void flush(void)
         "movl %%eax, %%cr3;"    /* reload cr3 register*/
         :                       /* there is no output */
         :                       /* there is no input  */
-        :"eax"                  /* eax register is clobbered regiser */
+        :"eax", "memory"        /* eax is clobbered, and page table writes must not move past the flush */
+    );
+}
+
+/* void flush_global(void);
+ * Inputs: void
+ * Return Value: none
+ * Function: flush the whole TLB, global pages too, by turning CR4.PGE off and
+ * back on. Needed after changing an entry in the kernel half */
+void flush_global(void)
+{
+    asm volatile(
+        "movl %%cr4, %%eax;"
+        "andl $0xFFFFFF7F, %%eax;"  /* clear the seventh bit, dropping every global page */
+        "movl %%eax, %%cr4;"
+        "orl  $0x00000080, %%eax;"  /* and set it again */
+        "movl %%eax, %%cr4;"
+        :                           /* there is no output */
+        :                           /* there is no input  */
+        :"eax", "memory"            /* eax register is clobbered regiser */
     );
 }
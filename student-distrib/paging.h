@@ -7,16 +7,66 @@
 
 #include "types.h"
 #include "lib.h"
+#include "buddy.h"
+#include "x86_desc.h"
 
 #define dir_size            1024
 #define tab_size            1024
 #define page_align_bytes    4096
 
+/* Program region from 128MB: the segments of the executable, usually from
+ * 0x08048000, and their .bss, then the heap up to HEAP_END. All of user
+ * space below 3GB is mapped with 4kB pages, from page tables the buddy
+ * allocator hands out the first time a 4MB range is used */
+#define USER_VIRTUAL_START  0x8000000
+#define HEAP_END            0x40000000
+
+/* User stack, grows down from the top of user space on demand up to
+ * USER_STACK_MAX. Its lowest page is never mapped, so an overflow faults
+ * instead of running into other memory */
+#define USER_STACK_TOP      0xC0000000
+#define USER_STACK_MAX      0x800000
+#define USER_STACK_GUARD    (USER_STACK_TOP - USER_STACK_MAX)
+
+/* Available bit in a page table entry: the page is shared with the
+ * filesystem image and gets a private copy on the first write */
+#define PTE_XIP             0x200
+
+/* Available bit in a page table or directory entry: the frame came from
+ * the buddy allocator and is freed along with the mapping */
+#define PTE_ANON            0x400
+
+/* mmap window, 120MB to 124MB */
+#define MMAP_START          0x7800000
+
+/* vidmap page, 124MB, shared by every process */
+#define VIDMAP_START        0x7C00000
+#define VIDMAP_PDE          31
+
+/* Number of PCB numbers, each with its own page directory */
+#define MMAP_TAB_MAX        12
+
+/* Anonymous mappings of 4MB or more, 1GB to 2.75GB, in 4MB PSE pages */
+#define ANON_LARGE_START    0x40000000
+#define ANON_LARGE_END      0xB0000000
+
+/* All physical memory the buddy allocator hands out, supervisor only, from
+ * 3GB, so the kernel can reach frames no process has mapped. The kernel
+ * image is part of it, its symbols sit at their physical address plus
+ * KERNEL_VIRTUAL_BASE */
+#define PHYS_MAP_BASE       KERNEL_VIRTUAL_BASE
+#define phys_to_virt(addr)  ((void*)((uint32_t)(addr) + PHYS_MAP_BASE))
+#define virt_to_phys(addr)  ((uint32_t)(addr) - PHYS_MAP_BASE)
+
+/* Page directory entries from PHYS_MAP_BASE up are the kernel's, the same
+ * in every directory and marked global so a CR3 load keeps them cached */
+#define KERNEL_PDE          (PHYS_MAP_BASE / 0x400000)
+#define PDE_GLOBAL          0x100
+
 /* Page Directory and Page table when we initialized the paging */
 uint32_t page_dir[dir_size] __attribute__((aligned (page_align_bytes)));
-uint32_t page_tab[tab_size] __attribute__((aligned (page_align_bytes)));
 uint32_t page_video_tab[tab_size] __attribute__((aligned (page_align_bytes)));
-uint32_t page_schedule_tab[tab_size] __attribute__((aligned (page_align_bytes)));
+uint32_t page_proc_dir[MMAP_TAB_MAX][dir_size] __attribute__((aligned (page_align_bytes)));
 
 /* New function to initialize paging */
 void paging_init (void);
@@ -24,16 +74,65 @@ void paging_init (void);
 /* Helper function to flush the TLB */
 void flush (void);
 
-/* Map from virtual address to physical address in page directory for our PCB */
-void pcb_mapping (uint32_t virtual_address, uint32_t physical_address);
+/* Flush the TLB, global kernel entries included */
+void flush_global (void);
+
+/* Map physical memory up to mem_end at PHYS_MAP_BASE */
+void paging_direct_map (uint32_t mem_end);
+
+/* Load a page directory into CR3 */
+void load_page_dir (uint32_t* dir);
+
+/* Build a process's page directory: kernel entries only */
+void user_dir_init (uint32_t pcb_number);
+
+/* Run on a process's page directory */
+void user_dir_switch (uint32_t pcb_number);
+
+/* Free every frame a process got from the buddy allocator */
+void user_dir_release (uint32_t pcb_number);
+
+/* Check that a user range is mapped for user level in the current directory,
+ * and writable if write is set */
+int32_t user_mapped (uint32_t address, uint32_t len, uint32_t write);
+
+/* Map a zeroed frame from the allocator at a page table entry */
+int32_t anon_page_map (uint32_t* entry);
+
+/* Map a zeroed 4MB run from the allocator at a page directory entry */
+int32_t anon_large_map (uint32_t* entry);
+
+/* Unmap an entry and free its frame if it came from the allocator */
+void anon_unmap (uint32_t* entry, uint32_t large);
+
+/* Page table entry of a user address, making the page table if asked to */
+uint32_t* user_pte (uint32_t pcb_number, uint32_t address, uint32_t alloc);
+
+/* Share one page of the program region with the filesystem image, copy on write */
+int32_t user_tab_xip (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address);
+
+/* Share one page of the program region with the filesystem image, read only */
+int32_t user_tab_shared (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address);
+
+/* Fill a page on first touch, or copy a shared page on first write */
+int32_t user_page_fault (uint32_t pcb_number, uint32_t address, uint32_t error);
 
 /* New function used to map virtual address for video memory to physical address */
 void syscall_video_mapping (uint32_t physical_address);
 
-/* New function used to map virtual address for terminal video memory to physical address */
-void terminal_video_mapping (uint32_t physical_address, uint32_t page_idx);
+/* Identity map the 4MB region of a memory mapped device, uncached, in the kernel half */
+void mmio_mapping (uint32_t physical_address);
 
 /* New function used to map  virtual addresss to scheduled process video memory */
 void scheduling_video_mapping (uint32_t physical_address);
 
+/* Find a run of free pages in a process's mmap window */
+uint32_t mmap_reserve (uint32_t pcb_number, uint32_t npages);
+
+/* Map one read-only user page in a process's mmap window, caller flushes */
+void mmap_page (uint32_t pcb_number, uint32_t virtual_address, uint32_t physical_address);
+
+/* Remove a run of pages from a process's mmap window */
+int32_t munmap_pages (uint32_t pcb_number, uint32_t virtual_address, uint32_t npages);
+
 #endif
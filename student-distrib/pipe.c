@@ -0,0 +1,200 @@
+/* pipe.c - Pipes: a one page ring buffer between processes, with readers
+ * sleeping while it is empty and writers while it is full
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pipe.h"
+#include "system_call.h"
+#include "buddy.h"
+#include "slab.h"
+
+static pipe_t* pipe_of(int32_t fd);
+
+/* pipe_t* pipe_alloc(void)
+ * Input:  none
+ * Return Value: the new pipe, NULL if memory ran out
+ * Function: Take a frame for the ring and a slab object for the rest. The
+ * caller puts the two ends in fds */
+pipe_t* pipe_alloc(void)
+{
+    pipe_t* p = kmalloc(sizeof(pipe_t));
+    uint32_t frame;
+
+    if(p == NULL) return NULL;
+    frame = buddy_alloc(0);
+    if(frame == 0)
+    {
+        kfree(p);
+        return NULL;
+    }
+
+    p->buf = phys_to_virt(frame);
+    p->head = 0;
+    p->tail = 0;
+    p->readers = 1;
+    p->writers = 1;
+    p->read_wait.pcbs = 0;
+    p->write_wait.pcbs = 0;
+    return p;
+}
+
+/* void pipe_release(pipe_t* p, uint32_t end)
+ * Input:  p -- pipe
+ *         end -- PIPE_READER or PIPE_WRITER
+ * Return Value: none
+ * Function: Drop one fd of an end. The other side wakes up to see end of
+ * file, or that nobody reads any more. The pipe goes once no fd is left */
+void pipe_release(pipe_t* p, uint32_t end)
+{
+    if(end == PIPE_READER)
+    {
+        p->readers--;
+        wait_wake(&p->write_wait);
+    }
+    else
+    {
+        p->writers--;
+        wait_wake(&p->read_wait);
+    }
+
+    if(p->readers == 0 && p->writers == 0)
+    {
+        buddy_free(virt_to_phys(p->buf), 0);
+        kfree(p);
+    }
+}
+
+/* uint32_t pipe_put(pipe_t* p, const uint8_t* src, uint32_t n)
+ * Input:  p -- pipe
+ *         src, n -- bytes to write
+ * Return Value: bytes copied, less than n if the ring filled up
+ * Function: Copy at the tail, in two pieces when the free space wraps */
+uint32_t pipe_put(pipe_t* p, const uint8_t* src, uint32_t n)
+{
+    uint32_t room = PIPE_SIZE - (p->tail - p->head);
+    uint32_t off = p->tail & (PIPE_SIZE - 1);
+    uint32_t first;
+
+    if(n > room) n = room;
+    first = (n < PIPE_SIZE - off) ? n : PIPE_SIZE - off;
+    memcpy(p->buf + off, src, first);
+    memcpy(p->buf, src + first, n - first);
+    p->tail += n;
+    return n;
+}
+
+/* uint32_t pipe_get(pipe_t* p, uint8_t* dst, uint32_t n)
+ * Input:  p -- pipe
+ *         dst, n -- where to read to and how much at most
+ * Return Value: bytes copied, less than n if the ring ran empty
+ * Function: Copy from the head, in two pieces when the data wraps */
+uint32_t pipe_get(pipe_t* p, uint8_t* dst, uint32_t n)
+{
+    uint32_t used = p->tail - p->head;
+    uint32_t off = p->head & (PIPE_SIZE - 1);
+    uint32_t first;
+
+    if(n > used) n = used;
+    first = (n < PIPE_SIZE - off) ? n : PIPE_SIZE - off;
+    memcpy(dst, p->buf + off, first);
+    memcpy(dst + first, p->buf, n - first);
+    p->head += n;
+    return n;
+}
+
+/* int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes)
+ * Input:  fd -- read end
+ *         buf, nbytes -- user buffer
+ * Return Value: bytes read, 0 at end of file, -1 for a bad buffer
+ * Function: Sleep while the pipe is empty and has a writer, then take what
+ * is there up to nbytes, like a read of the terminal takes one line */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    pipe_t* p = pipe_of(fd);
+    uint32_t n;
+
+    if(nbytes < 0 || !user_range_writable(buf, nbytes)) return -1;
+    if(nbytes == 0) return 0;
+
+    cli();
+    while(p->tail == p->head)
+    {
+        if(p->writers == 0) return 0;
+        wait_sleep(&p->read_wait);
+    }
+
+    n = pipe_get(p, buf, nbytes);
+    wait_wake(&p->write_wait);
+    return (int32_t)n;
+}
+
+/* int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes)
+ * Input:  fd -- write end
+ *         buf, nbytes -- user buffer
+ * Return Value: nbytes, or what was written before the last reader went
+ *               away, -1 if nothing was or for a bad buffer
+ * Function: Copy as much as fits and wake the readers, sleeping whenever
+ * the pipe is full until all of it is in */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+    pipe_t* p = pipe_of(fd);
+    uint32_t done = 0;
+
+    if(nbytes < 0 || !user_range_ok(buf, nbytes)) return -1;
+
+    cli();
+    while(done < (uint32_t)nbytes)
+    {
+        if(p->readers == 0) return (done == 0) ? -1 : (int32_t)done;
+        if(p->tail - p->head == PIPE_SIZE)
+        {
+            wait_sleep(&p->write_wait);
+            continue;
+        }
+        done += pipe_put(p, (const uint8_t*)buf + done, nbytes - done);
+        wait_wake(&p->read_wait);
+    }
+    return done;
+}
+
+/* int32_t pipe_read_close(int32_t fd)
+ * Input:  fd -- read end
+ * Return Value: 0
+ * Function: Let go of the read end */
+int32_t pipe_read_close(int32_t fd)
+{
+    pipe_release(pipe_of(fd), PIPE_READER);
+    return 0;
+}
+
+/* int32_t pipe_write_close(int32_t fd)
+ * Input:  fd -- write end
+ * Return Value: 0
+ * Function: Let go of the write end */
+int32_t pipe_write_close(int32_t fd)
+{
+    pipe_release(pipe_of(fd), PIPE_WRITER);
+    return 0;
+}
+
+/* void pipe_dup(int32_t fd)
+ * Input:  fd -- open fd of the running process
+ * Return Value: none
+ * Function: A copy of fd is being made. Count it on its end, which its
+ * close function tells */
+void pipe_dup(int32_t fd)
+{
+    file_desc_t* desc = &get_cur_pcb()->fds[fd];
+
+    if(desc->optable.close == pipe_read_close) pipe_of(fd)->readers++;
+    else if(desc->optable.close == pipe_write_close) pipe_of(fd)->writers++;
+}
+
+/* pipe_t* pipe_of(int32_t fd)
+ * Input:  fd -- pipe end of the running process
+ * Return Value: its pipe
+ * Function: The fd's inode field holds it */
+static pipe_t* pipe_of(int32_t fd)
+{
+    return (pipe_t*)get_cur_pcb()->fds[fd].inode;
+}
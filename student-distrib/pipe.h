@@ -0,0 +1,51 @@
+/* pipe.h - Defines for pipes, one page ring buffers between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "wait.h"
+
+/* Bytes a pipe holds, its ring is one buddy frame */
+#define PIPE_SIZE           0x1000
+
+/* Ends for pipe_release */
+#define PIPE_READER         0
+#define PIPE_WRITER         1
+
+/* Struct pipe_t
+ * buf : the ring, PIPE_SIZE bytes through the direct map
+ * head, tail : bytes read and written so far, the ring holds tail - head
+ * readers, writers : open fds on each end, across every process
+ * read_wait : readers sleeping on an empty pipe
+ * write_wait : writers sleeping on a full pipe */
+typedef struct {
+    uint8_t* buf;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t readers;
+    uint32_t writers;
+    wait_queue_t read_wait;
+    wait_queue_t write_wait;
+} pipe_t;
+
+/* New empty pipe with one reader and one writer, NULL if memory ran out */
+pipe_t* pipe_alloc(void);
+/* Drop one fd of an end, freeing the pipe after the last of both */
+void pipe_release(pipe_t* p, uint32_t end);
+/* Copy in as much as fits, or out as much as there is, without sleeping */
+uint32_t pipe_put(pipe_t* p, const uint8_t* src, uint32_t n);
+uint32_t pipe_get(pipe_t* p, uint8_t* dst, uint32_t n);
+
+/* file operations of the two ends, the fd's inode holds the pipe_t */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t pipe_read_close(int32_t fd);
+int32_t pipe_write_close(int32_t fd);
+/* Count one more fd on the end fd is, for dup2 and children. Nothing
+ * happens if fd is not a pipe */
+void pipe_dup(int32_t fd);
+
+#endif /* _PIPE_H */
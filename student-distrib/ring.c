@@ -0,0 +1,136 @@
+/* ring.c - Batched I/O through submission/completion rings shared with
+ * the process
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ring.h"
+#include "system_call.h"
+#include "file_system.h"
+
+static int32_t ring_issue(const ring_sqe_t* sqe, int32_t prev, int32_t have_prev);
+
+/* int32_t ring_setup(ring_t* ring)
+ * Input:  ring -- control block in the process's memory, with the entry
+ *                 counts and array pointers filled in
+ * Return Value: 0 on success, -1 if anything lies outside user memory or a
+ *               size is not a power of two up to RING_MAX_ENTRIES
+ * Function: Register the process's rings, replacing any earlier ones. The
+ * geometry is copied so later changes to the control block are ignored */
+int32_t ring_setup(ring_t* ring)
+{
+    pcb_t* cur_pcb = get_cur_pcb();
+    uint32_t sq_entries, cq_entries;
+
+    if(!user_range_writable(ring, sizeof(ring_t))) return -1;
+
+    sq_entries = ring->sq_entries;
+    cq_entries = ring->cq_entries;
+    if(sq_entries == 0 || sq_entries > RING_MAX_ENTRIES || (sq_entries & (sq_entries - 1))) return -1;
+    if(cq_entries == 0 || cq_entries > RING_MAX_ENTRIES || (cq_entries & (cq_entries - 1))) return -1;
+    if(!user_range_ok(ring->sqes, sq_entries * sizeof(ring_sqe_t))) return -1;
+    if(!user_range_writable(ring->cqes, cq_entries * sizeof(ring_cqe_t))) return -1;
+
+    cur_pcb->ring.ctl = ring;
+    cur_pcb->ring.sqes = ring->sqes;
+    cur_pcb->ring.cqes = ring->cqes;
+    cur_pcb->ring.sq_mask = sq_entries - 1;
+    cur_pcb->ring.cq_mask = cq_entries - 1;
+    return 0;
+}
+
+/* int32_t ring_enter(uint32_t to_submit)
+ * Input:  to_submit -- most submissions to consume
+ * Return Value: number of submissions consumed, -1 if no ring is registered
+ *               or the indices are corrupt
+ * Function: Run queued submissions in order, each to completion, and post a
+ * completion for each. Stops early when the completion ring is full */
+int32_t ring_enter(uint32_t to_submit)
+{
+    pcb_t* cur_pcb = get_cur_pcb();
+    ring_ctx_t* ctx = &cur_pcb->ring;
+    ring_t* ctl = ctx->ctl;
+    ring_sqe_t sqe;
+    ring_cqe_t* cqe;
+    uint32_t head, tail, done = 0;
+    int32_t res = 0, have_prev = 0;
+
+    if(ctl == NULL) return -1;
+
+    head = ctl->sq_head;
+    tail = ctl->sq_tail;
+    if(tail - head > ctx->sq_mask + 1) return -1;
+
+    while(done < to_submit && head != tail)
+    {
+        if(ctl->cq_tail - ctl->cq_head > ctx->cq_mask) break;
+
+        /* Copy the entry, the process may rewrite it while it runs */
+        sqe = ctx->sqes[head & ctx->sq_mask];
+        head++;
+
+        res = ring_issue(&sqe, res, have_prev);
+        have_prev = 1;
+
+        cqe = &ctx->cqes[ctl->cq_tail & ctx->cq_mask];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        ctl->cq_tail++;
+        ctl->sq_head = head;
+        done++;
+    }
+    return done;
+}
+
+/* int32_t ring_issue(const ring_sqe_t* sqe, int32_t prev, int32_t have_prev)
+ * Input:  sqe -- submission to run
+ *         prev -- result of the previous submission in this ring_enter
+ *         have_prev -- 0 for the first submission
+ * Return Value: result for the completion
+ * Function: Resolve links and run one submission through the same code the
+ * matching system call uses */
+static int32_t ring_issue(const ring_sqe_t* sqe, int32_t prev, int32_t have_prev)
+{
+    int32_t fd = sqe->fd;
+    int32_t len = sqe->len;
+    uint8_t name[MAX_FILENAME_LENGTH + 1];
+    const uint8_t* src;
+    int32_t i;
+
+    if(sqe->flags & RING_F_LINK_LEN)
+    {
+        if(!have_prev || prev <= 0) return 0;
+        len = prev;
+    }
+    if(sqe->flags & RING_F_LINK_FD)
+    {
+        if(!have_prev || prev < 0) return -1;
+        fd = prev;
+    }
+
+    switch(sqe->opcode)
+    {
+        case RING_OP_NOP:
+            return 0;
+        case RING_OP_READ:
+            if(len < 0 || !user_range_writable((void*)sqe->addr, len)) return -1;
+            return read(fd, (void*)sqe->addr, len);
+        case RING_OP_WRITE:
+            if(len < 0 || !user_range_ok((void*)sqe->addr, len)) return -1;
+            return write(fd, (const void*)sqe->addr, len);
+        case RING_OP_OPEN:
+            /* Copy the name in a byte at a time, it may end right at
+             * the end of user memory */
+            src = (const uint8_t*)sqe->addr;
+            for(i = 0; i < MAX_FILENAME_LENGTH; i++)
+            {
+                if(!user_range_ok(src + i, 1)) return -1;
+                if((name[i] = src[i]) == '\0') break;
+            }
+            name[i] = '\0';
+            return open(name);
+        case RING_OP_CLOSE:
+            return close(fd);
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,89 @@
+/* ring.h - Defines for the shared memory submission/completion rings
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _RING_H
+#define _RING_H
+
+#include "types.h"
+
+/* Largest ring a process may register, entries must be a power of two */
+#define RING_MAX_ENTRIES    256
+
+/* Operations a submission entry can ask for */
+#define RING_OP_NOP         0
+#define RING_OP_READ        1
+#define RING_OP_WRITE       2
+#define RING_OP_OPEN        3
+#define RING_OP_CLOSE       4
+
+/* Submission entry flags. A linked entry takes its length or its fd from
+ * the result of the entry before it in the same ring_enter call, so a whole
+ * open/read/write/close chain needs one kernel entry. A length link with a
+ * result of 0 or less completes with 0 without running; an fd link with a
+ * negative result completes with -1 */
+#define RING_F_LINK_LEN     0x1
+#define RING_F_LINK_FD      0x2
+
+/* Struct ring_sqe_t, one queued operation
+ * opcode : RING_OP_*
+ * flags : RING_F_*
+ * fd : file descriptor (read, write, close)
+ * addr : buffer (read, write) or file name (open)
+ * len : number of bytes (read, write)
+ * user_data : copied to the completion untouched */
+typedef struct {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t reserved;
+    int32_t fd;
+    uint32_t addr;
+    int32_t len;
+    uint32_t user_data;
+} ring_sqe_t;
+
+/* Struct ring_cqe_t, one finished operation
+ * user_data : from the submission entry
+ * res : what the equivalent system call would have returned */
+typedef struct {
+    uint32_t user_data;
+    int32_t res;
+} ring_cqe_t;
+
+/* Struct ring_t, the control block shared with the process. The process
+ * owns sq_tail and cq_head, the kernel owns sq_head and cq_tail. Indices run
+ * freely and are masked with entries - 1
+ * sq_head, sq_tail : consumer and producer index of the submission ring
+ * cq_head, cq_tail : consumer and producer index of the completion ring
+ * sq_entries, cq_entries : ring sizes, powers of two
+ * sqes, cqes : the ring arrays, in the process's memory */
+typedef struct {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    ring_sqe_t* sqes;
+    ring_cqe_t* cqes;
+} ring_t;
+
+/* Struct ring_ctx_t, the kernel's copy of a registered ring's geometry, so
+ * the process cannot move the arrays after ring_setup checked them
+ * ctl : control block in the process's memory, NULL if none registered
+ * sqes, cqes : the ring arrays
+ * sq_mask, cq_mask : ring sizes minus one */
+typedef struct {
+    ring_t* ctl;
+    ring_sqe_t* sqes;
+    ring_cqe_t* cqes;
+    uint32_t sq_mask;
+    uint32_t cq_mask;
+} ring_ctx_t;
+
+/* system call: register the process's rings */
+int32_t ring_setup(ring_t* ring);
+/* system call: run queued submissions and post their completions */
+int32_t ring_enter(uint32_t to_submit);
+
+#endif /* _RING_H */
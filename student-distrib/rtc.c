@@ -6,6 +6,14 @@
 
 /* Interrupt flag for whether an interrupt has received */
 int rtc_interrupt_received;
+/* Number of RTC interrupts since boot. It only advances at 1024Hz while
+ * the RTC is held or a process waits on it */
+volatile uint32_t rtc_tick_count;
+/* Kernel code holding the periodic interrupt on, and whether it is on */
+static uint32_t rtc_holders;
+static uint8_t rtc_periodic_on;
+
+static void rtc_periodic(uint8_t on);
 
 /****************** Part 1 RTC functions start here ******************/
 
@@ -13,44 +21,79 @@ int rtc_interrupt_received;
  * Input:  none
  * Return Value: none
  * Function: Initialize rtc, and its status register. 
- * enable irq8 on PIC, turns on periodic interrupt and set default frequency to 1024Hz. */
+ * enable irq8 on PIC and set the frequency to 1024Hz. The periodic interrupt
+ * stays off until a process opens or reads the RTC, or rtc_hold asks for it,
+ * so an idle system is not woken 1024 times a second */
 void rtc_init(void)
 {
-    // Initialization code, from https://wiki.osdev.org/RTC
-    outb(RTC_REG_B, RTC_INDEX);	        // select register B, and disable NMI
-    char prev = inb(RTC_DATA);	        // read the current value of register B
-    outb(RTC_REG_B, RTC_INDEX);	        // set the index again (a read will reset the index to register D)
-    outb(prev | 0x40, RTC_DATA);        // write the previous value ORed with 0x40. This turns on bit 6 of register B
+    /* Clear bit 6 of register B whatever the firmware left there */
+    rtc_periodic_on = 1;
+    rtc_periodic(0);
 
-    enable_irq(RTC_IRQ);                //enable irq8
+    request_irq(RTC_IRQ, rtc_interrupt_handler, "rtc", NULL);    //enable irq8
     
     /* For vitualizing the RTC, always 1024Hz */
-    rtc_set_freq(1024);                 
+    rtc_set_freq(RTC_BASE_FREQ);                 
 }
 
-/* void rtc_interrupt_handler(void)
+/* void rtc_hold(void)
  * Input:  none
  * Return Value: none
+ * Function: Keep the periodic interrupt on, for kernel code that times
+ * itself with rtc_tick_count. Pair with rtc_release */
+void rtc_hold(void)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    rtc_holders++;
+    rtc_periodic(1);
+    restore_flags(flags);
+}
+
+/* void rtc_release(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Drop a hold. The interrupt handler turns the periodic interrupt
+ * off once nobody holds it and no process waits on it */
+void rtc_release(void)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(rtc_holders > 0) rtc_holders--;
+    restore_flags(flags);
+}
+
+/* int32_t rtc_interrupt_handler(uint32_t irq, void* dev)
+ * Input:  irq -- line number, dev -- unused
+ * Return Value: IRQ_HANDLED
  * Function: called when an interrupt is generated by RTC. 
- * send eoi, call test_interrupt as required, and allow future interrupt. */
-void rtc_interrupt_handler(void)
+ * call test_interrupt as required, and allow future interrupt. */
+int32_t rtc_interrupt_handler(uint32_t irq, void* dev)
 {
-    send_eoi(RTC_IRQ);          //end of interrupt, send eoi
-    
     //test_interrupts();          //as required by doc
 
-    int i;
+    int i, waiting = 0;
+    pcb_t* pcb;
+
+    rtc_tick_count++;
     
-    /* Decrement counter in each terminal */
-    for(i = 0; i < TERM_MAX; i++){
-        /* Obtain the current PCB */
-        pcb_t* cur_pcb = get_pcb_from_id(term[i].cur_pcb_id + i*MAX_PCB_MASK_LEN);
-        if(cur_pcb->rtc_counter > 0) cur_pcb->rtc_counter--;
+    /* Decrement counter in each process */
+    for(i = 0; i < PCB_MAX; i++){
+        if(!PCB_in_use(i)) continue;
+        pcb = get_pcb_from_id(i);
+        if(pcb->rtc_counter > 0) pcb->rtc_counter--;
+        if(pcb->rtc_counter > 0) waiting = 1;
     }
 
+    /* Nobody is counting down any more, stop interrupting */
+    if(rtc_holders == 0 && !waiting) rtc_periodic(0);
+
     // Read from RTC register C at end of interrupt to receive future interrupt
     outb(RTC_REG_C, RTC_INDEX); // select register C
     inb(RTC_DATA);		        // just throw away contents
+    return IRQ_HANDLED;
 }
 
 /* void rtc_set_freq(int freq)
@@ -84,11 +127,12 @@ void rtc_set_freq(int freq)
 int32_t rtc_open(const uint8_t* filename)
 {   
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
     /* Virtualize the frequency to 2 and counter to 1024 / 2 for process */
     cur_pcb->rtc_freq = 2;
-    cur_pcb->rtc_counter = 1024 / (cur_pcb->rtc_freq);;
+    cur_pcb->rtc_counter = RTC_BASE_FREQ / (cur_pcb->rtc_freq);
+    rtc_periodic(1);
     return 0;
 }
 
@@ -112,13 +156,14 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes)
     sti();
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
     /* Set the counter to max freq / cur freq */
-    cur_pcb->rtc_counter = 1024 / (cur_pcb->rtc_freq);
+    cur_pcb->rtc_counter = RTC_BASE_FREQ / (cur_pcb->rtc_freq);
+    rtc_periodic(1);
 
-    /* Wait if one cycle has not finished */
-    while(cur_pcb->rtc_counter > 0);
+    /* Wait if one cycle has not finished, halting instead of spinning */
+    while(cur_pcb->rtc_counter > 0) sti_and_hlt();
 
     return 0;
 }
@@ -138,7 +183,7 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes)
     int freq = *((int*)buf);
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
     /* Check if freq is power of 2 and less than or equal to 1024 and nbytes is 4 and freq > 1 */
     if((freq && !(freq & (freq-1))) && (freq <= 1024) && (nbytes == 4) && (freq > 1)){
@@ -148,3 +193,30 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes)
     /* Return -1 indicating write failure */
     else return -1;
 }
+
+/************** Helper Functions Are In This Section **************/
+
+/* void rtc_periodic(uint8_t on)
+ * Input:  on -- 1 to turn the periodic interrupt on, 0 to turn it off
+ * Return Value: none
+ * Function: Set or clear bit 6 of register B, skipping the port writes when
+ * it is already that way. Interrupts are off so the handler cannot move
+ * the index port in between */
+static void rtc_periodic(uint8_t on)
+{
+    uint32_t flags;
+    char prev;
+
+    cli_and_save(flags);
+    if(rtc_periodic_on != on)
+    {
+        // from https://wiki.osdev.org/RTC
+        outb(RTC_REG_B, RTC_INDEX);     // select register B, and disable NMI
+        prev = inb(RTC_DATA);           // read the current value of register B
+        outb(RTC_REG_B, RTC_INDEX);     // set the index again (a read will reset the index to register D)
+        outb(on ? (prev | 0x40) : (prev & ~0x40), RTC_DATA);    // bit 6 turns on the periodic interrupt
+        rtc_periodic_on = on;
+    }
+    restore_flags(flags);
+}
+
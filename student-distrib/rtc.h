@@ -8,6 +8,7 @@
 #include "types.h"
 #include "i8259.h"
 #include "lib.h"
+#include "irq.h"
 
 /* interrupt request vector number for rtc */
 #define RTC_IRQ 8
@@ -18,11 +19,20 @@
 #define RTC_REG_A   0x8A
 #define RTC_REG_B   0x8B
 #define RTC_REG_C   0x8C
+/* the RTC always runs at this rate when it runs, processes get a virtualized frequency */
+#define RTC_BASE_FREQ   1024
+
+/* Number of RTC interrupts since boot */
+extern volatile uint32_t rtc_tick_count;
 
 /* Initialize RTC */
 void rtc_init(void);
+/* Keep the periodic interrupt on for kernel code timing with rtc_tick_count */
+void rtc_hold(void);
+/* Let it stop again once nothing waits on it */
+void rtc_release(void);
 /* RTC interrupt handler */
-void rtc_interrupt_handler(void);
+int32_t rtc_interrupt_handler(uint32_t irq, void* dev);
 /* set own frequency */
 void rtc_set_freq(int freq);
 /* set the RTC interrupts to default frequency */
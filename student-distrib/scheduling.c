@@ -4,6 +4,15 @@
 
 #include "scheduling.h"
 
+static void pit_program(uint8_t mode, uint16_t count);
+static int32_t sched_pick_boot(void);
+static int32_t sched_pick_next(int32_t cur_id, uint32_t input_ok);
+static int32_t sched_runnable(int32_t id, uint32_t input_ok);
+static int32_t sched_pcb_id(pcb_t* pcb);
+static void sched_prepare(pcb_t* next_pcb);
+static void sched_switch(pcb_t* now_pcb, pcb_t* next_pcb);
+static void tick_update(void);
+
 /* void PIT_init(void)
  * Input:  none
  * Return Value: none
@@ -13,97 +22,305 @@
  *            http://www.osdever.net/bkerndev/Docs/pit.htm */
 void pit_init(void)
 {   
-    /* Write value 0x36 to Mode/Command register to generate square waveform 
-     * and set access mode as lobyte/hibyte*/
-    outb(PIT_Mode_Three, PIT_Mode_Reg);
-
-    /* Write the lower eight bits of the divider to PIT Channel Zero */
-    outb((PIT_freq&Lower_Eight_Mask), PIT_Channel_Zero);
-
-    /* Write the remaining higher bits of the divider to PIT Channel Zero */
-    outb((PIT_freq>>Hight_Eight_bits), PIT_Channel_Zero);
+    /* Start with the periodic square waveform at 100HZ */
+    pit_program(PIT_Mode_Three, PIT_freq);
+    tick_stopped = 0;
 
     /* Enable irq0 */
-    enable_irq(PIT_IRQ);
+    request_irq(PIT_IRQ, pit_interrupt_handler, "pit", NULL);
 
     /* Initialize the first terminal to run process on */
     now_term_id = 0;
 }
 
-/* void PIT_handler(void)
- * Input:  none
- * Return Value: none
+/* int32_t pit_interrupt_handler(uint32_t irq, void* dev)
+ * Input:  irq -- line number, dev -- unused
+ * Return Value: IRQ_HANDLED
  * Function: Call the PIT_handler whenever receiving the PIT interrupts */
-void pit_interrupt_handler(void)
+int32_t pit_interrupt_handler(uint32_t irq, void* dev)
 {   
-    int32_t process_number = -1;
-    int32_t pcb_number;
+    int32_t cur_id, next_id, boot_id;
     pcb_t* now_pcb;
+
+    pit_tick_count++;
+
+    /* This handler runs on the kernel stack of whatever was interrupted */
+    now_pcb = get_cur_pcb();
+    cur_id = sched_pcb_id(now_pcb);
+
+    /* Find the next terminal to boot, or else the next process that has
+     * something to run, and decide whether the periodic tick is still needed */
+    boot_id = sched_pick_boot();
+    next_id = (boot_id == -1) ? sched_pick_next(cur_id, 0) : -1;
+    tick_update();
+
+    /* Bottom halves run with interrupts on but are not preempted, so they
+     * always finish on the kernel stack they started on */
+    if(softirq_active) return IRQ_HANDLED;
+
+    /* If a terminal has no process, boot up. execute switches away from
+     * now_pcb, and this call returns once something switches back */
+    if(boot_id != -1)
+    {
+        prev_term_id = now_term_id;
+        now_term_id = boot_id;
+        term_launch(boot_id);
+        return IRQ_HANDLED;
+    }
+
+    /* Nothing else is runnable, so stay on the current process and skip the
+     * stack switch, TLB flush and video remap entirely */
+    if(next_id == -1 || next_id == cur_id)
+    {
+        if(next_id == -1) pit_idle_count++;
+        return IRQ_HANDLED;
+    }
+
+    /* Save this process on its own kernel stack and resume the next one where
+     * it last switched away. We return from here once this process is
+     * picked again */
+    sched_switch(now_pcb, get_pcb_from_id(next_id));
+    return IRQ_HANDLED;
+}
+
+/* void sched_sleep(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Run other processes until the running one, which has just left
+ * PROC_RUNNING, is woken up again. With nothing else to run it waits in hlt.
+ * Called and returns with interrupts off */
+void sched_sleep(void)
+{
+    pcb_t* pcb = get_cur_pcb();
+    int32_t next_id;
+
+    while(pcb->state != PROC_RUNNING)
+    {
+        next_id = sched_pick_next(pcb->process_number, 0);
+        if(next_id == -1)
+        {
+            sti_and_hlt();
+            cli();
+            continue;
+        }
+        sched_switch(pcb, get_pcb_from_id(next_id));
+    }
+}
+
+/* void sched_exit(void)
+ * Input:  none
+ * Return Value: does not return
+ * Function: Leave a halted process's stack for good and resume another
+ * process, one waiting for keyboard input if nothing else can run, since it
+ * sleeps in hlt by itself. Called with interrupts off */
+void sched_exit(void)
+{
+    pcb_t* pcb = get_cur_pcb();
     pcb_t* next_pcb;
-    term_t next_term;
+    int32_t next_id;
 
-    /* Send end of interrupts for irq0, which is for PIT_irq */
-    send_eoi(PIT_IRQ);
-    cli();
+    while((next_id = sched_pick_next(pcb->process_number, 1)) == -1)
+    {
+        sti_and_hlt();
+        cli();
+    }
 
-    /* Find the next terminal we need to process, and the next PCB and process number */
-    next_term_id = (now_term_id + 1) % TERM_MAX;
-    process_number = term[next_term_id].cur_pcb_id;
-    pcb_number = process_number + next_term_id * MAX_PCB_MASK_LEN;
+    next_pcb = get_pcb_from_id(next_id);
+    sched_prepare(next_pcb);
+    task_enter(&next_pcb->ctx);
+}
 
-    now_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id+now_term_id*MAX_PCB_MASK_LEN);
-    
-    prev_term_id = now_term_id;
-    now_term_id = next_term_id;
-    
-    /* Update EBP and ESP */
-    asm volatile(
-        "movl %%ebp, %%eax;"
-        "movl %%esp, %%ebx;"
-        /* there is no input here */
-        :"=a"(now_pcb->kbp), "=b"(now_pcb->ksp)
-    );
-
-    /* If the next terminal has no process, boot up */
-    if(term[next_term_id].cur_pcb_id == -1) 
-    {   
-        term_launch(next_term_id); 
-        return;
+/* void task_ctx_init(task_ctx_t* ctx, uint32_t pcb_number)
+ * Input:  ctx -- context in the PCB of a process being created
+ *         pcb_number -- its PCB number, which picks its kernel stack and page directory
+ * Return Value: none
+ * Function: Fill in the TSS stack top and the page directory switch_to loads */
+void task_ctx_init(task_ctx_t* ctx, uint32_t pcb_number)
+{
+    /* 8MB - PCB_numbr * 8KB - 4 */
+    ctx->esp0 = KERNEL_STACK_TOP - pcb_number * 0x2000 - 0x4;
+    ctx->cr3 = virt_to_phys(page_proc_dir[pcb_number]);
+}
+
+/* void task_prepare(task_ctx_t* ctx, uint32_t entry, uint32_t user_esp)
+ * Input:  ctx -- context from task_ctx_init
+ *         entry, user_esp -- where the process starts in user mode
+ * Return Value: none
+ * Function: Put the frame switch_to pops on top of the process's kernel
+ * stack, so the first switch to it returns into task_start with the entry
+ * point in EBX and the user stack in ESI. The stack must not be the one
+ * running, task_enter_user covers that case */
+void task_prepare(task_ctx_t* ctx, uint32_t entry, uint32_t user_esp)
+{
+    uint32_t* sp = (uint32_t*)ctx->esp0;
+
+    /* Popped by switch_to: EDI, ESI, EBX, EBP, then its return address */
+    *--sp = (uint32_t)task_start;
+    *--sp = 0;          /* EBP */
+    *--sp = entry;      /* EBX */
+    *--sp = user_esp;   /* ESI */
+    *--sp = 0;          /* EDI */
+    ctx->ksp = (uint32_t)sp;
+}
+
+/* void tick_restart(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Leave one-shot mode and go back to the periodic 100HZ tick. Called
+ * whenever a terminal becomes runnable again while the tick is stopped */
+void tick_restart(void)
+{
+    if(!tick_stopped) return;
+    tick_stopped = 0;
+    pit_program(PIT_Mode_Three, PIT_freq);
+}
+
+/* void pit_program(uint8_t mode, uint16_t count)
+ * Input:  mode -- value for the Mode/Command register
+ *         count -- reload value for channel zero
+ * Return Value: none
+ * Function: Program PIT channel zero with the given mode and count, lobyte first */
+static void pit_program(uint8_t mode, uint16_t count)
+{
+    outb(mode, PIT_Mode_Reg);
+    outb((count&Lower_Eight_Mask), PIT_Channel_Zero);
+    outb((count>>Hight_Eight_bits), PIT_Channel_Zero);
+}
+
+/* int32_t sched_pick_boot(void)
+ * Input:  none
+ * Return Value: id of the next terminal without a shell, -1 if all have one
+ * Function: Round robin over the terminals, starting after the current one */
+static int32_t sched_pick_boot(void)
+{
+    int32_t i, id;
+
+    for(i = 1; i <= TERM_MAX; i++)
+    {
+        id = (now_term_id + i) % TERM_MAX;
+        if(term[id].cur_pcb_id == -1) return id;
     }
+    return -1;
+}
+
+/* int32_t sched_pick_next(int32_t cur_id, uint32_t input_ok)
+ * Input:  cur_id -- process number of the running process, -1 if none
+ *         input_ok -- 1 to also take a process waiting for keyboard input
+ * Return Value: process number of the next process to run, -1 if none
+ * Function: Round robin over every process, starting after the current one
+ * and ending with it, so several processes of one terminal share the CPU
+ * like processes of different terminals do */
+static int32_t sched_pick_next(int32_t cur_id, uint32_t input_ok)
+{
+    int32_t i, id;
+
+    if(cur_id < 0) cur_id = PCB_MAX - 1;
+    for(i = 1; i <= PCB_MAX; i++)
+    {
+        id = (cur_id + i) % PCB_MAX;
+        if(sched_runnable(id, input_ok)) return id;
+    }
+    return -1;
+}
+
+/* int32_t sched_runnable(int32_t id, uint32_t input_ok)
+ * Input:  id -- process number
+ *         input_ok -- 1 to count a process waiting for keyboard input
+ * Return Value: 1 if the process can run, 0 otherwise
+ * Function: Only PROC_RUNNING processes can. Only the process the keyboard
+ * goes to waits for input, the others read end of file */
+static int32_t sched_runnable(int32_t id, uint32_t input_ok)
+{
+    pcb_t* pcb;
+    term_t* t;
+
+    if(!PCB_in_use(id)) return 0;
+    pcb = get_pcb_from_id(id);
+    if(pcb->state != PROC_RUNNING) return 0;
+
+    t = &term[pcb->term_id];
+    if(!input_ok && t->waiting && t->cur_pcb_id == id % MAX_PCB_MASK_LEN) return 0;
+    return 1;
+}
 
-    /* Process switch */
+/* int32_t sched_pcb_id(pcb_t* pcb)
+ * Input:  pcb -- from get_cur_pcb
+ * Return Value: its process number, -1 if the stack is not a process's
+ * Function: Work the number out from the address, which is also right on
+ * the boot stack, where the PCB fields hold nothing */
+static int32_t sched_pcb_id(pcb_t* pcb)
+{
+    uint32_t offset = KERNEL_STACK_TOP - (uint32_t)pcb;
 
-    /* Find the pcb for the current terminal and the pcb for the next terminal */
-    next_pcb = get_pcb_from_id(term[next_term_id].cur_pcb_id+next_term_id*MAX_PCB_MASK_LEN);    
+    if((uint32_t)pcb >= KERNEL_STACK_TOP || offset > PCB_MAX * 0x2000) return -1;
+    if(!PCB_in_use(offset / 0x2000 - 1)) return -1;
+    return offset / 0x2000 - 1;
+}
 
-    /* Map parent's virtual address 0x8000000 (128MB) to physical address 0x800000 (8MB),
-     * plus some number times 0x400000 (4MB), used to map the next program */
-    pcb_mapping(0x8000000, 0x800000 + pcb_number * 0x400000);
+/* void sched_prepare(pcb_t* next_pcb)
+ * Input:  next_pcb -- process about to be resumed
+ * Return Value: none
+ * Function: Make its terminal the running one, and point the video memory
+ * at the screen if that terminal is shown, or at its saved page otherwise */
+static void sched_prepare(pcb_t* next_pcb)
+{
+    prev_term_id = now_term_id;
+    now_term_id = next_pcb->term_id;
 
-    /* Check whether next term_id is not equal to the current term_id, if not we map 
-     * the virtual address to the pre-saved address of that terminal */
-    next_term = term[next_pcb->term_id];
-    
-    if(cur_term_id!=now_term_id){
-        scheduling_video_mapping((uint32_t)next_term.video_mem);
-        set_vidmem((char*)next_term.video_mem);
-    }    
+    /* Its first FPU instruction traps unless the registers are still its */
+    fpu_switch(next_pcb->process_number);
+
+    if(cur_term_id != now_term_id){
+        scheduling_video_mapping(term[now_term_id].video_phys);
+        set_vidmem((char*)term[now_term_id].video_mem);
+    }
     /* Otherwise map to B8000 (Video memory of currently viewing) */
     else{
-        scheduling_video_mapping(0xB8000);
-        set_vidmem((char*)0xB8000);
+        scheduling_video_mapping(VIDEO_PHYS);
+        set_vidmem((char*)VIDEO);
     }
+}
 
-    /* Modify TSS */
-    tss.ss0 = KERNEL_DS;
-    /* 8MB - PCB_numbr * 8KB - 4 */
-    tss.esp0 = 0x800000 - pcb_number * 0x2000 - 0x4;
-
-    asm volatile(
-        "movl %0, %%ebp;"
-        "movl %1, %%esp;"
-        :/* there is no output here */
-        :"r"(next_pcb->kbp),"r"(next_pcb->ksp)
-    );
-    return;
+/* void sched_switch(pcb_t* now_pcb, pcb_t* next_pcb)
+ * Input:  now_pcb -- running process, or the stack it was booted from
+ *         next_pcb -- process to resume
+ * Return Value: none
+ * Function: Save this process on its own kernel stack and resume the next
+ * one where it last switched away. switch_to also loads the next page
+ * directory, which maps its program region at virtual address 0x8000000
+ * (128MB), and its kernel stack into the TSS. Returns once something
+ * switches back */
+static void sched_switch(pcb_t* now_pcb, pcb_t* next_pcb)
+{
+    sched_prepare(next_pcb);
+    switch_to(&now_pcb->ctx, &next_pcb->ctx);
+}
+
+/* void tick_update(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Stop the periodic tick when at most one process is runnable,
+ * counting a terminal still to boot as one. No
+ * kernel timer is driven by the PIT, so the one-shot is armed for the longest
+ * interval the counter allows and acts only as a watchdog; keyboard input
+ * restarts the periodic tick through tick_restart() */
+static void tick_update(void)
+{
+    int32_t i, runnable = 0;
+
+    for(i = 0; i < TERM_MAX; i++)
+    {
+        if(term[i].cur_pcb_id == -1) runnable++;
+    }
+    for(i = 0; i < PCB_MAX; i++)
+    {
+        if(sched_runnable(i, 0)) runnable++;
+    }
+
+    if(runnable <= 1)
+    {
+        tick_stopped = 1;
+        pit_program(PIT_Mode_Zero, PIT_Oneshot_Max);
+    }
+    else tick_restart();
 }
@@ -12,6 +12,9 @@
 #include "i8259.h"
 #include "x86_desc.h"
 #include "system_call.h"
+#include "irq.h"
+#include "softirq.h"
+#include "switch.h"
 
 /******* Define Terms *******/ 
 #define PIT_freq            11931   /* Set the PIT frequency to 100HZ(Get frequency by using PIT_freq = 1193180/HZ_WE_WANT)*/
@@ -19,20 +22,43 @@
 #define PIT_Channel_Zero    0x40
 #define PIT_Mode_Reg        0x43
 #define PIT_Mode_Three      0x36
+#define PIT_Mode_Zero       0x30    /* Channel 0, lobyte/hibyte, mode 0 (interrupt on terminal count) */
+#define PIT_Oneshot_Max     0xFFFF  /* Longest one-shot the 16-bit counter allows, about 55ms */
 #define Hight_Eight_bits    8
 #define Lower_Eight_Mask    0xFF
 
 /******* Global Variable *******/
 
-/* The process has been lastly processed */
+/* Terminal of the running process, and the one before it */
 int32_t now_term_id;
-int32_t next_term_id;
 int32_t prev_term_id;
 
+/* Number of PIT interrupts taken, and how many of them found nothing else to run */
+volatile uint32_t pit_tick_count;
+volatile uint32_t pit_idle_count;
+
+/* Set while the periodic tick is stopped and the PIT is armed as a one-shot */
+volatile uint8_t tick_stopped;
+
 /* Initialize Programmable Interrupt Time (PIT) */
 void pit_init(void);
 
 /* PIT handlers here */
-void pit_interrupt_handler(void);
+int32_t pit_interrupt_handler(uint32_t irq, void* dev);
+
+/* Run other processes until the running one is PROC_RUNNING again */
+void sched_sleep(void);
+
+/* Leave a halted process for good and resume another one */
+void sched_exit(void) __attribute__((noreturn));
+
+/* Put the PIT back into periodic mode when a process becomes runnable */
+void tick_restart(void);
+
+/* Point a new process's context at its kernel stack and page directory */
+void task_ctx_init(task_ctx_t* ctx, uint32_t pcb_number);
+
+/* Build the frame that makes the first switch_to to a new process enter user mode */
+void task_prepare(task_ctx_t* ctx, uint32_t entry, uint32_t user_esp);
 
 #endif
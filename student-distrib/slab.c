@@ -0,0 +1,311 @@
+/* slab.c - Slab allocator of kernel objects on top of the buddy allocator,
+ * and kmalloc built from one cache per size class
+ * vim:ts=4 noexpandtab
+ */
+
+#include "slab.h"
+#include "paging.h"
+#include "lib.h"
+
+#define SLAB_OF(obj)        ((slab_t*)((uint32_t)(obj) & ~(SLAB_SIZE - 1)))
+#define FREE_LINK(c, obj)   (*(void**)((uint8_t*)(obj) + (c)->free_off))
+
+/* Struct slab_t, the header in the first cache line of every slab
+ * next, prev : neighbours on the cache's partial or full list
+ * cache : cache owning the slab
+ * free : first free object, linked through FREE_LINK
+ * inuse : objects handed out */
+typedef struct slab {
+    struct slab* next;
+    struct slab* prev;
+    kmem_cache_t* cache;
+    void* free;
+    uint32_t inuse;
+} slab_t;
+
+static kmem_cache_t kmem_caches[SLAB_CACHE_MAX];
+static kmem_cache_t* kmalloc_caches[KMALLOC_CLASSES];
+static const int8_t* kmalloc_names[KMALLOC_CLASSES] = {
+    "kmalloc-32", "kmalloc-64", "kmalloc-128", "kmalloc-256",
+    "kmalloc-512", "kmalloc-1024", "kmalloc-2048",
+};
+
+static slab_t* slab_grow(kmem_cache_t* cache);
+static void slab_list_add(slab_t** list, slab_t* slab);
+static void slab_list_del(slab_t** list, slab_t* slab);
+
+/* void kmem_init(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Create the kmalloc caches. Their slabs come from the buddy
+ * allocator on first use, so this can run as soon as buddy_init has */
+void kmem_init(void)
+{
+    uint32_t i;
+
+    for(i = 0; i < KMALLOC_CLASSES; i++)
+        kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i], KMALLOC_MIN << i, NULL);
+}
+
+/* kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, kmem_ctor_t ctor)
+ * Input:  name -- shown in slabinfo, must stay valid
+ *         size -- bytes per object
+ *         ctor -- run on each object when its slab is made, may be NULL
+ * Return Value: the cache, NULL if size is 0 or over SLAB_OBJ_MAX, or every
+ *               cache slot is taken
+ * Function: Pick the object layout. Without a constructor the free list
+ * link overlays the start of a free object; with one it gets its own word
+ * past the object so the constructed state survives a free */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, kmem_ctor_t ctor)
+{
+    kmem_cache_t* cache = NULL;
+    uint32_t flags;
+    uint32_t i, raw;
+
+    if(name == NULL || size == 0 || size > SLAB_OBJ_MAX) return NULL;
+
+    raw = (size + 3) & ~3;
+    if(ctor != NULL) raw += sizeof(void*);
+
+    cli_and_save(flags);
+    for(i = 0; i < SLAB_CACHE_MAX; i++)
+    {
+        if(kmem_caches[i].name == NULL)
+        {
+            cache = &kmem_caches[i];
+            break;
+        }
+    }
+    if(cache == NULL)
+    {
+        restore_flags(flags);
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name;
+    cache->obj_size = size;
+    cache->ctor = ctor;
+    cache->free_off = (ctor != NULL) ? raw - sizeof(void*) : 0;
+    if(raw < CACHE_LINE_SIZE)
+    {
+        for(cache->size = sizeof(void*); cache->size < raw; cache->size <<= 1);
+    }
+    else
+    {
+        cache->size = (raw + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+    }
+    cache->per_slab = (SLAB_SIZE - CACHE_LINE_SIZE) / cache->size;
+    restore_flags(flags);
+    return cache;
+}
+
+/* int32_t kmem_cache_destroy(kmem_cache_t* cache)
+ * Input:  cache -- from kmem_cache_create
+ * Return Value: 0 on success, -1 if objects are still allocated
+ * Function: Free the spare slab and release the cache slot */
+int32_t kmem_cache_destroy(kmem_cache_t* cache)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(cache->active != 0)
+    {
+        restore_flags(flags);
+        return -1;
+    }
+    if(cache->empty != NULL) buddy_free((uint32_t)cache->empty - PHYS_MAP_BASE, SLAB_ORDER);
+    cache->name = NULL;
+    restore_flags(flags);
+    return 0;
+}
+
+/* void* kmem_cache_alloc(kmem_cache_t* cache)
+ * Input:  cache -- cache to allocate from
+ * Return Value: an object, NULL if no slab could be made
+ * Function: Take the first free object of the first partial slab, falling
+ * back to the spare slab and then to a new one. No search: the partial
+ * list only holds slabs with a free object */
+void* kmem_cache_alloc(kmem_cache_t* cache)
+{
+    slab_t* slab;
+    void* obj;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    slab = cache->partial;
+    if(slab == NULL)
+    {
+        slab = cache->empty;
+        cache->empty = NULL;
+        if(slab == NULL) slab = slab_grow(cache);
+        if(slab == NULL)
+        {
+            cache->fails++;
+            restore_flags(flags);
+            return NULL;
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    obj = slab->free;
+    slab->free = FREE_LINK(cache, obj);
+    if(++slab->inuse == cache->per_slab)
+    {
+        slab_list_del(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    cache->active++;
+    cache->allocs++;
+    restore_flags(flags);
+    return obj;
+}
+
+/* void kmem_cache_free(kmem_cache_t* cache, void* obj)
+ * Input:  cache -- cache the object came from
+ *         obj -- object from kmem_cache_alloc
+ * Return Value: none
+ * Function: Push the object on its slab's free list. A slab that empties
+ * becomes the spare, and a second empty slab goes back to the buddy
+ * allocator */
+void kmem_cache_free(kmem_cache_t* cache, void* obj)
+{
+    slab_t* slab = SLAB_OF(obj);
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(slab->inuse-- == cache->per_slab)
+    {
+        slab_list_del(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+    FREE_LINK(cache, obj) = slab->free;
+    slab->free = obj;
+
+    if(slab->inuse == 0)
+    {
+        slab_list_del(&cache->partial, slab);
+        if(cache->empty == NULL)
+        {
+            cache->empty = slab;
+        }
+        else
+        {
+            buddy_free((uint32_t)slab - PHYS_MAP_BASE, SLAB_ORDER);
+            cache->slabs--;
+        }
+    }
+
+    cache->active--;
+    cache->frees++;
+    restore_flags(flags);
+}
+
+/* void* kmalloc(uint32_t size)
+ * Input:  size -- bytes wanted
+ * Return Value: memory aligned to the size class, or to a cache line from
+ *               64 bytes up, NULL if size is 0 or over SLAB_OBJ_MAX
+ * Function: Allocate from the smallest size class that fits */
+void* kmalloc(uint32_t size)
+{
+    uint32_t i;
+
+    if(size == 0) return NULL;
+    for(i = 0; i < KMALLOC_CLASSES; i++)
+    {
+        if(size <= (KMALLOC_MIN << i)) return kmem_cache_alloc(kmalloc_caches[i]);
+    }
+    return NULL;
+}
+
+/* void kfree(void* ptr)
+ * Input:  ptr -- memory from kmalloc, or NULL
+ * Return Value: none
+ * Function: Free into the cache named by the slab header */
+void kfree(void* ptr)
+{
+    if(ptr == NULL) return;
+    kmem_cache_free(SLAB_OF(ptr)->cache, ptr);
+}
+
+/* void slabinfo_show(special_buf_t* b)
+ * Input:  b -- buffer to fill
+ * Return Value: none
+ * Function: One line per cache: object size, objects in use and in total,
+ * slabs, and the alloc, free and failure counters. active is allocs minus
+ * frees, so a count that only grows points at a leak */
+void slabinfo_show(special_buf_t* b)
+{
+    kmem_cache_t* cache;
+    uint32_t i;
+
+    special_puts(b, "name           size active  total slabs  allocs   frees fails\n");
+    for(i = 0; i < SLAB_CACHE_MAX; i++)
+    {
+        cache = &kmem_caches[i];
+        if(cache->name == NULL) continue;
+
+        special_printf(b, "%-14s%5u%7u%7u%6u%8u%8u%6u\n", cache->name, cache->size,
+                       cache->active, cache->slabs * cache->per_slab, cache->slabs,
+                       cache->allocs, cache->frees, cache->fails);
+    }
+}
+
+/* slab_t* slab_grow(kmem_cache_t* cache)
+ * Input:  cache -- cache that ran out of free objects
+ * Return Value: a slab with every object free, NULL if the buddy allocator is out
+ * Function: Lay the objects out after the header, run the constructor on
+ * each and chain them so the lowest address is handed out first. The caller
+ * has interrupts off */
+static slab_t* slab_grow(kmem_cache_t* cache)
+{
+    uint32_t frame = buddy_alloc(SLAB_ORDER);
+    slab_t* slab;
+    uint8_t* obj;
+    uint32_t i;
+
+    if(frame == 0) return NULL;
+    slab = phys_to_virt(frame);
+    slab->next = slab->prev = NULL;
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free = NULL;
+
+    for(i = cache->per_slab; i-- > 0;)
+    {
+        obj = (uint8_t*)slab + CACHE_LINE_SIZE + i * cache->size;
+        if(cache->ctor != NULL) cache->ctor(obj);
+        FREE_LINK(cache, obj) = slab->free;
+        slab->free = obj;
+    }
+
+    cache->slabs++;
+    return slab;
+}
+
+/* void slab_list_add(slab_t** list, slab_t* slab)
+ * Input:  list -- head of a partial or full list
+ *         slab -- slab on no list
+ * Return Value: none
+ * Function: Push the slab at the head */
+static void slab_list_add(slab_t** list, slab_t* slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if(slab->next != NULL) slab->next->prev = slab;
+    *list = slab;
+}
+
+/* void slab_list_del(slab_t** list, slab_t* slab)
+ * Input:  list -- head of the list holding the slab
+ *         slab -- slab to unlink
+ * Return Value: none
+ * Function: Unlink the slab */
+static void slab_list_del(slab_t** list, slab_t* slab)
+{
+    if(slab->prev != NULL) slab->prev->next = slab->next;
+    else *list = slab->next;
+    if(slab->next != NULL) slab->next->prev = slab->prev;
+    slab->next = slab->prev = NULL;
+}
@@ -0,0 +1,82 @@
+/* slab.h - Defines for the slab allocator of kernel objects and kmalloc
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "buddy.h"
+#include "special_file.h"
+
+/* Objects of 64 bytes or more start on a cache line, smaller ones are
+ * rounded to a power of two so none straddles two lines */
+#define CACHE_LINE_SIZE     64
+
+/* Every slab is one 8kB buddy block. Its first cache line is the slab
+ * header, found from any object by rounding its address down */
+#define SLAB_ORDER          1
+#define SLAB_SIZE           (FRAME_SIZE << SLAB_ORDER)
+#define SLAB_OBJ_MAX        2048
+
+/* kmalloc size classes, 32 bytes to SLAB_OBJ_MAX in powers of two */
+#define KMALLOC_MIN         32
+#define KMALLOC_CLASSES     7
+
+/* Most caches that can exist at once, kmalloc's included */
+#define SLAB_CACHE_MAX      24
+
+/* Called once on every object when its slab is created. Objects are
+ * expected back in kmem_cache_free in the same state, so a reused object
+ * needs no constructor call */
+typedef void (*kmem_ctor_t)(void* obj);
+
+struct slab;
+
+/* Struct kmem_cache_t, a cache of objects of one size
+ * name : shown in slabinfo, NULL if the slot is unused
+ * obj_size : size asked for in kmem_cache_create
+ * size : space each object takes in a slab
+ * free_off : offset of the free list link inside a free object
+ * per_slab : objects in one slab
+ * ctor : constructor, may be NULL
+ * partial, full : slabs with some and with no free objects
+ * empty : one spare slab with every object free, kept to absorb churn
+ * slabs : slabs owned, the spare included
+ * active : objects allocated and not freed
+ * allocs, frees, fails : counters of kmem_cache_alloc and kmem_cache_free */
+typedef struct kmem_cache {
+    const int8_t* name;
+    uint32_t obj_size;
+    uint32_t size;
+    uint32_t free_off;
+    uint32_t per_slab;
+    kmem_ctor_t ctor;
+    struct slab* partial;
+    struct slab* full;
+    struct slab* empty;
+    uint32_t slabs;
+    uint32_t active;
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t fails;
+} kmem_cache_t;
+
+/* Set up the kmalloc size classes */
+void kmem_init(void);
+/* New cache of objects of size bytes, NULL if size is too large or no slot is free */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size, kmem_ctor_t ctor);
+/* Remove a cache with no objects allocated, -1 if it still has some */
+int32_t kmem_cache_destroy(kmem_cache_t* cache);
+/* One object from the cache, NULL if memory ran out */
+void* kmem_cache_alloc(kmem_cache_t* cache);
+/* Give an object back to its cache */
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+/* size bytes from the smallest size class that fits, NULL if none does */
+void* kmalloc(uint32_t size);
+/* Give back memory from kmalloc, NULL is ignored */
+void kfree(void* ptr);
+/* Special file "slabinfo": one line of counters per cache */
+void slabinfo_show(special_buf_t* b);
+
+#endif /* _SLAB_H */
@@ -0,0 +1,144 @@
+/* softirq.c - Deferred interrupt work run at IRQ exit
+ * vim:ts=4 noexpandtab
+ */
+
+#include "softirq.h"
+#include "lib.h"
+
+/* Tasklets waiting to run, in the order they were queued */
+static tasklet_t* tasklet_head = NULL;
+static tasklet_t** tasklet_tail = &tasklet_head;
+
+/* Tasklets taken off the pending list that softirq_run has not reached yet */
+static tasklet_t* tasklet_run;
+
+/* Every initialized tasklet, for the softirqs file */
+static tasklet_t* tasklet_list[TASKLET_MAX];
+static uint32_t tasklet_num;
+
+/* void tasklet_init(tasklet_t* t, const int8_t* name, void (*func)(uint32_t data), uint32_t data)
+ * Input:  t -- tasklet to set up
+ *         name -- name shown in the softirqs file
+ *         func -- bottom half
+ *         data -- argument passed to func
+ * Return Value: none
+ * Function: Initialize a tasklet and add it to the statistics list */
+void tasklet_init(tasklet_t* t, const int8_t* name, void (*func)(uint32_t data), uint32_t data)
+{
+    memset(t, 0, sizeof(tasklet_t));
+    t->func = func;
+    t->data = data;
+    t->name = name;
+    if(tasklet_num < TASKLET_MAX) tasklet_list[tasklet_num++] = t;
+}
+
+/* void tasklet_schedule(tasklet_t* t)
+ * Input:  t -- tasklet to queue
+ * Return Value: none
+ * Function: Append the tasklet to the pending list unless it is already on it.
+ * A tasklet queued while it runs is run again afterwards */
+void tasklet_schedule(tasklet_t* t)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if(!(t->state & TASKLET_SCHED))
+    {
+        t->state |= TASKLET_SCHED;
+        t->sched_tsc = rdtsc();
+        t->scheduled++;
+        t->next = NULL;
+        *tasklet_tail = t;
+        tasklet_tail = &t->next;
+    }
+    restore_flags(flags);
+}
+
+/* void softirq_run(void)
+ * Input:  none
+ * Return Value: none
+ * Function: Called from do_irq with interrupts disabled. Takes the pending
+ * list, enables interrupts and runs each tasklet, and repeats until nothing
+ * is pending. An interrupt that arrives meanwhile only queues more work,
+ * since bottom halves never nest. Returns with interrupts disabled */
+void softirq_run(void)
+{
+    tasklet_t* t;
+    uint64_t start;
+    uint32_t delay, cycles;
+
+    if(softirq_active) return;
+    softirq_active = 1;
+
+    while(tasklet_head != NULL)
+    {
+        tasklet_run = tasklet_head;
+        tasklet_head = NULL;
+        tasklet_tail = &tasklet_head;
+        sti();
+
+        while(tasklet_run != NULL)
+        {
+            t = tasklet_run;
+            tasklet_run = t->next;
+            t->state &= ~TASKLET_SCHED;
+
+            start = rdtsc();
+            delay = (uint32_t)(start - t->sched_tsc);
+            t->func(t->data);
+            cycles = (uint32_t)(rdtsc() - start);
+
+            t->runs++;
+            if(delay > t->max_delay) t->max_delay = delay;
+            if(cycles > t->max_cycles) t->max_cycles = cycles;
+        }
+
+        cli();
+    }
+
+    softirq_active = 0;
+}
+
+/* void softirq_abort(void)
+ * Input:  none
+ * Return Value: none
+ * Function: For a bottom half that leaves through halt() and never returns to
+ * softirq_run. Tasklets it did not get to are queued again for the next IRQ
+ * exit. Returns with interrupts disabled */
+void softirq_abort(void)
+{
+    tasklet_t** tail;
+
+    cli();
+    if(tasklet_run != NULL)
+    {
+        /* Put the tasklets not yet run back in front of the pending list */
+        for(tail = &tasklet_run; *tail != NULL; tail = &(*tail)->next);
+        *tail = tasklet_head;
+        if(tasklet_head == NULL) tasklet_tail = tail;
+        tasklet_head = tasklet_run;
+        tasklet_run = NULL;
+    }
+    softirq_active = 0;
+}
+
+/* void softirqs_show(special_buf_t* b)
+ * Input:  b -- buffer to fill
+ * Return Value: none
+ * Function: Print how often each tasklet was queued and run, the longest wait
+ * between being queued and running, and its longest run, both in cycles */
+void softirqs_show(special_buf_t* b)
+{
+    uint32_t i;
+
+    special_puts(b, "tasklet     scheduled       runs  max delay max cycles\n");
+    for(i = 0; i < tasklet_num; i++)
+    {
+        special_puts(b, tasklet_list[i]->name);
+        special_putu(b, tasklet_list[i]->scheduled, 20 - (int32_t)strlen(tasklet_list[i]->name));
+        special_putu(b, tasklet_list[i]->runs, 11);
+        special_putu(b, tasklet_list[i]->max_delay, 11);
+        special_putu(b, tasklet_list[i]->max_cycles, 11);
+        special_puts(b, "\n");
+    }
+}
@@ -0,0 +1,57 @@
+/* softirq.h - Defines for deferred interrupt work (tasklets)
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SOFTIRQ_H
+#define _SOFTIRQ_H
+
+#include "types.h"
+#include "special_file.h"
+
+/* Most tasklets that can be listed in the softirqs file */
+#define TASKLET_MAX         8
+
+/* Tasklet state bits */
+#define TASKLET_SCHED       0x1     /* queued, will run at the next IRQ exit */
+
+/* Struct tasklet_t
+ * next : next tasklet in the pending list
+ * state : TASKLET_* bits
+ * func : bottom half to run with interrupts enabled
+ * data : argument passed to func
+ * name : name shown in the softirqs file
+ * sched_tsc : time stamp of the last tasklet_schedule that queued it
+ * scheduled : number of times it was queued
+ * runs : number of times func was called
+ * max_delay : most cycles between being queued and running
+ * max_cycles : most cycles spent in one call of func */
+typedef struct tasklet {
+    struct tasklet* next;
+    volatile uint32_t state;
+    void (*func)(uint32_t data);
+    uint32_t data;
+    const int8_t* name;
+    uint64_t sched_tsc;
+    uint32_t scheduled;
+    uint32_t runs;
+    uint32_t max_delay;
+    uint32_t max_cycles;
+} tasklet_t;
+
+/* Set while bottom halves are running. The scheduler does not switch
+ * processes in this window, so a bottom half always finishes on the kernel
+ * stack it started on */
+volatile uint8_t softirq_active;
+
+/* Set up a tasklet and list it in the softirqs file */
+void tasklet_init(tasklet_t* t, const int8_t* name, void (*func)(uint32_t data), uint32_t data);
+/* Queue a tasklet to run at the next IRQ exit. Safe from top halves */
+void tasklet_schedule(tasklet_t* t);
+/* Run every pending tasklet with interrupts enabled, called at IRQ exit */
+void softirq_run(void);
+/* Leave softirq context from a bottom half that is not going to return */
+void softirq_abort(void);
+/* Contents of the softirqs special file */
+void softirqs_show(special_buf_t* b);
+
+#endif /* _SOFTIRQ_H */
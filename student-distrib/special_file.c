@@ -0,0 +1,152 @@
+/* special_file.c - Kernel statistics files generated on read
+ * vim:ts=4 noexpandtab
+ */
+
+#include "special_file.h"
+#include "system_call.h"
+#include "irq.h"
+#include "softirq.h"
+#include "irqsoff.h"
+#include "buddy.h"
+#include "slab.h"
+
+/* Every special file, looked up by name in open() before the file system */
+static special_file_t special_files[] = {
+    {"irqstat", irqstat_show},
+    {"softirqs", softirqs_show},
+    {"irqsoff", irqsoff_show},
+    {"buddyinfo", buddyinfo_show},
+    {"slabinfo", slabinfo_show},
+};
+
+#define SPECIAL_FILE_NUM (sizeof(special_files) / sizeof(special_files[0]))
+
+/* Text of the file being read. Regenerated on every read */
+static int8_t special_text[SPECIAL_BUF_SIZE];
+
+/* int32_t special_lookup(const uint8_t* filename)
+ * Input:  filename -- name passed to open
+ * Return Value: index into the special file table, -1 if not a special file
+ * Function: Match a file name against the special files */
+int32_t special_lookup(const uint8_t* filename)
+{
+    uint32_t i;
+
+    if(filename == NULL) return -1;
+    for(i = 0; i < SPECIAL_FILE_NUM; i++)
+    {
+        if(strncmp(special_files[i].name, (const int8_t*)filename, FILE_NAME_SIZE) == 0) return i;
+    }
+    return -1;
+}
+
+/* int32_t special_read(int32_t fd, void* buf, int32_t nbytes)
+ * Input:  fd -- file descriptor, its inode holds the table index
+ *         buf -- buffer to copy into
+ *         nbytes -- size of buf
+ * Return Value: bytes copied, 0 at the end of the file
+ * Function: Generate the file and copy it from the current position. The
+ * whole text is built with interrupts off so a read sees one snapshot */
+int32_t special_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    pcb_t* cur_pcb = get_cur_pcb();
+    special_buf_t b;
+    uint32_t flags;
+    int32_t pos, count;
+
+    if(buf == NULL || nbytes < 0) return -1;
+
+    cli_and_save(flags);
+    b.buf = special_text;
+    b.len = 0;
+    b.size = SPECIAL_BUF_SIZE;
+    special_files[cur_pcb->fds[fd].inode].show(&b);
+
+    pos = cur_pcb->fds[fd].file_position;
+    count = (int32_t)b.len - pos;
+    if(count < 0) count = 0;
+    if(count > nbytes) count = nbytes;
+    memcpy(buf, special_text + pos, count);
+    cur_pcb->fds[fd].file_position += count;
+    restore_flags(flags);
+
+    return count;
+}
+
+/* int32_t special_write(int32_t fd, const void* buf, int32_t nbytes)
+ * Input:  fd, buf, nbytes -- ignored
+ * Return Value: -1, special files are read only
+ * Function: none */
+int32_t special_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+    return -1;
+}
+
+/* int32_t special_open(const uint8_t* filename)
+ * Input:  filename -- name of the special file
+ * Return Value: 0
+ * Function: none, the text is built on each read */
+int32_t special_open(const uint8_t* filename)
+{
+    return 0;
+}
+
+/* int32_t special_close(int32_t fd)
+ * Input:  fd -- file descriptor
+ * Return Value: 0
+ * Function: none */
+int32_t special_close(int32_t fd)
+{
+    return 0;
+}
+
+/* void special_puts(special_buf_t* b, const int8_t* s)
+ * Input:  b -- buffer being generated
+ *         s -- string to append
+ * Return Value: none
+ * Function: Append a string, dropping whatever does not fit */
+void special_puts(special_buf_t* b, const int8_t* s)
+{
+    while(*s != '\0' && b->len < b->size)
+    {
+        b->buf[b->len++] = *s++;
+    }
+}
+
+/* void special_printf(special_buf_t* b, const int8_t* format, ...)
+ * Input:  b -- buffer being generated
+ *         format, ... -- as for snprintf
+ * Return Value: none
+ * Function: Append formatted text. It is formatted on the stack first, so
+ * one call gives at most SPECIAL_LINE_MAX - 1 bytes */
+void special_printf(special_buf_t* b, const int8_t* format, ...)
+{
+    int8_t line[SPECIAL_LINE_MAX];
+    va_list ap;
+
+    va_start(ap, format);
+    vsnprintf(line, SPECIAL_LINE_MAX, format, ap);
+    va_end(ap);
+    special_puts(b, line);
+}
+
+/* void special_putu(special_buf_t* b, uint32_t value, int32_t width)
+ * Input:  b -- buffer being generated
+ *         value -- number to print in decimal
+ *         width -- minimum number of columns, padded with spaces on the left
+ * Return Value: none
+ * Function: Append a right aligned decimal number */
+void special_putu(special_buf_t* b, uint32_t value, int32_t width)
+{
+    special_printf(b, "%*u", width, value);
+}
+
+/* void special_putx(special_buf_t* b, uint32_t value)
+ * Input:  b -- buffer being generated
+ *         value -- number to print in hex, usually an address
+ * Return Value: none
+ * Function: Append a zero padded hexadecimal number */
+void special_putx(special_buf_t* b, uint32_t value)
+{
+    special_printf(b, "0x%#x", value);
+}
@@ -0,0 +1,52 @@
+/* special_file.h - Defines for the kernel statistics files that are
+ * generated on read instead of coming from the file system image
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SPECIAL_FILE_H
+#define _SPECIAL_FILE_H
+
+#include "types.h"
+
+/* Largest text a special file can produce */
+#define SPECIAL_BUF_SIZE    4096
+
+/* Longest text one special_printf call can append */
+#define SPECIAL_LINE_MAX    128
+
+/* Struct special_buf_t
+ * buf : text being generated
+ * len : number of bytes written so far
+ * size : capacity of buf */
+typedef struct {
+    int8_t* buf;
+    uint32_t len;
+    uint32_t size;
+} special_buf_t;
+
+/* Struct special_file_t
+ * name : name passed to open
+ * show : fills the buffer with the current contents */
+typedef struct {
+    const int8_t* name;
+    void (*show)(special_buf_t* b);
+} special_file_t;
+
+/* Index of the special file with this name, or -1 */
+int32_t special_lookup(const uint8_t* filename);
+/* File operations for special files */
+int32_t special_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t special_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t special_open(const uint8_t* filename);
+int32_t special_close(int32_t fd);
+
+/* Append a string to the buffer, truncating at its end */
+void special_puts(special_buf_t* b, const int8_t* s);
+/* Append text formatted as by snprintf, truncating at the buffer's end */
+void special_printf(special_buf_t* b, const int8_t* format, ...);
+/* Append an unsigned number right aligned in width columns */
+void special_putu(special_buf_t* b, uint32_t value, int32_t width);
+/* Append a number as 0x followed by eight hex digits */
+void special_putx(special_buf_t* b, uint32_t value);
+
+#endif /* _SPECIAL_FILE_H */
@@ -0,0 +1,41 @@
+/* switch.h - Defines for switching kernel stacks between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SWITCH_H
+#define _SWITCH_H
+
+/* Offsets of the task_ctx_t fields, for switch.S */
+#define TASK_KSP            0
+#define TASK_ESP0           4
+#define TASK_CR3            8
+
+/* EFLAGS a process starts with: interrupts on, and bit 1 which is always set */
+#define TASK_EFLAGS         0x202
+
+#ifndef ASM
+
+#include "types.h"
+
+/* Struct task_ctx_t, what switch_to needs to run a process, first in its PCB
+ * ksp : kernel stack pointer saved by switch_to while the process is not running
+ * esp0 : top of its kernel stack, loaded into the TSS
+ * cr3 : physical address of its page directory */
+typedef struct {
+    uint32_t ksp;
+    uint32_t esp0;
+    uint32_t cr3;
+} task_ctx_t;
+
+/* Save the callee-saved registers and stack of prev and resume next */
+extern void switch_to(task_ctx_t* prev, task_ctx_t* next);
+/* Resume next, the running stack is abandoned */
+extern void task_enter(task_ctx_t* next) __attribute__((noreturn));
+/* Enter user mode at entry from the top of ctx's kernel stack, which the caller may be running on */
+extern void task_enter_user(task_ctx_t* ctx, uint32_t entry, uint32_t user_esp) __attribute__((noreturn));
+/* First return of switch_to in a process that has not run yet */
+extern void task_start(void);
+
+#endif /* ASM */
+
+#endif /* _SWITCH_H */
@@ -3,6 +3,8 @@
  */
 
 #include "system_call.h"
+#include "special_file.h"
+#include "pipe.h"
 
 /* Process ID array */
 int32_t PCB_mask[TERM_MAX][MAX_PCB_MASK_LEN] = {
@@ -12,64 +14,60 @@ int32_t PCB_mask[TERM_MAX][MAX_PCB_MASK_LEN] = {
                                                };
 
 /* Static fop for specific files */
-file_optable_t stdin_fop = {term_read,operation_error,term_open,term_close};
-file_optable_t stdout_fop = {operation_error,term_write,term_open,term_close};
-file_optable_t rtc_fop = {rtc_read,rtc_write,rtc_open,rtc_close};
-file_optable_t dir_fop = {dir_read,dir_write,dir_open,dir_close};
-file_optable_t file_fop = {file_read,file_write,file_open,file_close};
-file_optable_t error_fop = {operation_error,operation_error,operation_error,operation_error};
+file_optable_t stdin_fop = {term_read,operation_error,term_open,term_close,term_readv,operation_error};
+file_optable_t stdout_fop = {operation_error,term_write,term_open,term_close,operation_error,term_writev};
+file_optable_t rtc_fop = {rtc_read,rtc_write,rtc_open,rtc_close,generic_readv,generic_writev};
+file_optable_t dir_fop = {dir_read,dir_write,dir_open,dir_close,generic_readv,generic_writev};
+file_optable_t file_fop = {file_read,file_write,file_open,file_close,file_readv,file_writev};
+file_optable_t special_fop = {special_read,special_write,special_open,special_close,generic_readv,generic_writev};
+file_optable_t pipe_read_fop = {pipe_read,operation_error,operation_error,pipe_read_close,generic_readv,operation_error};
+file_optable_t pipe_write_fop = {operation_error,pipe_write,operation_error,pipe_write_close,operation_error,generic_writev};
+file_optable_t error_fop = {operation_error,operation_error,operation_error,operation_error,operation_error,operation_error};
+
+/* proc_load's return value when the terminal has no free PCB */
+#define PCB_FULL (-2)
+
+static int32_t proc_load(const uint8_t* command, uint8_t spawned, uint32_t* entry, uint32_t* esp);
+static void proc_orphan(int32_t pcb_number);
+static void proc_exit(pcb_t* pcb, int32_t status);
 
 /* int32_t halt (uint8_t status)
- * Input: 
- * Return Value: 
- * Function: halt the most recent process of currently running terminal */
+ * Input: status for the parent
+ * Return Value: does not return
+ * Function: halt the running process. A child of execute resumes its parent
+ * inside execute. A spawned child stays as a zombie until its parent reaps
+ * it with waitpid, and the scheduler runs something else */
 int32_t halt (uint8_t status){   
     
     uint32_t i;
     int32_t cur_status;
-    pcb_t* old_pcb;
+    uint8_t foreground;
 
-    /* Clear miscellaneous keyboard input during execution of program */
-    buf_clear();
+    /* Obtain current PCB, and whether it is the one its terminal's keyboard goes to */
+    pcb_t* cur_pcb = get_cur_pcb();
+    foreground = (term[cur_pcb->term_id].cur_pcb_id == cur_pcb->process_number % MAX_PCB_MASK_LEN);
 
-    /* Obtain current PCB and update cur_pcb_id of that terminal */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id+now_term_id*MAX_PCB_MASK_LEN);
-    term[now_term_id].cur_pcb_id = cur_pcb->parent_process_number % MAX_PCB_MASK_LEN;
+    /* Clear miscellaneous keyboard input during execution of program */
+    if(foreground) buf_clear();
 
-    /* Unmask the bit in the PCB_mask */
-    PCB_mask[(uint8_t)cur_pcb->process_number / MAX_PCB_MASK_LEN][(uint8_t)cur_pcb->process_number % MAX_PCB_MASK_LEN] = 0;
+    /* Its FPU registers are not worth saving any more */
+    fpu_release(cur_pcb->process_number);
 
     /* Disable the flags of the fds */
     for(i=0; i<MAX_FILE_NUM; i++)
     {   
-        /* If the flag is 1, then we need to set it to 0 and then close it */
+        /* If the flag is 1, then we need to set it to 0 and then close it.
+         * stdin and stdout too, which may be pipe ends from dup2 */
         if(cur_pcb->fds[i].flags == 1)
         {   
             cur_pcb->fds[i].flags = 0;
-            close(i);
+            cur_pcb->fds[i].optable.close(i);
         }
         cur_pcb->fds[i].optable = error_fop;
     }
 
-    /* If user attemp to close the last shell, restart it */
-    if(cur_pcb->parent_process_number == -1){
-        printf("Halting the last shell is not allowed!\n");
-        execute((uint8_t*)"shell");
-    }
-
-    /* Get the parent pcb: 0x8000000 (128MB) - (process number + 1) * 0x2000 (8KB) */
-    pcb_t * parent_pcb = (pcb_t*) (0x800000 - (cur_pcb->parent_process_number + 1) * 0x2000);
-
-    /* Map parent's virtual address 0x8000000 (128MB) to physical address 0x800000 (8MB),
-     * plus process_number number times 0x400000 (4MB) */
-    pcb_mapping(0x8000000, 0x800000 + parent_pcb->process_number * 0x400000);
-
-    /* record the cur_pcb to old_pcb for later use and update cur_pcb */
-    old_pcb = cur_pcb;
-    cur_pcb = parent_pcb;
-
-    /* update tss information */
-    tss.esp0 = 0x800000 - parent_pcb->process_number * 0x2000 - 0x4; /* 8MB - process number * 8KB - 4 */
+    /* Free all user memory of the halting process, page tables included */
+    user_dir_release(cur_pcb->process_number);
 
     cur_status = status;
 
@@ -77,17 +75,38 @@ int32_t halt (uint8_t status){
     if(interrupt_halt_flag) cur_status |= 0x100;
     interrupt_halt_flag = 0;
 
-    asm volatile(
-        "movl %0, %%eax;" /* Get status for return */
-        "movl %1, %%ebp;" /* restore parent kbp */
-        "movl %2, %%esp;" /* restore parent ksp */
-        "leave;"
-        "ret;"
-        /* there is no output here */
-        :   
-        :"r"(cur_status), "r"(old_pcb->parent_kbp), "r"(old_pcb->parent_ksp)
-        :"eax" /* clobber EAX */
-    );
+    /* Nothing may run between here and the switch away */
+    cli();
+
+    /* Spawned children it leaves behind have nobody to wait for them */
+    proc_orphan(cur_pcb->process_number);
+
+    /* A spawned child never comes back from here */
+    if(cur_pcb->spawned) proc_exit(cur_pcb, cur_status);
+
+    /* Unmask the bit in the PCB_mask */
+    PCB_mask[(uint8_t)cur_pcb->process_number / MAX_PCB_MASK_LEN][(uint8_t)cur_pcb->process_number % MAX_PCB_MASK_LEN] = 0;
+
+    /* If user attemp to close the last shell, restart it in the same PCB */
+    if(cur_pcb->parent_process_number == -1){
+        printf("Halting the last shell is not allowed!\n");
+        execute((uint8_t*)"shell");
+    }
+
+    /* The keyboard goes back to the parent if it was this process's */
+    if(foreground) term[cur_pcb->term_id].cur_pcb_id = cur_pcb->parent_process_number % MAX_PCB_MASK_LEN;
+
+    /* Get the parent pcb: KERNEL_STACK_TOP (8MB physical) - (process number + 1) * 0x2000 (8KB) */
+    pcb_t * parent_pcb = (pcb_t*) (KERNEL_STACK_TOP - (cur_pcb->parent_process_number + 1) * 0x2000);
+    fpu_switch(parent_pcb->process_number);
+
+    /* Resume the parent inside its execute, which returns the status. That
+     * loads the parent's page directory, which maps its program region at
+     * virtual address 0x8000000 (128MB), and its kernel stack into the TSS.
+     * Nothing is saved, this stack is not used again */
+    parent_pcb->child_status = cur_status;
+    parent_pcb->state = PROC_RUNNING;
+    task_enter(&parent_pcb->ctx);
     return 0;
 }
 
@@ -96,184 +115,196 @@ int32_t halt (uint8_t status){
  * Return Value: -1 -- Fail to execute
  *              256 -- Program squashed due to exception
  *            0-255 -- Program successfully executed
- * Function: execute a file given pointer to its location */
+ * Function: execute a file given pointer to its location, and sleep until
+ * it halts. Other processes keep running meanwhile, the caller's spawned
+ * children included. The child starts with the caller's stdin and stdout */
 int32_t execute (const uint8_t* command){
 
-    uint32_t i, offset;
-    int32_t filename_flag;
     int32_t PCB_number;
-    uint32_t entrypoint;
-    uint8_t filename[MAX_FILENAME_LENGTH]; /* File name to be executed */
-    uint8_t fileargs[MAX_ARG_LENGTH]; /* the file arguments after parsing */
-    uint8_t headerbuf[HEADER_NUM]; /* Buffer for checking for magic number */
-    uint8_t magicnumber[MAGIC_NUM] = {0x7f, 0x45, 0x4c, 0x46}; /* Expected magic number string */
-    dentry_t loader; /* dentry for loading the program into VM */
-    dentry_t magic_dentry;
-
-    /* Check for invalid input */
-    if(command == NULL) return -1;
-
-    /* Initialize the filename and fileargs */
-    /* May due to the reason we did not implement halt while test exectute program,
-     * the first time we type in is exactly what we want,
-     * the second time will cause filebuf full of trash. */
-    for(i = 0; i < MAX_FILENAME_LENGTH; i++){
-        filename[i] = '\0';
-    }
-    for(i = 0; i < MAX_ARG_LENGTH; i++){
-        fileargs[i] = '\0';
-    }
+    uint32_t entry, esp; /* Entry point, and user stack pointer to start with at argc */
 
-    /* Filename flag is -1 until we start recording filename */
-    filename_flag = -1;
-    /* Offset is 0 initially */
-    offset = 0;
+    PCB_number = proc_load(command, 0, &entry, &esp);
 
-    /* Get filename and args */
-    for(i = 0; command[i] != '\0'; i++){
+    /* If there are none free spaces, then return 0 */
+    if(PCB_number == PCB_FULL) return 0;
+    if(PCB_number == -1) return -1;
 
-        /* Check for long executable name */
-        if(i > MAX_FILENAME_LENGTH && filename_flag == 0) return -1;
+    pcb_t* pcb = get_pcb_from_id(PCB_number);
+    fpu_switch(PCB_number);
 
-        /* Case we are getting leading spaces */
-        if(command[i] == ' ' && filename_flag == -1){
-            /* Skipping the spaces */
-            continue;
-        }
-        /* Case we are recording the file name */
-        else if(command[i] != ' ' && (filename_flag == -1 || filename_flag == 0)){
-            /* Flag is set to 0 because we are currently recording filename */
-            filename_flag = 0;
-            filename[offset] = command[i];
-            offset++;
-        }
-        /* Case we are getting the middle extra spaces */
-        else if(command[i] == ' ' && (filename_flag == 0 || filename_flag == 1)){
-            /* Mark end of recording filename */
-            filename_flag = 1;
-            offset = 0;
-            continue;
-        }
-        /* Case we are starting to record the arguments */
-        else if(filename_flag == 1 || filename_flag == 2){
-            filename_flag = 2;
-            fileargs[offset] = command[i];
-            offset++;
-        }
-    }
+    /*------------------------------------------- Context Switch -------------------------------------------*/
 
-    /* Check valid name */
-    if(read_dentry_by_name((int8_t*)filename, &magic_dentry) == -1) return -1;
+    /* Let parent shell know that current program is operating normally */
+    interrupt_halt_flag = 0;
+    
+    /* The process running this call: the parent, or the process of another
+     * terminal when the scheduler boots a shell */
+    pcb_t* cur_pcb = get_cur_pcb();
 
-    /* Check valid magic number for indicating it is an executable */
-    read_data(magic_dentry.inode,0,headerbuf,HEADER_NUM);
-    if(strncmp((const int8_t*)headerbuf, (const int8_t*)magicnumber, MAGIC_NUM) != 0) return -1;
+    /* No interrupt may land between the stack and TSS updates below */
+    cli();
 
-    /*----------------------------------------------- Paging -----------------------------------------------*/
+    /* The keyboard goes to the child if it went to the parent. A shell the
+     * scheduler boots gets it too */
+    if(pcb->parent_process_number == -1 || term[pcb->term_id].cur_pcb_id == cur_pcb->process_number % MAX_PCB_MASK_LEN)
+        term[pcb->term_id].cur_pcb_id = PCB_number % MAX_PCB_MASK_LEN;
 
-    /* Get the process free number and total task number in the PCB */
-    PCB_number = PCB_process_number();
+    /* halt restarting the last shell of a terminal reuses its PCB, so this is
+     * the child's own stack: nothing to come back to, start it from here */
+    if(cur_pcb == pcb) task_enter_user(&pcb->ctx, entry, esp);
 
-    /* If there are none free spaces, then return 0 */
-    if(PCB_number == -1)
+    /* The parent sleeps until the child halts. The process a booted shell
+     * interrupted is not its parent and goes on running */
+    if(pcb->parent_process_number != -1)
     {
-        printf("There are no available space in the PCB\n");
-        return 0;
+        cur_pcb->wait_pid = PCB_number;
+        cur_pcb->state = PROC_WAIT_CHILD;
     }
 
-    /* Map the virtual address 0x8000000 (128MB) to physical address 0x800000 (8MB)
-     * with some offsets depending on the pcb number we have */
-    pcb_mapping(0x8000000, 0x800000 + PCB_number * 0x400000);
+    /* Start the child from the top of its own kernel stack, and its user
+     * ESP at argc */
+    task_prepare(&pcb->ctx, entry, esp);
+    switch_to(&cur_pcb->ctx, &pcb->ctx);
 
-    /*----------------------------------------------- Loader -----------------------------------------------*/
+    /* Back here once the child halts, or the scheduler picks this process again */
+    return cur_pcb->child_status;
+}
 
-    /* Load file to be executed into VM
-     * First get file information into the loader
-     * Then read file information into starting address of VM */
-    if(read_dentry_by_name((int8_t*)filename, &loader) == -1) return -1;
-    if(read_data(loader.inode, 0, (uint8_t*)START_VITURAL_ADDR, inodeblk[loader.inode].size) == -1) return -1;
+/* int32_t spawn (const uint8_t* command)
+ * Input: pointer to command being issued by user
+ * Return Value: PID of the child, -1 if it could not be started
+ * Function: start a program like execute, but return at once. The child
+ * runs in the caller's terminal alongside it, without the keyboard: its
+ * reads of stdin see end of file unless stdin is a pipe. The caller learns
+ * how it ended with waitpid */
+int32_t spawn (const uint8_t* command){
 
-    /*--------------------------------------------- Create PCB ---------------------------------------------*/
-    
-    /* Initialize the pointer to the memory of the PCB stack, 0x800000 for 8MB and 0x2000 for 8KB */
-    pcb_t* pcb = (pcb_t*) (0x800000 - (PCB_number + 1) * 0x2000);
+    int32_t PCB_number;
+    uint32_t entry, esp;
+    pcb_t* pcb;
+
+    PCB_number = proc_load(command, 1, &entry, &esp);
+    if(PCB_number < 0) return -1;
+
+    /* The scheduler starts it from the top of its kernel stack when it
+     * first picks it */
+    pcb = get_pcb_from_id(PCB_number);
+    cli();
+    task_prepare(&pcb->ctx, entry, esp);
+    pcb->state = PROC_RUNNING;
+    tick_restart();
+    return PCB_number;
+}
 
-    /* Save current ESP and EBP into the struct as previous KSP/KBP */
-    asm volatile(
-        "movl %%ebp, %%eax;"
-        "movl %%esp, %%ebx;"
-        /* there is no input here */
-        :"=a"(pcb->parent_kbp), "=b"(pcb->parent_ksp)
-    );
+/* int32_t waitpid (int32_t pid, int32_t* status, int32_t options)
+ * Input: pid -- spawned child to wait for, -1 for any of them
+ *        status -- where to store how it ended, as execute would return it,
+ *                  may be NULL
+ *        options -- WNOHANG to return at once if it is still running
+ * Return Value: PID of the child reaped, 0 with WNOHANG if none has halted
+ *               yet, -1 if there is no such child
+ * Function: reap a spawned child that halted, freeing its PCB, sleeping
+ * until one does unless WNOHANG is given */
+int32_t waitpid (int32_t pid, int32_t* status, int32_t options){
 
-    /* assign process number and cur_term_id to pcb, and also assign pcb id to terminal */
-    pcb->process_number = PCB_number;
-    pcb->term_id = cur_term_id;
-    term[cur_term_id].cur_pcb_id = PCB_number % 4;
+    int32_t i, found;
+    pcb_t* child;
 
-    /* Set parent process number to -1 if it is the first process in a terminal */
-    if(PCB_number % 4 == 0) pcb->parent_process_number = -1;
-    /* Otherwise parent is the previous process in the terminal */
-    else pcb->parent_process_number = pcb->process_number - 1;
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
 
+    if(status != NULL && !user_range_writable(status, sizeof(int32_t))) return -1;
 
-    /* initialize file descriptor for each file */
-    for(i = 0;i < MAX_FILE_NUM; i++){ //i is used here, check if i need to be reserved from the above content
-        pcb->fds[i].optable = error_fop;
-        pcb->fds[i].inode = NULL;
-        pcb->fds[i].file_position = 0;
-        pcb->fds[i].flags = 0;
-    }
-    /* initialize file descriptor for stdin and stdout */
-    pcb->fds[0].optable = stdin_fop;
-    pcb->fds[0].flags = 1;  
-    pcb->fds[1].optable = stdout_fop;
-    pcb->fds[1].flags = 1;
-
-    /* Initialize argument buffer to empty string */
-    for(i = 0; i < MAX_ARG_LENGTH; i++){
-        pcb->argbuf[i] = '\0';
-    }
+    cli();
+    for(;;)
+    {
+        found = 0;
+        for(i = 0; i < PCB_MAX; i++)
+        {
+            if(!PCB_in_use(i) || (pid != -1 && i != pid)) continue;
+            child = get_pcb_from_id(i);
+            if(!child->spawned || child->parent_process_number != cur_pcb->process_number) continue;
+
+            if(child->state == PROC_ZOMBIE)
+            {
+                if(status != NULL) *status = child->exit_status;
+                PCB_mask[i / MAX_PCB_MASK_LEN][i % MAX_PCB_MASK_LEN] = 0;
+                return i;
+            }
+            found = 1;
+        }
+
+        if(!found) return -1;
+        if(options & WNOHANG) return 0;
 
-    /* Store user arguments into user_buf, ending with null */
-    for(i = 0; i < MAX_ARG_LENGTH; i++){
-        pcb->argbuf[i] = fileargs[i];
+        /* The child's halt wakes this process up */
+        cur_pcb->wait_pid = pid;
+        cur_pcb->state = PROC_WAIT_CHILD;
+        sched_sleep();
     }
-    pcb->argbuf[i] = '\0';
+}
 
-    /*------------------------------------------- Context Switch -------------------------------------------*/
+/* int32_t pipe (int32_t* fds)
+ * Input: array of two fds to fill in
+ * Return Value: 0 if success, -1 if fail
+ * Function: make a pipe and open its read end in fds[0] and its write end
+ * in fds[1], the two lowest free fds */
+int32_t pipe (int32_t* fds){
 
-    /* Modify TSS */
-    tss.esp0 = 0x800000 - PCB_number * 0x2000 - 0x4; /* 8MB - process number * 8KB - 4 */
-    tss.ss0 = KERNEL_DS;
+    int32_t fd, ends[2], n = 0;
+    pipe_t* p;
 
-    /* Flush the TLB */
-    flush();
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
 
-    /* Let parent shell know that current program is operating normally */
-    interrupt_halt_flag = 0;
-    
-    /* Shift bytes and cast into 4-byte unsigned int */
-    entrypoint = (headerbuf[27] << 24) | (headerbuf[26] << 16) | (headerbuf[25] << 8) | headerbuf[24];
+    if(!user_range_writable(fds, 2 * sizeof(int32_t))) return -1;
 
-    asm volatile(
-        "pushl $0x002B;" /* Push USER_DS */
-        "pushl $0x83FFFFC;" /* Push ESP, 132MB - 4B */
-        "pushfl;" /* Push EFLAGS */
-        "popl %%eax;" /* Get EFLAGS to change bit */
-        "orl $0x200, %%eax;" /* Alter interrupt bit */
-        "pushl %%eax;" /* Push EFLAGS again */
-        "pushl $0x0023;" /* Push USER_CS */
-        "pushl %0;"  /* Push entrypoint(EIP) */
-        "iret;" /* Use IRET to fake the jump to next program */
-        :       /* there is no output here */
-        :"r"(entrypoint)
-        :"eax" /* clobber EAX */
-    );
+    for(fd = 0; fd < MAX_FILE_NUM && n < 2; fd++)
+        if(cur_pcb->fds[fd].flags == 0) ends[n++] = fd;
+    if(n < 2) return -1;
 
+    p = pipe_alloc();
+    if(p == NULL) return -1;
+
+    cur_pcb->fds[ends[0]].optable = pipe_read_fop;
+    cur_pcb->fds[ends[1]].optable = pipe_write_fop;
+    for(n = 0; n < 2; n++){
+        cur_pcb->fds[ends[n]].inode = (int32_t)p;
+        cur_pcb->fds[ends[n]].file_position = 0;
+        cur_pcb->fds[ends[n]].flags = 1;
+    }
+
+    fds[0] = ends[0];
+    fds[1] = ends[1];
     return 0;
 }
 
+/* int32_t dup2 (int32_t oldfd, int32_t newfd)
+ * Input: open fd, and the fd to make a copy of it
+ * Return Value: newfd if success, -1 if fail
+ * Function: close newfd if it is open, stdin and stdout included, and make
+ * it refer to what oldfd does. A file gets its own position */
+int32_t dup2 (int32_t oldfd, int32_t newfd){
+
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
+
+    /* Check for invalid fds */
+    if(oldfd >= MAX_FILE_NUM || oldfd < 0 || newfd >= MAX_FILE_NUM || newfd < 0) return -1;
+    if(cur_pcb->fds[oldfd].flags == 0) return -1;
+    if(oldfd == newfd) return newfd;
+
+    /* Count the copy before newfd lets go, which may be of the same pipe */
+    pipe_dup(oldfd);
+    if(cur_pcb->fds[newfd].flags == 1){
+        cur_pcb->fds[newfd].flags = 0;
+        cur_pcb->fds[newfd].optable.close(newfd);
+    }
+
+    cur_pcb->fds[newfd] = cur_pcb->fds[oldfd];
+    return newfd;
+}
+
 /* int32_t read (int32_t fd, void* buf, int32_t  nbytes)
  * Input: file descriptor, buffer, number of bytes that will be operated
  * Return Value: number of bytes read if success, -1 if fail
@@ -281,13 +312,14 @@ int32_t execute (const uint8_t* command){
 int32_t read (int32_t fd, void* buf, int32_t  nbytes){
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
     /* Check for invalid fd */
     if(fd >= MAX_FILE_NUM || fd < 0) return -1;
 
-    /* Check for invalid buf input */
+    /* Check for invalid buf input, the driver fills it */
     if(buf == NULL) return -1;
+    if(nbytes < 0 || !user_range_writable(buf, nbytes)) return -1;
 
     /* Check for whether file is currently open */
     if(cur_pcb->fds[fd].flags == 0) return -1;
@@ -303,7 +335,7 @@ int32_t read (int32_t fd, void* buf, int32_t  nbytes){
 int32_t write (int32_t fd, const void* buf, int32_t nbytes){
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
     /* Check for invalid fd */
     if(fd >= MAX_FILE_NUM || fd < 0) return -1;
@@ -318,6 +350,156 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes){
     return cur_pcb->fds[fd].optable.write(fd,buf,nbytes);
 }
 
+/* int32_t iov_copy_in (const iovec_t* iov, int32_t iovcnt, iovec_t* kiov, int32_t fill)
+ * Input: user iovec array, its length, and a kernel array of IOV_MAX entries
+ *        fill -- nonzero for readv, where the kernel writes the buffers
+ * Return Value: 0 if the array and every buffer lie in user memory, -1 otherwise
+ * Function: copy the iovec array into the kernel so the drivers see buffers
+ * that were checked and cannot change under them */
+static int32_t iov_copy_in (const iovec_t* iov, int32_t iovcnt, iovec_t* kiov, int32_t fill){
+    int32_t i;
+
+    if(iovcnt < 0 || iovcnt > IOV_MAX) return -1;
+    if(!user_range_ok(iov, iovcnt * sizeof(iovec_t))) return -1;
+    memcpy(kiov, iov, iovcnt * sizeof(iovec_t));
+    for(i = 0; i < iovcnt; i++){
+        if(fill ? !user_range_writable(kiov[i].base, kiov[i].len) : !user_range_ok(kiov[i].base, kiov[i].len)) return -1;
+    }
+    return 0;
+}
+
+/* int32_t readv (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Input: file descriptor, array of buffers, number of buffers
+ * Return Value: total bytes read if success, -1 if fail
+ * Function: fill several buffers with one system call */
+int32_t readv (int32_t fd, const iovec_t* iov, int32_t iovcnt){
+
+    iovec_t kiov[IOV_MAX];
+
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
+
+    /* Check for invalid fd and closed file */
+    if(fd >= MAX_FILE_NUM || fd < 0) return -1;
+    if(cur_pcb->fds[fd].flags == 0) return -1;
+
+    if(iov_copy_in(iov, iovcnt, kiov, 1) == -1) return -1;
+
+    /* Call corresponding readv function using optable */
+    return cur_pcb->fds[fd].optable.readv(fd,kiov,iovcnt);
+}
+
+/* int32_t writev (int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Input: file descriptor, array of buffers, number of buffers
+ * Return Value: total bytes written if success, -1 if fail
+ * Function: write several buffers, in order, with one system call */
+int32_t writev (int32_t fd, const iovec_t* iov, int32_t iovcnt){
+
+    iovec_t kiov[IOV_MAX];
+
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
+
+    /* Check for invalid fd and closed file */
+    if(fd >= MAX_FILE_NUM || fd < 0) return -1;
+    if(cur_pcb->fds[fd].flags == 0) return -1;
+
+    if(iov_copy_in(iov, iovcnt, kiov, 0) == -1) return -1;
+
+    /* Call corresponding writev function using optable */
+    return cur_pcb->fds[fd].optable.writev(fd,kiov,iovcnt);
+}
+
+/* int32_t mmap (int32_t fd, uint32_t* length)
+ * Input: file descriptor of an open regular file, where to store its size;
+ *        or fd -1 and the number of bytes of anonymous memory wanted
+ * Return Value: address of the mapping if success, -1 if fail
+ * Function: map the whole file read-only into the mmap window without
+ * copying, one page per filesystem block. The bytes past the end of the file
+ * in the last page belong to the filesystem image and are not zeroed.
+ * Anonymous memory is zeroed, read/write, and uses 4MB pages from 4MB up */
+int32_t mmap (int32_t fd, uint32_t* length){
+
+    uint32_t inode, size, npages, addr, i;
+
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
+
+    /* fd -1 asks for zeroed anonymous memory of *length bytes */
+    if(fd == -1){
+        if(!user_range_ok(length, sizeof(uint32_t)) || *length == 0) return -1;
+        addr = anon_mmap(cur_pcb->process_number, *length);
+        return (addr == 0) ? -1 : (int32_t)addr;
+    }
+
+    /* Check for invalid fd, closed file, and files that are not in the filesystem image */
+    if(fd >= MAX_FILE_NUM || fd < 0) return -1;
+    if(cur_pcb->fds[fd].flags == 0 || cur_pcb->fds[fd].optable.read != file_read) return -1;
+    if(!user_range_writable(length, sizeof(uint32_t))) return -1;
+
+    inode = cur_pcb->fds[fd].inode;
+    size = inodeblk[inode].size;
+    if(size == 0) return -1;
+    npages = (size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+
+    /* Check every block before mapping any */
+    for(i = 0; i < npages; i++){
+        if(file_block_addr(inode, i) == 0) return -1;
+    }
+
+    addr = mmap_reserve(cur_pcb->process_number, npages);
+    if(addr == 0) return -1;
+    for(i = 0; i < npages; i++){
+        mmap_page(cur_pcb->process_number, addr + i * FS_BLOCK_SIZE, file_block_addr(inode, i));
+    }
+    flush();
+
+    *length = size;
+    return (int32_t)addr;
+}
+
+/* int32_t munmap (void* addr, uint32_t length)
+ * Input: address returned by mmap, length of the mapping
+ * Return Value: 0 if success, -1 if fail
+ * Function: remove pages from the mmap window, every page in the range must be mapped */
+int32_t munmap (void* addr, uint32_t length){
+
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
+
+    if((uint32_t)addr >= ANON_LARGE_START && (uint32_t)addr < ANON_LARGE_END)
+        return anon_munmap_large(cur_pcb->process_number, (uint32_t)addr, length);
+    return munmap_pages(cur_pcb->process_number, (uint32_t)addr, (length + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE);
+}
+
+/* int32_t sbrk (int32_t increment)
+ * Input: number of bytes to grow the heap by, negative to shrink it
+ * Return Value: the old end of the heap if success, -1 if fail
+ * Function: move the end of the heap. New memory is zeroed, pages entirely
+ * past a lower end are freed */
+int32_t sbrk (int32_t increment){
+
+    uint32_t old_brk, new_brk;
+
+    /* Obtain the current PCB */
+    pcb_t* cur_pcb = get_cur_pcb();
+
+    old_brk = cur_pcb->brk;
+    new_brk = old_brk + increment;
+
+    if(increment > 0){
+        if(new_brk < old_brk || new_brk > HEAP_END) return -1;
+        if(heap_grow(cur_pcb->process_number, old_brk, new_brk) == -1) return -1;
+    }
+    else if(increment < 0){
+        if(new_brk > old_brk || new_brk < cur_pcb->heap_start) return -1;
+        heap_shrink(cur_pcb->process_number, old_brk, new_brk);
+    }
+
+    cur_pcb->brk = new_brk;
+    return (int32_t)old_brk;
+}
+
 /* int32_t open (const uint8_t* filename)
  * Input: file name
  * Return Value: file descriptor if success, -1 if fail
@@ -325,13 +507,15 @@ int32_t write (int32_t fd, const void* buf, int32_t nbytes){
 int32_t open (const uint8_t* filename){
 
     int32_t fd;
+    int32_t special;
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
-    /* get current file's dentry information */
+    /* get current file's dentry information, special files are not in the image */
     dentry_t local_dentry;
-    if (read_dentry_by_name((int8_t*)filename, &local_dentry) == -1) return -1;
+    special = special_lookup(filename);
+    if (special == -1 && read_dentry_by_name((int8_t*)filename, &local_dentry) == -1) return -1;
 
     /* get next available fd and change the flag to 1 */
     for (fd = 0; fd < MAX_FILE_NUM; fd++) {
@@ -345,6 +529,13 @@ int32_t open (const uint8_t* filename){
     /* no available spot in file descriptor array, return -1 */
     if (fd >= MAX_FILE_NUM) return -1;
 
+    /* special files keep their table index in the inode field */
+    if (special != -1) {
+        cur_pcb->fds[fd].inode = special;
+        cur_pcb->fds[fd].optable = special_fop;
+        return fd;
+    }
+
     /* assign function pointer and inode value based on file type */
     switch(local_dentry.filetype){
         case RTC_TYPE:
@@ -376,7 +567,7 @@ int32_t open (const uint8_t* filename){
 int32_t close (int32_t fd){
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
     /* Check for invalid fd, note that stdin and stdout cannot be closed */
     if(fd >= MAX_FILE_NUM || fd < 2) return -1;
@@ -392,26 +583,43 @@ int32_t close (int32_t fd){
 /* int32_t getargs (uint8_t* buf, int32_t nbytes)
  * Input: address of user space buffer and size of buffer
  * Return Value: 0 if success, -1 if fail
- * Function: Return the user typed arguments to buf */
+ * Function: Return the user typed arguments to buf, kept for programs that
+ * do not take them from main. They are read back from argv on the user
+ * stack, argv[1] on, joined by single spaces */
 int32_t getargs (uint8_t* buf, int32_t nbytes){
 
-    int32_t i, arg_length;  
+    uint32_t i;
+    int32_t len = 0;
+    uint32_t* argv;
+    int8_t* arg;
 
     /* Obtain the current PCB */
-    pcb_t* cur_pcb = get_pcb_from_id(term[now_term_id].cur_pcb_id + now_term_id*MAX_PCB_MASK_LEN);
+    pcb_t* cur_pcb = get_cur_pcb();
 
-    /* Get current argument length from PCB */
-    arg_length = strlen((int8_t*)cur_pcb->argbuf);
+    /* The whole buffer has to be user memory the kernel may write */
+    if(nbytes <= 0 || !user_range_writable(buf, nbytes)) return -1;
 
-    /* Return -1 if no argument or not enough space */
-    if(arg_length <= 0 || arg_length >= nbytes) return -1;
+    /* Return -1 if no argument, the program may have changed argv itself */
+    argv = (uint32_t*)cur_pcb->argv;
+    if(cur_pcb->argc < 2 || !user_range_ok(argv, cur_pcb->argc * sizeof(uint32_t))) return -1;
 
-    for(i = 0; i < arg_length; i++){
-        buf[i] = cur_pcb->argbuf[i];
+    for(i = 1; i < cur_pcb->argc; i++){
+        if(i > 1){
+            if(len >= nbytes) return -1;
+            buf[len++] = ' ';
+        }
+        for(arg = (int8_t*)argv[i]; ; arg++){
+            if(!user_range_ok(arg, 1)) return -1;
+            if(*arg == '\0') break;
+            /* Return -1 if not enough space */
+            if(len >= nbytes) return -1;
+            buf[len++] = *arg;
+        }
     }
 
     /* Add null ending for the arg */
-    buf[i] = '\0';
+    if(len >= nbytes) return -1;
+    buf[len] = '\0';
 
     return 0;
 }
@@ -425,16 +633,16 @@ int32_t vidmap (uint8_t** screen_start){
     /* Check whether the pointer passed in is a NULL pointer or not */
     if(screen_start == NULL) {return -1;}
 
-    /* Make sure the pointer falls in user-level range 0x8000000(128MB) to 0x8400000(132MB) */
-    if((uint32_t)screen_start < 0x8000000 || (uint32_t)screen_start>=0x8400000) {return -1;}
+    /* Make sure the pointer falls in user memory */
+    if(!user_range_writable(screen_start, sizeof(uint8_t*))) {return -1;}
 
     /* Call the syscall_video_mapping function to map from physical address for video memory to virtual address */
-    /* 0xB8000 is the physical address we want to map to the video memory */
-    syscall_video_mapping(0xB8000);
+    /* VIDEO_PHYS is the physical address we want to map to the video memory */
+    syscall_video_mapping(VIDEO_PHYS);
 
     /* Map the screen_start to the virtual address */
-    /* 0x8400000 is the address 132MB, which we used to map to our video memory */
-    *screen_start = (uint8_t*)0x8400000;
+    /* VIDMAP_START is the address 124MB, which we used to map to our video memory */
+    *screen_start = (uint8_t*)VIDMAP_START;
 
     return 0;
 }
@@ -457,31 +665,220 @@ int32_t sigreturn (void){
 
 /************** Helper Functions Are In This Section **************/
 
-/* int32_t PCB_process_number()
- * Input: None
+/* int32_t proc_load(const uint8_t* command, uint8_t spawned, uint32_t* entry, uint32_t* esp)
+ * Input: command -- program name and arguments
+ *        spawned -- 1 for spawn, 0 for execute
+ *        entry, esp -- set to where the program starts in user mode
+ * Return Value: PCB number of the new process, PCB_FULL if its terminal has
+ *               no free PCB, -1 if the program cannot be loaded
+ * Function: Build a process in the running terminal with the running
+ * process as its parent, or none for the first process of the terminal.
+ * Its address space, stack and PCB are ready, the caller decides when it
+ * runs */
+static int32_t proc_load(const uint8_t* command, uint8_t spawned, uint32_t* entry, uint32_t* esp)
+{
+    uint32_t i;
+    int32_t PCB_number;
+    elf_image_t image; /* Segments and entry point of the executable */
+    const int8_t* name;
+    const int8_t* name_end;
+    uint32_t argc, argv;
+    uint8_t filename[MAX_FILENAME_LENGTH + 1]; /* File name to be executed, with its NULL */
+    dentry_t exe_dentry;
+
+    /* Check for invalid input */
+    if(command == NULL) return -1;
+
+    /* Get filename: skip the leading spaces, the name runs to the next
+     * space. The whole command goes on the new stack as argv later */
+    name = (const int8_t*)command;
+    while(*name == ' ') name++;
+    name_end = strchrnul(name, ' ');
+
+    /* Check for long executable name */
+    if(name_end - name > MAX_FILENAME_LENGTH) return -1;
+    strncpy((int8_t*)filename, name, name_end - name);
+    filename[name_end - name] = '\0';
+
+    /* Check valid name */
+    if(read_dentry_by_name((int8_t*)filename, &exe_dentry) == -1) return -1;
+
+    /* Check it is an ELF executable whose segments fit in the program
+     * region and the file. The heap starts at the page after its .bss */
+    if(elf_check(exe_dentry.inode, &image) == -1) return -1;
+
+    /*----------------------------------------------- Paging -----------------------------------------------*/
+
+    /* Get the process free number in the terminal of the running process */
+    PCB_number = PCB_process_number(now_term_id);
+
+    if(PCB_number == -1)
+    {
+        printf("There are no available space in the PCB\n");
+        return PCB_FULL;
+    }
+
+    /* Build the page directory. User space starts empty, its page tables and
+     * frames come from the buddy allocator as the program touches them */
+    user_dir_init(PCB_number);
+
+    /*----------------------------------------------- Loader -----------------------------------------------*/
+
+    /* Map the segments of the file into VM
+     * Whole pages of the file are shared with the filesystem image, nothing
+     * is copied until the program writes to a page. Pages holding the end of
+     * the file data and the start of .bss are read into private frames */
+    /* Then put argc, argv and envp at the top of the new stack, where
+     * _start finds them. The stack pointer starts at argc */
+    if(elf_map(PCB_number, &image) == -1 || (*esp = stack_args(PCB_number, name, &argc, &argv)) == 0){
+        user_dir_release(PCB_number);
+        PCB_mask[now_term_id][PCB_number % MAX_PCB_MASK_LEN] = 0;
+        return -1;
+    }
+    *entry = image.entry;
+
+    /*--------------------------------------------- Create PCB ---------------------------------------------*/
+    
+    /* Initialize the pointer to the memory of the PCB stack, KERNEL_STACK_TOP for 8MB and 0x2000 for 8KB */
+    pcb_t* pcb = (pcb_t*) (KERNEL_STACK_TOP - (PCB_number + 1) * 0x2000);
+
+    /* The child's kernel stack and page directory, loaded on the switch to it */
+    task_ctx_init(&pcb->ctx, PCB_number);
+
+    /* assign process number and terminal id to pcb */
+    pcb->process_number = PCB_number;
+    pcb->term_id = now_term_id;
+
+    /* Set parent process number to -1 if it is the first process in a terminal */
+    if(PCB_number % MAX_PCB_MASK_LEN == 0) pcb->parent_process_number = -1;
+    /* Otherwise parent is the process making this call */
+    else pcb->parent_process_number = get_cur_pcb()->process_number;
+
+    pcb->state = PROC_RUNNING;
+    pcb->spawned = spawned;
+    pcb->wait_pid = -1;
+
+    /* initialize file descriptor for each file */
+    for(i = 0;i < MAX_FILE_NUM; i++){
+        pcb->fds[i].optable = error_fop;
+        pcb->fds[i].inode = NULL;
+        pcb->fds[i].file_position = 0;
+        pcb->fds[i].flags = 0;
+    }
+    /* initialize file descriptor for stdin and stdout, the terminal for
+     * the first process, otherwise the parent's, so a shell can point them
+     * at pipes */
+    if(pcb->parent_process_number == -1){
+        pcb->fds[0].optable = stdin_fop;
+        pcb->fds[0].flags = 1;  
+        pcb->fds[1].optable = stdout_fop;
+        pcb->fds[1].flags = 1;
+    }
+    else{
+        for(i = 0; i < 2; i++){
+            pipe_dup(i);
+            pcb->fds[i] = get_cur_pcb()->fds[i];
+        }
+    }
+
+    /* No rings until the program registers some */
+    pcb->ring.ctl = NULL;
+
+    /* The heap starts out empty */
+    pcb->heap_start = image.heap_start;
+    pcb->brk = image.heap_start;
+
+    /* No FPU state until the program's first FPU instruction */
+    pcb->fpu_state = NULL;
+
+    /* Where getargs finds the arguments */
+    pcb->argc = argc;
+    pcb->argv = argv;
+
+    return PCB_number;
+}
+
+/* void proc_orphan(int32_t pcb_number)
+ * Input: process that is halting
+ * Return Value: none
+ * Function: Free its zombie children, and leave the running ones without a
+ * parent so they free their own PCB when they halt. Interrupts are off */
+static void proc_orphan(int32_t pcb_number)
+{
+    int32_t i;
+    pcb_t* child;
+
+    for(i = 0; i < PCB_MAX; i++)
+    {
+        if(!PCB_in_use(i)) continue;
+        child = get_pcb_from_id(i);
+        if(!child->spawned || child->parent_process_number != pcb_number) continue;
+
+        if(child->state == PROC_ZOMBIE) PCB_mask[i / MAX_PCB_MASK_LEN][i % MAX_PCB_MASK_LEN] = 0;
+        else child->parent_process_number = -1;
+    }
+}
+
+/* void proc_exit(pcb_t* pcb, int32_t status)
+ * Input: pcb -- spawned process halting, with its resources released
+ *        status -- what waitpid reports
+ * Return Value: does not return
+ * Function: Become a zombie and wake the parent if it waits for this
+ * child, or free the PCB if there is no parent. Then leave this stack for
+ * good. Interrupts are off */
+static void proc_exit(pcb_t* pcb, int32_t status)
+{
+    pcb_t* parent;
+
+    if(pcb->parent_process_number == -1)
+    {
+        PCB_mask[pcb->process_number / MAX_PCB_MASK_LEN][pcb->process_number % MAX_PCB_MASK_LEN] = 0;
+    }
+    else
+    {
+        pcb->exit_status = status;
+        pcb->state = PROC_ZOMBIE;
+
+        parent = get_pcb_from_id(pcb->parent_process_number);
+        if(parent->state == PROC_WAIT_CHILD && (parent->wait_pid == -1 || parent->wait_pid == pcb->process_number))
+        {
+            parent->state = PROC_RUNNING;
+            tick_restart();
+        }
+    }
+    sched_exit();
+}
+
+/* int32_t PCB_process_number(uint8_t term_id)
+ * Input: terminal the process will run in
  * Return Value: Return index in that PCB that is free. 
- * If there are no free spaces in current terminal, return -1
- * Function:  Find next available PCB in current terminal */
-int32_t PCB_process_number()
+ * If there are no free spaces in that terminal, return -1
+ * Function:  Find next available PCB in a terminal */
+int32_t PCB_process_number(uint8_t term_id)
 {
     int32_t i;
 
     for(i = 0; i < MAX_PCB_MASK_LEN; i++)
     {
-        if(PCB_mask[cur_term_id][i] == 0)
+        if(PCB_mask[term_id][i] == 0)
         {
-            PCB_mask[cur_term_id][i] = 1;
-            /* If more than 6 processes allocated, return -1 */
-            if(PCB_total_number() > 6){
-                PCB_mask[cur_term_id][i] = 0;
-                return -1;
-            }
-            return i + cur_term_id * MAX_PCB_MASK_LEN;
+            PCB_mask[term_id][i] = 1;
+            return i + term_id * MAX_PCB_MASK_LEN;
         }
     }
     return -1;
 }
 
+/* int32_t PCB_in_use(uint32_t id)
+ * Input: process number
+ * Return Value: 1 if a process holds that PCB, zombies included, 0 otherwise
+ * Function: Look the number up in PCB_mask */
+int32_t PCB_in_use(uint32_t id)
+{
+    if(id >= PCB_MAX) return 0;
+    return PCB_mask[id / MAX_PCB_MASK_LEN][id % MAX_PCB_MASK_LEN] != 0;
+}
+
 /* int32_t PCB_total_number()
  * Input: None
  * Return Value: Return total number of active tasks. 
@@ -505,14 +902,12 @@ int32_t PCB_total_number()
  * Function:  Find the current pcb pointer based on stack pointer */
 pcb_t* get_cur_pcb()
 {
-    pcb_t* curr;
+    uint32_t esp;
     asm volatile(
-        "andl %%esp, %%eax;"
-        :"=a"(curr)         /* get current pcb pointer based on esp */
-        :"a"(0xFFFFE000)    /* mask it with !8kb */
-        :"cc"
+        "movl %%esp, %0;"
+        :"=r"(esp)          /* get current stack pointer */
     );
-    return curr;
+    return (pcb_t*)(esp & 0xFFFFE000);  /* mask it with !8kb */
 }
 
 /* pcb_t* get_cur_pcb_from_id(uint8_t id)
@@ -522,7 +917,7 @@ pcb_t* get_cur_pcb()
 pcb_t* get_pcb_from_id(uint8_t id)
 {
     /* formula: 8MB-(id+1)*8KB */
-    return (pcb_t*)(0x800000-(id+1)*0x2000);
+    return (pcb_t*)(KERNEL_STACK_TOP-(id+1)*0x2000);
 }
 
 /* int32_t operation_error()
@@ -533,3 +928,67 @@ int32_t operation_error()
 {
     return -1;
 }
+
+/* int32_t generic_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Input: file descriptor, kernel copy of the buffer list, number of buffers
+ * Return Value: total bytes read, or -1 if the first read fails
+ * Function: readv for drivers without a native version. Stops after a short
+ * read, like a single read would */
+int32_t generic_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    pcb_t* cur_pcb = get_cur_pcb();
+    int32_t i, cnt, total = 0;
+
+    for(i = 0; i < iovcnt; i++)
+    {
+        cnt = cur_pcb->fds[fd].optable.read(fd, iov[i].base, iov[i].len);
+        if(cnt < 0) return (total == 0) ? -1 : total;
+        total += cnt;
+        if(cnt < (int32_t)iov[i].len) break;
+    }
+    return total;
+}
+
+/* int32_t generic_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Input: file descriptor, kernel copy of the buffer list, number of buffers
+ * Return Value: total bytes written, or -1 if the first write fails
+ * Function: writev for drivers without a native version */
+int32_t generic_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    pcb_t* cur_pcb = get_cur_pcb();
+    int32_t i, cnt, total = 0;
+
+    for(i = 0; i < iovcnt; i++)
+    {
+        cnt = cur_pcb->fds[fd].optable.write(fd, iov[i].base, iov[i].len);
+        if(cnt < 0) return (total == 0) ? -1 : total;
+        total += cnt;
+    }
+    return total;
+}
+
+/* int32_t user_range_ok(const void* addr, uint32_t len)
+ * Input: start of a buffer passed in by the user and its length in bytes
+ * Return Value: 1 if the whole buffer is inside the program region or the
+ *               stack, or mapped for the user elsewhere (vidmap, mmap,
+ *               heap), 0 otherwise
+ * Function: Validate user pointers before the kernel touches them */
+int32_t user_range_ok(const void* addr, uint32_t len)
+{
+    uint32_t start = (uint32_t)addr;
+
+    /* Pages of the program region and the stack are filled when touched,
+     * anything else has to be mapped already */
+    if(vmem_demand(get_cur_pcb()->heap_start, start, len)) return 1;
+    return user_mapped(start, len, 0);
+}
+
+/* int32_t user_range_writable(void* addr, uint32_t len)
+ * Input: start of a buffer passed in by the user and its length in bytes
+ * Return Value: 1 if the kernel may write the whole buffer, 0 otherwise
+ * Function: user_range_ok for buffers the kernel fills. Read-only pages,
+ * such as the text of the program, are refused instead of faulting */
+int32_t user_range_writable(void* addr, uint32_t len)
+{
+    return vmem_writable(get_cur_pcb()->heap_start, (uint32_t)addr, len);
+}
@@ -14,21 +14,35 @@
 #include "keyboard.h"
 #include "rtc.h"
 #include "idt.h"
+#include "ring.h"
+#include "iovec.h"
+#include "vmem.h"
+#include "fpu.h"
+#include "switch.h"
+#include "elf.h"
 
 /* Macro definition section */
 #define MAX_ARG_NUM 10
-#define MAGIC_NUM 4
-#define HEADER_NUM 40
 #define MAX_FILE_NUM 8
 #define FILE_NAME_SIZE 32
 #define MAX_ARG_LENGTH 100
-#define START_VITURAL_ADDR 0x08048000
+#define USER_START 0x8000000    /* 128MB, start of the program region */
 
 #define RTC_TYPE 0
 #define DIR_TYPE 1
 #define FILE_TYPE 2
 
 #define MAX_PCB_MASK_LEN 4
+#define PCB_MAX (TERM_MAX * MAX_PCB_MASK_LEN)
+
+/* pcb_t state */
+#define PROC_RUNNING    0   /* runnable, or waiting for keyboard input */
+#define PROC_WAIT_CHILD 1   /* asleep in execute or waitpid until a child halts */
+#define PROC_ZOMBIE     2   /* halted spawned child, kept for waitpid */
+#define PROC_WAIT_QUEUE 3   /* asleep on a wait queue, see wait.h */
+
+/* waitpid options */
+#define WNOHANG 1
 
 /* Struct definition section */
 
@@ -36,12 +50,16 @@
  * read: function pointer for read
  * write: function pointer for write
  * open: function pointer for open
- * close: function pointer for close */
+ * close: function pointer for close
+ * readv: function pointer for readv, iov already checked and copied in
+ * writev: function pointer for writev, iov already checked and copied in */
 typedef struct{
    int32_t (*read)(int32_t fd, void* buf, int32_t  nbytes);
    int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
    int32_t (*open)(const uint8_t* filename);
    int32_t (*close)(int32_t fd);
+   int32_t (*readv)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+   int32_t (*writev)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
 } file_optable_t;
 
 /* Struct: file_desc_t
@@ -59,29 +77,47 @@ typedef struct {
 } file_desc_t;
 
 /* Struct: pcb_t
+ * ctx : saved kernel stack, TSS stack top and page directory, used by switch_to.
+ *       Must stay first, switch.S finds its fields from the PCB address
  * fds[MAX_FILE_NUM] : array of file descriptor 
  * filenames[MAX_FILE_NUM][FILE_NAME_SIZE] : an array which contains the name of open files
- * parent_ksp : the kernel stack ptr of the parent process
- * parent_kbp : the kernel base ptr of the parent process
- * ksp_before : the kernel stack ptr of the previous process in round robin
- * kbp_before : the kernel base ptr of the previous process in round robin
- * process_number : process number from 0 to 7
- * parent_process_number : parent process number from 0 to 7
- * argbuf[MAX_ARG_SIZE] : argument buffer in this process
+ * child_status : status of the last child that halted, returned by execute
+ * process_number : process number from 0 to PCB_MAX - 1, also its PID
+ * parent_process_number : process number of the process that started it,
+ *                         -1 for the first shell of a terminal and for
+ *                         spawned children whose parent has halted
+ * state : PROC_RUNNING, PROC_WAIT_CHILD, PROC_ZOMBIE or PROC_WAIT_QUEUE
+ * spawned : 1 if started by spawn, which makes it wait in PROC_ZOMBIE for
+ *           waitpid once it halts instead of resuming its parent
+ * wait_pid : child a PROC_WAIT_CHILD process waits for, -1 for any
+ * exit_status : status of a zombie, for waitpid
+ * argc, argv : number of words on the command line and the user address of
+ *              the argv array on the stack, read by getargs
+ * ring : submission/completion rings registered with ring_setup
+ * heap_start : end of the program region and start of the heap
+ * brk : end of the heap, moved by sbrk
+ * fpu_state : saved FPU and SSE registers, NULL until the first FPU instruction
  */ 
 typedef struct {
+	task_ctx_t ctx;
 	file_desc_t fds[MAX_FILE_NUM]; 
-	uint32_t parent_ksp;
-	uint32_t parent_kbp;
-	uint32_t ksp;
-	uint32_t kbp;
+	int32_t child_status;
 	int8_t process_number;
 	int8_t parent_process_number;
-	uint8_t argbuf[MAX_ARG_LENGTH];
+	uint8_t state;
+	uint8_t spawned;
+	int32_t wait_pid;
+	int32_t exit_status;
+	uint32_t argc;
+	uint32_t argv;
 	tss_t cur_tss;
 	uint8_t term_id;
-	uint32_t rtc_counter;
+	volatile uint32_t rtc_counter;
 	uint32_t rtc_freq;
+	ring_ctx_t ring;
+	uint32_t heap_start;
+	uint32_t brk;
+	uint8_t* fpu_state;
 } pcb_t;
 
 /* System Calls section */
@@ -106,12 +142,32 @@ int32_t vidmap (uint8_t** screen_start);
 int32_t set_handler (int32_t signum, void* handler_address);
 /* system call: sigreturn */
 int32_t sigreturn (void);
+/* system call: readv */
+int32_t readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+/* system call: writev */
+int32_t writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+/* system call: mmap */
+int32_t mmap (int32_t fd, uint32_t* length);
+/* system call: munmap */
+int32_t munmap (void* addr, uint32_t length);
+/* system call: sbrk */
+int32_t sbrk (int32_t increment);
+/* system call: spawn */
+int32_t spawn (const uint8_t* command);
+/* system call: waitpid */
+int32_t waitpid (int32_t pid, int32_t* status, int32_t options);
+/* system call: pipe */
+int32_t pipe (int32_t* fds);
+/* system call: dup2 */
+int32_t dup2 (int32_t oldfd, int32_t newfd);
 
 
 /************** Helper Functions Are In This Section **************/
 
-/* Get the process Number that is free in PCB_mask */
-int32_t PCB_process_number();
+/* Get the process Number that is free in PCB_mask for a terminal */
+int32_t PCB_process_number(uint8_t term_id);
+/* Check whether a process number is allocated */
+int32_t PCB_in_use(uint32_t id);
 /* Get the total number of active tasks in PCB */
 int32_t PCB_total_number();
 /* Get current pcb pointer */
@@ -120,5 +176,12 @@ pcb_t* get_cur_pcb();
 pcb_t* get_pcb_from_id(uint8_t id);
 /* error operation to map into file operation table */
 int32_t operation_error();
+/* readv/writev for files without a native version, one read/write per buffer */
+int32_t generic_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t generic_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+/* Check that a buffer lies inside the process's user memory */
+int32_t user_range_ok(const void* addr, uint32_t len);
+/* Same, for a buffer the kernel is going to write */
+int32_t user_range_writable(void* addr, uint32_t len);
 
 #endif
@@ -3,13 +3,17 @@
  */
 
 #include "terminal.h"
+#include "memops.h"
 
 /* static var */
 term_t term[TERM_MAX];
 volatile uint8_t cur_term_id;
-file_optable_t stdin_fop_ = {term_read,operation_error,term_open,term_close};
-file_optable_t stdout_fop_ = {operation_error,term_write,term_open,term_close};
-file_optable_t error_fop_ = {operation_error,operation_error,operation_error,operation_error};
+file_optable_t stdin_fop_ = {term_read,operation_error,term_open,term_close,term_readv,operation_error};
+file_optable_t stdout_fop_ = {operation_error,term_write,term_open,term_close,operation_error,term_writev};
+file_optable_t error_fop_ = {operation_error,operation_error,operation_error,operation_error,operation_error,operation_error};
+
+static int32_t term_wait_enter(void);
+static void term_out(const int8_t* s, uint32_t n);
 
 /* void term_init(void)
  * Input:  none
@@ -35,14 +39,15 @@ void term_init()
 
         term[i].key_buf_idx=0;
         term[i].enter_state=0;
+        term[i].waiting=0;
         term[i].running=0;
         term[i].rtc_virtual_freq = 2;
         term[i].rtc_virtual_counter = 0;
         term[i].rtc_interrupt_received = 0;
 
-        /* allocate space in physical memory starting at 0xB9000 for each terminal's video memory and put them in video page table at virtual address 0xB9000 */
-        terminal_video_mapping(0xb9000+0x1000*i,i);
-        term[i].video_mem=(uint8_t*)(0xb9000+0x1000*i);
+        /* take a frame from the buddy allocator for each terminal's video memory, the kernel reaches it through the direct map */
+        term[i].video_phys=buddy_alloc(0);
+        term[i].video_mem=(uint8_t*)phys_to_virt(term[i].video_phys);
 
         for(j=0;j<NUM_ROWS*NUM_COLS;j++){
             *(uint8_t *)(term[i].video_mem + (j << 1)) = ' ';
@@ -103,8 +108,9 @@ int32_t term_save(uint8_t id)
     term[id].cursor_x = get_cursor_x();
     term[id].cursor_y = get_cursor_y();
 
-    /* copy screen video memory to terminal video memory */
-    memcpy(term[id].video_mem, (uint8_t*)VIDEO, 2*NUM_COLS*NUM_ROWS);
+    /* copy screen video memory to terminal video memory, around the cache
+     * since nothing reads the backup until the terminal comes back */
+    memcpy_nt(term[id].video_mem, (uint8_t*)VIDEO, 2*NUM_COLS*NUM_ROWS);
     return 0;
 }
 
@@ -122,8 +128,8 @@ int32_t term_restore(uint8_t id)
     key_buf_idx=term[id].key_buf_idx;
     set_screen_cursor(term[id].cursor_x,term[id].cursor_y);
 
-    /* copy terminal video memory to screen video memory */
-    memcpy((uint8_t*)VIDEO, term[id].video_mem, 2*NUM_COLS*NUM_ROWS);
+    /* copy terminal video memory to screen video memory, around the cache */
+    memcpy_nt((uint8_t*)VIDEO, term[id].video_mem, 2*NUM_COLS*NUM_ROWS);
 
     /* assign cur term id */
     cur_term_id = id;
@@ -157,12 +163,11 @@ int32_t term_open(const uint8_t* file_name)
  * Function: read key buffer into the read buffer */
 int32_t term_read(int32_t fd, void* buf, int32_t length)
 {
-    sti();
     int32_t i;
     int8_t* temp_buf;
     if(buf==NULL)   return -1;          //check for NULL pointer
-    while(term[now_term_id].enter_state==0);     //wait if enter is not pressed'
-    term[now_term_id].enter_state=0;             //reset enter state
+
+    if(term_wait_enter() == -1) return 0;
     temp_buf = (int8_t*)buf;
     for(i=0;(i<KEY_BUF_MAX)&&(i<length);i++){
         if(key_buf[i]=='\0') break;
@@ -175,23 +180,96 @@ int32_t term_read(int32_t fd, void* buf, int32_t length)
 /* int32_t term_write(int32_t fd, uint8_t* buf, uint32_t length)
  * Input:  file descriptor, buffer, and length
  * Return Value: number of bytes written
- * Function: print the write buffer to screen */
+ * Function: print the write buffer to screen, up to length bytes or the
+ * first NULL char. The bytes go out as they are, never as a format string */
 int32_t term_write(int32_t fd, const void* buf, int32_t length)
 {
-    int8_t temp_buf[length+1];          //additional slot for NULL char
     int32_t i;
     if(buf==NULL)   return -1;           //check NULL
     for(i=0;i<length;i++){
         if(((int8_t*)buf)[i]=='\0') break;
-        temp_buf[i]=((int8_t*)buf)[i];  //copy length specificed bytes from buf to temp buf
     }
-    temp_buf[i]='\0';                   //printf is '\0' terminated
+    term_out((int8_t*)buf, i);
+    return i;
+}
 
-    /* Two different types of output to the screen depending on 
-     * whether current terminal is terminal being executed */
-    if(now_term_id == cur_term_id) {printf(temp_buf);}
-    else {multi_printf(temp_buf);}
-    return (int32_t)i;
+/* int32_t term_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Input:  file descriptor, buffers, and number of buffers
+ * Return Value: number of bytes read
+ * Function: wait for one line like term_read and scatter it across the
+ * buffers in order */
+int32_t term_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    int32_t i, j, k = 0;
+    int8_t* temp_buf;
+
+    if(term_wait_enter() == -1) return 0;
+    for(i=0;i<iovcnt;i++){
+        temp_buf = (int8_t*)iov[i].base;
+        for(j=0;(j<(int32_t)iov[i].len)&&(k<KEY_BUF_MAX);j++,k++){
+            if(key_buf[k]=='\0') break;
+            temp_buf[j] = key_buf[k];   //move key buffer to read buffer
+        }
+        if(k>=KEY_BUF_MAX || key_buf[k]=='\0') break;
+    }
+    buf_clear();
+    return k;
+}
+
+/* int32_t term_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+ * Input:  file descriptor, buffers, and number of buffers
+ * Return Value: number of bytes written
+ * Function: print the buffers in order. Each buffer stops at a NUL like
+ * term_write and goes to the screen in one bulk write */
+int32_t term_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    int8_t* src;
+    int32_t i, j, total = 0;
+
+    for(i=0;i<iovcnt;i++){
+        src = (int8_t*)iov[i].base;
+        for(j=0;j<(int32_t)iov[i].len;j++){
+            if(src[j]=='\0') break;
+        }
+        term_out(src, j);
+        total += j;
+    }
+    return total;
+}
+
+/* int32_t term_wait_enter(void)
+ * Input:  none
+ * Return Value: 0 once enter is pressed, -1 at once for a process the
+ *               keyboard does not go to, which reads end of file
+ * Function: Mark the terminal as waiting so the scheduler skips it, then
+ * sleep in hlt until enter is pressed. Checking with interrupts off and using
+ * sti;hlt means the keyboard interrupt cannot slip in between the check and
+ * the hlt */
+static int32_t term_wait_enter(void)
+{
+    if(term[now_term_id].cur_pcb_id != get_cur_pcb()->process_number % MAX_PCB_MASK_LEN) return -1;
+
+    cli();
+    term[now_term_id].waiting=1;
+    while(term[now_term_id].enter_state==0){
+        sti_and_hlt();
+        cli();
+    }
+    term[now_term_id].waiting=0;
+    term[now_term_id].enter_state=0;             //reset enter state
+    sti();
+    return 0;
+}
+
+/* void term_out(const int8_t* s, uint32_t n)
+ * Input:  characters and their count
+ * Return Value: none
+ * Function: print to the screen if the running terminal is the one shown,
+ * otherwise to the running terminal's saved video page */
+static void term_out(const int8_t* s, uint32_t n)
+{
+    if(now_term_id == cur_term_id) {console_write(s, n);}
+    else {multi_console_write(s, n);}
 }
 
 /* int32_t term_close(int8_t* file_name)
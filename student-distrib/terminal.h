@@ -6,6 +6,7 @@
 #define _TERMINAL_H
 
 #include "types.h"
+#include "iovec.h"
 #include "lib.h"
 #include "keyboard.h"
 #include "file_system.h"
@@ -27,8 +28,10 @@ typedef struct{
     volatile uint8_t key_buf[KEY_BUF_MAX];
     volatile uint8_t key_buf_idx;
     volatile uint8_t enter_state;
+    volatile uint8_t waiting;
     uint8_t running;
     uint8_t* video_mem;
+    uint32_t video_phys;
 }term_t;
 
 /* global variable */
@@ -47,6 +50,8 @@ int32_t term_open(const uint8_t* file_name);
 int32_t term_read(int32_t fd, void* buf, int32_t length);
 int32_t term_write(int32_t fd, const void* buf, int32_t length);
 int32_t term_close(int32_t fd);
+int32_t term_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t term_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
 
 
 #endif
@@ -4,10 +4,22 @@
 #include "rtc.h"
 #include "terminal.h"
 #include "keyboard.h"
+#include "scheduling.h"
+#include "irq.h"
+#include "softirq.h"
+#include "irqsoff.h"
+#include "file_system.h"
+#include "vmem.h"
+#include "slab.h"
+#include "fpu.h"
+#include "memops.h"
+#include "elf.h"
+#include "pipe.h"
 
 #define PASS 1
 #define FAIL 0
 #define MAX_SIZE 10000
+#define IRQSOFF_TEST_CYCLES 1000000
 
 /* format these macros as you see fit */
 #define TEST_HEADER 	\
@@ -179,7 +191,7 @@ int paging_test2()
 	TEST_HEADER;
 
 	int result = PASS;
-	char val = *((char *) 0xB8000);
+	char val = *((char *) VIDEO);
 	val = val;
 	//assertion_failure();
 	//result = FAIL;
@@ -221,14 +233,15 @@ int paging_test4()
 	TEST_HEADER;
 
 	int result = PASS;
-	char val = *((char *) 0xB8000 + 0x1000 -1);
+	char val = *((char *) VIDEO + 0x1000 -1);
 	val = val;
 	return result;
 }
 
 /* paging_test5
  * 
- * Attempt to dereference at next byte of the very last byte of video memory
+ * Attempt to dereference video memory at its physical address, which the
+ * kernel no longer reaches once paging_init drops the boot identity map
  * Inputs: None
  * Outputs: PASS/FAIL
  * Side Effects: should raise a page fault
@@ -240,7 +253,7 @@ int paging_test5()
 	TEST_HEADER;
 
 	int result = PASS;
-	char val = *((char *) 0xB8000 + 0x1000);
+	char val = *((char *) VIDEO_PHYS);
 	val = val;
 	return result;
 }
@@ -259,7 +272,7 @@ int paging_test6()
 	TEST_HEADER;
 
 	int result = PASS;
-	char val = *((char *) 0x400000);
+	char val = *((char *) KERNEL_VIRTUAL_BASE + 0x400000);
 	val = val;
 	return result;
 }
@@ -278,7 +291,7 @@ int paging_test7()
 	TEST_HEADER;
 
 	int result = PASS;
-	char val = *((char *) 0x400000 + 0x400);
+	char val = *((char *) KERNEL_VIRTUAL_BASE + 0x400000 + 0x400);
 	val = val;
 	return result;
 }
@@ -560,6 +573,1085 @@ int rtc_sweep_test(){
 	return PASS;
 }
 
+/* tickless_idle_test
+ * 
+ * Sample the PIT and RTC interrupt rates over one second, timed with the
+ * TSC after calibrating it against the RTC
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: print PIT and RTC interrupts per second and how many PIT ones were idle
+ * Coverage: tickless idle, one-shot PIT programming, RTC periodic interrupt off when unused
+ * Files: scheduling.h/c, rtc.h/c
+ */
+int tickless_idle_test(){
+	TEST_HEADER;
+
+	uint32_t start, ticks, idle, rtcs;
+	uint64_t t0, second;
+
+	/* TSC cycles in an eighth of a second, the RTC is only held for this */
+	rtc_hold();
+	start = rtc_tick_count;
+	while(rtc_tick_count == start) sti_and_hlt();
+	start = rtc_tick_count;
+	t0 = rdtsc();
+	while(rtc_tick_count - start < RTC_BASE_FREQ / 8) sti_and_hlt();
+	second = (rdtsc() - t0) * 8;
+	rtc_release();
+
+	/* Let the terminals settle at their prompts and the RTC stop */
+	t0 = rdtsc();
+	while(rdtsc() - t0 < second) sti_and_hlt();
+
+	ticks = pit_tick_count;
+	idle = pit_idle_count;
+	rtcs = rtc_tick_count;
+	t0 = rdtsc();
+	while(rdtsc() - t0 < second) sti_and_hlt();
+	ticks = pit_tick_count - ticks;
+	idle = pit_idle_count - idle;
+	rtcs = rtc_tick_count - rtcs;
+
+	printf("PIT interrupts/s: %u, idle: %u, tick stopped: %u\n", ticks, idle, (uint32_t)tick_stopped);
+	printf("RTC interrupts/s: %u\n", rtcs);
+
+	/* With every terminal at its prompt the periodic 100HZ tick must be
+	 * gone, and with nobody reading the RTC so must its 1024HZ one */
+	if(tick_stopped && ticks < 100 && rtcs == 0) return PASS;
+	return FAIL;
+}
+
+/* Number of times shared_irq_probe ran */
+static volatile uint32_t shared_irq_calls;
+
+/* int32_t shared_irq_probe(uint32_t irq, void* dev)
+ * Second handler on the RTC line that only counts, and never claims, interrupts */
+static int32_t shared_irq_probe(uint32_t irq, void* dev){
+	shared_irq_calls++;
+	return IRQ_NONE;
+}
+
+/* shared_irq_test
+ * 
+ * Share the RTC line with a probe handler, then print irqstat
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: briefly adds a handler to IRQ8, prints the irqstat file
+ * Coverage: request_irq/free_irq, shared lines, per-IRQ statistics
+ * Files: irq.h/c, special_file.h/c
+ */
+int shared_irq_test(){
+	TEST_HEADER;
+
+	static int8_t text[SPECIAL_BUF_SIZE + 1];
+	special_buf_t b;
+	uint32_t start, calls;
+
+	shared_irq_calls = 0;
+	if(request_irq(RTC_IRQ, shared_irq_probe, "probe", (void*)&shared_irq_calls) != 0) return FAIL;
+
+	/* Both handlers must run for a tenth of a second of RTC interrupts */
+	rtc_hold();
+	start = rtc_tick_count;
+	while(rtc_tick_count - start < RTC_BASE_FREQ / 10) sti_and_hlt();
+	free_irq(RTC_IRQ, (void*)&shared_irq_calls);
+	calls = shared_irq_calls;
+
+	/* The probe is gone, the RTC handler is not */
+	start = rtc_tick_count;
+	while(rtc_tick_count - start < RTC_BASE_FREQ / 10) sti_and_hlt();
+	rtc_release();
+
+	b.buf = text;
+	b.len = 0;
+	b.size = SPECIAL_BUF_SIZE;
+	irqstat_show(&b);
+	text[b.len] = '\0';
+	printf("%s", text);
+
+	if(calls >= RTC_BASE_FREQ / 10 && shared_irq_calls == calls) return PASS;
+	return FAIL;
+}
+
+/* void tasklet_probe(uint32_t data)
+ * Bottom half that records whether interrupts were enabled while it ran */
+static void tasklet_probe(uint32_t data){
+	uint32_t flags;
+	asm volatile("pushfl; popl %0" : "=r"(flags));
+	*(volatile uint32_t*)data = (flags & 0x200) ? 1 : 2;	/* IF is bit 9 */
+}
+
+/* tasklet_test
+ * 
+ * Queue a tasklet and wait for the next IRQ exit to run it
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the tasklet's queue-to-run delay and the softirqs table
+ * Coverage: tasklet_schedule, softirq_run, softirqs file
+ * Files: softirq.h/c, special_file.h/c
+ */
+int tasklet_test(){
+	TEST_HEADER;
+
+	static tasklet_t probe;
+	static int8_t text[SPECIAL_BUF_SIZE + 1];
+	volatile uint32_t result = 0;
+	special_buf_t b;
+	uint32_t start;
+
+	tasklet_init(&probe, "probe", tasklet_probe, (uint32_t)&result);
+	tasklet_schedule(&probe);
+
+	/* Any interrupt runs it, the held RTC fires every millisecond */
+	rtc_hold();
+	start = rtc_tick_count;
+	while(result == 0 && rtc_tick_count - start < RTC_BASE_FREQ) sti_and_hlt();
+	rtc_release();
+	printf("tasklet delay: %u cycles, runs: %u\n", probe.max_delay, probe.runs);
+
+	b.buf = text;
+	b.len = 0;
+	b.size = SPECIAL_BUF_SIZE;
+	softirqs_show(&b);
+	text[b.len] = '\0';
+	printf("%s", text);
+
+	if(result == 1 && probe.runs == 1) return PASS;
+	return FAIL;
+}
+
+/* irqsoff_test
+ * 
+ * Hold interrupts off for a known number of cycles and check the tracer saw it
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: resets the irqsoff statistics, prints the irqsoff file
+ * Coverage: traced cli/sti, irqsoff special file
+ * Files: irqsoff.h/c, lib.h
+ */
+int irqsoff_test(){
+	TEST_HEADER;
+
+	static int8_t text[SPECIAL_BUF_SIZE + 1];
+	special_buf_t b;
+	uint64_t start;
+
+	irqsoff_reset();
+	cli();
+	start = rdtsc();
+	while(rdtsc() - start < IRQSOFF_TEST_CYCLES);
+	sti();
+
+	b.buf = text;
+	b.len = 0;
+	b.size = SPECIAL_BUF_SIZE;
+	irqsoff_show(&b);
+	text[b.len] = '\0';
+	printf("%s", text);
+
+	/* The longest window is ours, opened and closed inside this function */
+	if(irqsoff_stat.max_cycles >= IRQSOFF_TEST_CYCLES &&
+	   irqsoff_stat.max_start_ip > (uint32_t)irqsoff_test &&
+	   irqsoff_stat.max_end_ip > irqsoff_stat.max_start_ip) return PASS;
+	return FAIL;
+}
+
+/* term_writev_test
+ * 
+ * Write several buffers to the screen with one term_writev call
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints two lines
+ * Coverage: term_writev gathering, chunk flushing, NUL inside a buffer
+ * Files: terminal.h/c, iovec.h
+ */
+int term_writev_test(){
+	TEST_HEADER;
+
+	static int8_t fill[300];
+	iovec_t iov[4];
+	int32_t i;
+
+	for(i = 0; i < 299; i++) fill[i] = 'a' + i % 26;
+	fill[299] = '\n';
+
+	iov[0].base = "writev: ";
+	iov[0].len = 8;
+	iov[1].base = "one line\0ignored";
+	iov[1].len = 17;
+	iov[2].base = "\n";
+	iov[2].len = 1;
+	iov[3].base = fill;
+	iov[3].len = 300;
+
+	/* 8 + 8 (stops at the NUL) + 1 + 300, more than one chunk */
+	if(term_writev(1, iov, 4) == 317) return PASS;
+	return FAIL;
+}
+
+/* fs_mmap_test
+ * 
+ * Map a multi-block file into a process's mmap window and compare it with read_data
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: uses and then releases the page directory of the last PCB number
+ * Coverage: file_block_addr, mmap window page tables
+ * Files: paging.h/c, file_system.h/c
+ */
+int fs_mmap_test(){
+	TEST_HEADER;
+
+	static uint8_t buf[FS_BLOCK_SIZE];
+	dentry_t dentry;
+	uint32_t pcb_number = MMAP_TAB_MAX - 1;
+	uint32_t size, npages, addr, i, j, off, n;
+	int result = PASS;
+
+	if(read_dentry_by_name("verylargetextwithverylongname.tx", &dentry) == -1) return FAIL;
+	size = inodeblk[dentry.inode].size;
+	npages = (size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+
+	user_dir_init(pcb_number);
+	user_dir_switch(pcb_number);
+	addr = mmap_reserve(pcb_number, npages);
+	if(addr != MMAP_START) result = FAIL;
+	for(i = 0; i < npages; i++)
+		mmap_page(pcb_number, addr + i * FS_BLOCK_SIZE, file_block_addr(dentry.inode, i));
+	flush();
+
+	for(off = 0; off < size; off += n){
+		n = read_data(dentry.inode, off, buf, FS_BLOCK_SIZE);
+		if(n == 0 || n > FS_BLOCK_SIZE){
+			result = FAIL;
+			break;
+		}
+		for(j = 0; j < n; j++)
+			if(((uint8_t*)addr)[off + j] != buf[j]) result = FAIL;
+	}
+
+	/* The next run starts after the mapping, and unmapping twice fails */
+	if(mmap_reserve(pcb_number, 1) != addr + npages * FS_BLOCK_SIZE) result = FAIL;
+	if(munmap_pages(pcb_number, addr, npages) != 0) result = FAIL;
+	if(munmap_pages(pcb_number, addr, npages) != -1) result = FAIL;
+
+	user_dir_release(pcb_number);
+	load_page_dir(page_dir);
+	return result;
+}
+
+/* xip_test
+ * 
+ * Map an executable in place, then copy one page on write, fill the
+ * program region and the stack on first touch, and stop at the guard page
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: uses and then releases the page directory of the last PCB number
+ * Coverage: user_pte, user_tab_xip, vmem_fault, user_page_fault, user_dir_release
+ * Files: paging.h/c, file_system.h/c
+ */
+int xip_test(){
+	TEST_HEADER;
+
+	static uint8_t buf[FS_BLOCK_SIZE];
+	dentry_t dentry;
+	uint32_t pcb_number = MMAP_TAB_MAX - 1;
+	uint32_t free_before = frames_free;
+	uint8_t* image = (uint8_t*)0x08048000;
+	uint32_t heap_start = USER_VIRTUAL_START + FRAME_LARGE_SIZE;
+	uint32_t* stack = (uint32_t*)(USER_STACK_TOP - 4);
+	uint32_t size, npages, i;
+	int result = PASS;
+
+	if(read_dentry_by_name("hello", &dentry) == -1) return FAIL;
+	size = inodeblk[dentry.inode].size;
+	npages = (size + FS_BLOCK_SIZE - 1) / FS_BLOCK_SIZE;
+
+	user_dir_init(pcb_number);
+	for(i = 0; i < npages; i++)
+		if(user_tab_xip(pcb_number, (uint32_t)image + i * FS_BLOCK_SIZE, file_block_addr(dentry.inode, i)) != 0) result = FAIL;
+	user_dir_switch(pcb_number);
+
+	/* The first page is the filesystem block itself */
+	if(read_data(dentry.inode, 0, buf, FS_BLOCK_SIZE) != FS_BLOCK_SIZE) result = FAIL;
+	for(i = 0; i < FS_BLOCK_SIZE; i++)
+		if(image[i] != buf[i]) result = FAIL;
+
+	/* A write fault gives the page a private copy with the same contents,
+	 * and writing it leaves the filesystem alone */
+	if(vmem_fault(pcb_number, heap_start, (uint32_t)image + 4, 0x3) != 0) result = FAIL;
+	if(*user_pte(pcb_number, (uint32_t)image, 0) & PTE_XIP) result = FAIL;
+	for(i = 0; i < FS_BLOCK_SIZE; i++)
+		if(image[i] != buf[i]) result = FAIL;
+	image[0] = 0;
+	read_data(dentry.inode, 0, buf, 1);
+	if(buf[0] != 0x7f) result = FAIL;
+
+	/* A page that is already private is not a copy on write fault */
+	if(vmem_fault(pcb_number, heap_start, (uint32_t)image + 4, 0x3) != -1) result = FAIL;
+
+	/* The top of the stack is filled with a zeroed frame on first touch, the
+	 * guard page and the heap are not. One page table for the program region,
+	 * one for the stack and two pages */
+	if(vmem_fault(pcb_number, heap_start, (uint32_t)stack, 0x6) != 0) result = FAIL;
+	if(*stack != 0) result = FAIL;
+	if(vmem_fault(pcb_number, heap_start, USER_STACK_GUARD, 0x6) != -1) result = FAIL;
+	if(vmem_fault(pcb_number, heap_start, heap_start, 0x6) != -1) result = FAIL;
+	if(free_before - frames_free != 4) result = FAIL;
+
+	user_dir_release(pcb_number);
+	load_page_dir(page_dir);
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
+/* buddy_test
+ * 
+ * Allocate blocks of several orders, check their alignment, and check that
+ * freeing them merges everything back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: buddy_alloc, buddy_free
+ * Files: buddy.h/c
+ */
+int buddy_test(){
+	TEST_HEADER;
+
+	uint32_t free_before = frames_free;
+	uint32_t a, b, c;
+	int result = PASS;
+
+	a = buddy_alloc(0);
+	b = buddy_alloc(3);
+	if(a == 0 || b == 0 || (a & (FRAME_SIZE - 1)) || (b & (8 * FRAME_SIZE - 1))) result = FAIL;
+	if(free_before - frames_free != 9) result = FAIL;
+	buddy_free(a, 0);
+	buddy_free(b, 3);
+	if(frames_free != free_before) result = FAIL;
+
+	/* A freed 4MB block is the first one handed out again */
+	c = buddy_alloc(BUDDY_MAX_ORDER);
+	if(c == 0 || (c & (FRAME_LARGE_SIZE - 1))) result = FAIL;
+	buddy_free(c, BUDDY_MAX_ORDER);
+	if(buddy_alloc(BUDDY_MAX_ORDER) != c) result = FAIL;
+	buddy_free(c, BUDDY_MAX_ORDER);
+
+	if(buddy_alloc(BUDDY_MAX_ORDER + 1) != 0) result = FAIL;
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
+/* slab_ctor
+ * Constructor of slab_test's cache, marks the object as constructed */
+static void slab_ctor(void* obj){
+	*(uint32_t*)obj = 0x391;
+}
+
+/* slab_test
+ * 
+ * Allocate from a cache with a constructor and from kmalloc, check the
+ * alignment, that freed objects are reused in their constructed state, and
+ * that the usage counters come back to zero
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: kmem_cache_create/destroy, kmem_cache_alloc/free, kmalloc/kfree
+ * Files: slab.h/c
+ */
+int slab_test(){
+	TEST_HEADER;
+
+	kmem_cache_t* cache;
+	uint32_t free_before = frames_free;
+	uint32_t* a;
+	uint32_t* b;
+	uint8_t* p;
+	int result = PASS;
+
+	cache = kmem_cache_create("slab_test", 40, slab_ctor);
+	if(cache == NULL) return FAIL;
+	if(cache->size != CACHE_LINE_SIZE) result = FAIL;
+
+	a = kmem_cache_alloc(cache);
+	b = kmem_cache_alloc(cache);
+	if(a == NULL || b == NULL || ((uint32_t)a & (CACHE_LINE_SIZE - 1))) result = FAIL;
+	if(a != NULL && *a != 0x391) result = FAIL;
+	if(cache->active != 2 || cache->slabs != 1) result = FAIL;
+
+	/* The last object freed is the next one handed out, still constructed */
+	kmem_cache_free(cache, b);
+	if(kmem_cache_alloc(cache) != b || *b != 0x391) result = FAIL;
+	kmem_cache_free(cache, b);
+	kmem_cache_free(cache, a);
+	if(cache->active != 0 || cache->allocs != cache->frees) result = FAIL;
+	if(kmem_cache_destroy(cache) != 0) result = FAIL;
+	if(frames_free != free_before) result = FAIL;
+
+	/* 100 bytes come from the 128 byte class */
+	p = kmalloc(100);
+	if(p == NULL || ((uint32_t)p & 127)) result = FAIL;
+	kfree(p);
+	if(kmalloc(SLAB_OBJ_MAX + 1) != NULL) result = FAIL;
+	return result;
+}
+
+/* vmem_test
+ * 
+ * Grow and shrink a heap across a 4MB boundary, map and unmap large
+ * anonymous memory, check which pages the kernel may write, and check
+ * every frame comes back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: uses and then releases the page directory of the last PCB number
+ * Coverage: buddy allocator, heap_grow/heap_shrink, anon_mmap, vmem_writable, user_dir_release
+ * Files: buddy.h/c, vmem.h/c, paging.h/c
+ */
+int vmem_test(){
+	TEST_HEADER;
+
+	uint32_t pcb_number = MMAP_TAB_MAX - 1;
+	uint32_t free_before = frames_free;
+	uint32_t heap_start = USER_VIRTUAL_START + FRAME_LARGE_SIZE;
+	uint32_t top = heap_start + FRAME_LARGE_SIZE + FRAME_SIZE;
+	uint32_t* word;
+	uint32_t addr;
+	int result = PASS;
+
+	user_dir_init(pcb_number);
+	user_dir_switch(pcb_number);
+
+	/* 1025 pages and the two page tables they span */
+	if(heap_grow(pcb_number, heap_start, top) != 0) result = FAIL;
+	if(free_before - frames_free != FRAME_LARGE_PAGES + 3) result = FAIL;
+	word = (uint32_t*)(top - 4);
+	if(*word != 0) result = FAIL;
+	*word = 0x391;
+	if(!user_mapped(heap_start, top - heap_start, 1)) result = FAIL;
+
+	/* Back down to one page, the page tables stay */
+	heap_shrink(pcb_number, top, heap_start + 100);
+	if(free_before - frames_free != 3) result = FAIL;
+	if(user_mapped(heap_start + FRAME_SIZE, 1, 0)) result = FAIL;
+
+	/* 6MB rounds up to two 4MB pages, a small request takes 4kB pages */
+	addr = anon_mmap(pcb_number, 6 * 0x100000);
+	if(addr != ANON_LARGE_START) result = FAIL;
+	if(anon_munmap_large(pcb_number, addr, 6 * 0x100000) != 0) result = FAIL;
+	addr = anon_mmap(pcb_number, 3 * FRAME_SIZE);
+	if(addr != MMAP_START || free_before - frames_free != 7) result = FAIL;
+
+	/* The kernel may write the heap, copy on write and untouched program
+	 * pages, but not read-only text, which reads still accept */
+	user_tab_shared(pcb_number, USER_VIRTUAL_START, VIDEO_PHYS);
+	user_tab_xip(pcb_number, USER_VIRTUAL_START + FRAME_SIZE, VIDEO_PHYS);
+	flush();
+	if(!vmem_writable(heap_start, heap_start, 100)) result = FAIL;
+	if(vmem_writable(heap_start, USER_VIRTUAL_START + 100, 1)) result = FAIL;
+	if(vmem_writable(heap_start, USER_VIRTUAL_START + FRAME_SIZE - 1, 2)) result = FAIL;
+	if(!vmem_writable(heap_start, USER_VIRTUAL_START + FRAME_SIZE, 2 * FRAME_SIZE)) result = FAIL;
+	if(!vmem_demand(heap_start, USER_VIRTUAL_START + 100, 1)) result = FAIL;
+
+	user_dir_release(pcb_number);
+	load_page_dir(page_dir);
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
+/* fpu_test
+ * 
+ * Give the FPU to the boot context as if it were PCB 0: the first FPU
+ * instruction after a switch must trap once, and a switch back to the owner
+ * must not trap again or lose the registers
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: overwrites the PCB 0 fields the FPU code uses, frees its state
+ * Coverage: fpu_init, fpu_switch, fpu_nm_handler, fpu_release
+ * Files: fpu.h/c, idt_handler.S
+ */
+int fpu_test(){
+	TEST_HEADER;
+
+	pcb_t* pcb = get_cur_pcb();
+	uint32_t cr0, value = 0;
+	int result = PASS;
+
+	pcb->process_number = 0;
+	pcb->fpu_state = NULL;
+
+	/* Someone else's turn: TS set, nothing saved */
+	fpu_switch(1);
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	if(!(cr0 & CR0_TS)) result = FAIL;
+
+	/* First use traps, allocates a clean state and clears TS */
+	asm volatile("fld1");
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	if((cr0 & CR0_TS) || pcb->fpu_state == NULL) result = FAIL;
+
+	/* Away and back without anyone else touching the FPU: still loaded */
+	fpu_switch(1);
+	fpu_switch(0);
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	if(cr0 & CR0_TS) result = FAIL;
+	asm volatile("fistpl %0" : "=m"(value));
+	if(value != 1) result = FAIL;
+
+	fpu_release(0);
+	if(pcb->fpu_state != NULL) result = FAIL;
+	fpu_switch(1);
+	return result;
+}
+
+/* switch_bench_test
+ * 
+ * Ping-pong switch_to between the boot context and a kernel-only task on a
+ * static stack, and print the cycles of one switch. Both share the page
+ * directory, so CR3 is not reloaded and the number is the stack swap alone
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: leaves the test task parked on its stack, restores tss.esp0
+ * Coverage: switch_to
+ * Files: switch.h/S
+ */
+#define SWITCH_TEST_ROUNDS	10000
+#define SWITCH_TEST_STACK	1024
+static task_ctx_t switch_test_main, switch_test_peer;
+static uint32_t switch_test_stack[SWITCH_TEST_STACK];
+static volatile uint32_t switch_test_count;
+
+static void switch_test_loop(void){
+	while(1){
+		switch_test_count++;
+		switch_to(&switch_test_peer, &switch_test_main);
+	}
+}
+
+int switch_bench_test(){
+	TEST_HEADER;
+
+	uint32_t flags, cr3, esp0 = tss.esp0;
+	uint32_t* sp = &switch_test_stack[SWITCH_TEST_STACK];
+	uint64_t start;
+	uint32_t cycles;
+	int i;
+
+	asm volatile("movl %%cr3, %0" : "=r"(cr3));
+	/* What switch_to pops: EDI, ESI, EBX, EBP, then its return address */
+	*--sp = 0;
+	*--sp = (uint32_t)switch_test_loop;
+	*--sp = 0;
+	*--sp = 0;
+	*--sp = 0;
+	*--sp = 0;
+	switch_test_peer.ksp = (uint32_t)sp;
+	switch_test_peer.esp0 = esp0;
+	switch_test_peer.cr3 = cr3;
+	switch_test_main.esp0 = esp0;
+	switch_test_main.cr3 = cr3;
+	switch_test_count = 0;
+
+	cli_and_save(flags);
+	start = rdtsc();
+	for(i = 0; i < SWITCH_TEST_ROUNDS; i++)
+		switch_to(&switch_test_main, &switch_test_peer);
+	cycles = rdtsc() - start;
+	tss.esp0 = esp0;
+	restore_flags(flags);
+
+	printf("%d cycles per switch\n", (uint32_t)cycles / (2 * SWITCH_TEST_ROUNDS));
+	return (switch_test_count == SWITCH_TEST_ROUNDS) ? PASS : FAIL;
+}
+
+/* opt_bench_test
+ * 
+ * Time the system call entry, exec's image lookup and a whole file read in
+ * cycles per round. Run it from `make` and from `make opt` to compare -O0
+ * with -O2
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: prints the three timings
+ * Coverage: syscall_dispatch, read_dentry_by_name, read_data, elf_check
+ * Files: idt_handler.S, file_system.h/c, elf.h/c, Makefile
+ */
+#define OPT_BENCH_ROUNDS	1000
+int opt_bench_test(){
+	TEST_HEADER;
+
+	static uint8_t buf[FS_BLOCK_SIZE];
+	static elf_image_t image;
+	dentry_t dentry;
+	uint64_t start;
+	uint32_t cycles, size, off, n, i;
+	int32_t ret = 0;
+	int result = PASS;
+
+	/* int $0x80 and back, call number 0 is turned away by syscall_dispatch */
+	start = rdtsc();
+	for(i = 0; i < OPT_BENCH_ROUNDS; i++)
+		asm volatile("int $0x80" : "=a"(ret) : "a"(0) : "ecx", "edx", "memory");
+	cycles = (uint32_t)(rdtsc() - start);
+	if(ret != -1) result = FAIL;
+	printf("syscall: %d cycles\n", cycles / OPT_BENCH_ROUNDS);
+
+	/* What execute does before it takes a PCB: find the file and check its
+	 * ELF and program headers */
+	start = rdtsc();
+	for(i = 0; i < OPT_BENCH_ROUNDS; i++){
+		if(read_dentry_by_name("shell", &dentry) == -1) return FAIL;
+		if(elf_check(dentry.inode, &image) == -1) result = FAIL;
+	}
+	cycles = (uint32_t)(rdtsc() - start);
+	printf("exec lookup: %d cycles\n", cycles / OPT_BENCH_ROUNDS);
+
+	/* The largest text file, one block at a time */
+	if(read_dentry_by_name("verylargetextwithverylongname.tx", &dentry) == -1) return FAIL;
+	size = inodeblk[dentry.inode].size;
+	start = rdtsc();
+	for(i = 0; i < OPT_BENCH_ROUNDS; i++){
+		for(off = 0; off < size; off += n){
+			n = read_data(dentry.inode, off, buf, FS_BLOCK_SIZE);
+			if(n == 0) return FAIL;
+		}
+	}
+	cycles = (uint32_t)(rdtsc() - start);
+	printf("read %d bytes: %d cycles\n", size, cycles / OPT_BENCH_ROUNDS);
+
+	return result;
+}
+
+/* mem_bandwidth_test
+ * 
+ * Time memcpy and memset from 64B to 4MB between two 4MB buddy blocks and
+ * print the cycles per kB of each, with the features mem_init picked.
+ * Every copy and fill is checked
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: borrows two 4MB blocks for the duration
+ * Coverage: memcpy, memset, memcpy_large, memset_large, kernel_fpu_begin/end
+ * Files: memops.h/c, lib.c, fpu.h/c
+ */
+#define MEM_TEST_BYTES	0x800000	/* moved per size */
+int mem_bandwidth_test(){
+	TEST_HEADER;
+
+	uint32_t src_frame = buddy_alloc(BUDDY_LARGE_ORDER);
+	uint32_t dst_frame = buddy_alloc(BUDDY_LARGE_ORDER);
+	uint8_t* src = phys_to_virt(src_frame);
+	uint8_t* dst = phys_to_virt(dst_frame);
+	uint32_t size, rounds, i, copy_cycles, set_cycles;
+	uint64_t start;
+	int result = PASS;
+
+	if(src_frame == 0 || dst_frame == 0) result = FAIL;
+
+	printf("ERMS %d SSE2 %d\n", (mem_features & MEM_ERMS) ? 1 : 0, (mem_features & MEM_SSE2) ? 1 : 0);
+	printf("size       memcpy cyc/kB  memset cyc/kB\n");
+	for(size = 64; result == PASS && size <= FRAME_LARGE_SIZE; size <<= 2){
+		for(i = 0; i < size; i++) src[i] = (uint8_t)(i * 7 + 1);
+		rounds = MEM_TEST_BYTES / size;
+
+		start = rdtsc();
+		for(i = 0; i < rounds; i++) memcpy(dst, src, size);
+		copy_cycles = (uint32_t)(rdtsc() - start);
+		for(i = 0; i < size; i++)
+			if(dst[i] != src[i]) result = FAIL;
+
+		start = rdtsc();
+		for(i = 0; i < rounds; i++) memset(dst, 0x5A, size);
+		set_cycles = (uint32_t)(rdtsc() - start);
+		for(i = 0; i < size; i++)
+			if(dst[i] != 0x5A) result = FAIL;
+
+		printf("%d\t%d\t%d\n", size, copy_cycles / (MEM_TEST_BYTES >> 10), set_cycles / (MEM_TEST_BYTES >> 10));
+	}
+
+	if(src_frame != 0) buddy_free(src_frame, BUDDY_LARGE_ORDER);
+	if(dst_frame != 0) buddy_free(dst_frame, BUDDY_LARGE_ORDER);
+	return result;
+}
+
+/* Byte at a time strncmp and strlen, what lib.c had before, for string_bench_test */
+static int32_t byte_strncmp(const int8_t* s1, const int8_t* s2, uint32_t n){
+	uint32_t i;
+	for(i = 0; i < n; i++)
+		if(s1[i] != s2[i] || s1[i] == '\0') return s1[i] - s2[i];
+	return 0;
+}
+
+static uint32_t byte_strlen(const int8_t* s){
+	uint32_t len = 0;
+	while(s[len] != '\0') len++;
+	return len;
+}
+
+/* string_bench_test
+ * 
+ * Compare the word at a time strncmp with a byte loop on 32 byte file names,
+ * and strlen and strcpy on a 100 byte argument string, printing cycles per
+ * call of each. Results must agree with the byte loops at every alignment
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: strncmp, strlen, strcpy, strchrnul
+ * Files: lib.h/c
+ */
+#define STRING_BENCH_ROUNDS	10000
+int string_bench_test(){
+	TEST_HEADER;
+
+	static int8_t name1[MAX_FILENAME_LENGTH + 8], name2[MAX_FILENAME_LENGTH + 8];
+	static int8_t arg[MAX_ARG_LENGTH + 8], copy[MAX_ARG_LENGTH + 8];
+	volatile int32_t sink = 0;
+	uint64_t start;
+	uint32_t i, off, fast, slow;
+	int result = PASS;
+
+	/* Two 32 byte names differing only in the last character */
+	for(i = 0; i < MAX_FILENAME_LENGTH; i++) name1[i] = name2[i] = 'a' + i % 26;
+	name2[MAX_FILENAME_LENGTH - 1] = 'A';
+	for(i = 0; i < MAX_ARG_LENGTH - 1; i++) arg[i] = 'a' + i % 26;
+	arg[MAX_ARG_LENGTH - 1] = '\0';
+
+	/* Same answers at every relative alignment, and a 100 byte strcpy */
+	for(off = 0; off < 4; off++){
+		if((strncmp(name1 + off, name2, MAX_FILENAME_LENGTH) < 0) != (byte_strncmp(name1 + off, name2, MAX_FILENAME_LENGTH) < 0)) result = FAIL;
+		if(strlen(arg + off) != byte_strlen(arg + off)) result = FAIL;
+	}
+	if(strncmp(name1, name2, MAX_FILENAME_LENGTH - 1) != 0 || strncmp(name1, name2, MAX_FILENAME_LENGTH) <= 0) result = FAIL;
+	strcpy(copy + 1, arg);
+	if(byte_strncmp(copy + 1, arg, MAX_ARG_LENGTH) != 0) result = FAIL;
+	if(strchrnul(arg, 'z') != arg + 25 || *strchrnul(arg, '!') != '\0') result = FAIL;
+
+	start = rdtsc();
+	for(i = 0; i < STRING_BENCH_ROUNDS; i++) sink += strncmp(name1, name2, MAX_FILENAME_LENGTH);
+	fast = (uint32_t)(rdtsc() - start) / STRING_BENCH_ROUNDS;
+	start = rdtsc();
+	for(i = 0; i < STRING_BENCH_ROUNDS; i++) sink += byte_strncmp(name1, name2, MAX_FILENAME_LENGTH);
+	slow = (uint32_t)(rdtsc() - start) / STRING_BENCH_ROUNDS;
+	printf("strncmp 32B: %d cycles, bytewise %d\n", fast, slow);
+
+	start = rdtsc();
+	for(i = 0; i < STRING_BENCH_ROUNDS; i++) sink += strlen(arg);
+	fast = (uint32_t)(rdtsc() - start) / STRING_BENCH_ROUNDS;
+	start = rdtsc();
+	for(i = 0; i < STRING_BENCH_ROUNDS; i++) sink += byte_strlen(arg);
+	slow = (uint32_t)(rdtsc() - start) / STRING_BENCH_ROUNDS;
+	printf("strlen 100B: %d cycles, bytewise %d\n", fast, slow);
+
+	start = rdtsc();
+	for(i = 0; i < STRING_BENCH_ROUNDS; i++) strcpy(copy, arg);
+	fast = (uint32_t)(rdtsc() - start) / STRING_BENCH_ROUNDS;
+	printf("strcpy 100B: %d cycles\n", fast);
+
+	return result;
+}
+
+/* snprintf_test
+ * 
+ * Format padded, signed, 64-bit and hex values into a buffer and compare,
+ * check truncation keeps the NULL and still returns the full length, then
+ * time printf of one line against putc of each of its characters
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: Prints two lines
+ * Coverage: vsnprintf, snprintf, printf, console_write
+ * Files: lib.h/c
+ */
+int snprintf_test(){
+	TEST_HEADER;
+
+	int8_t buf[64];
+	const int8_t* line = "bulk console write of one formatted line\n";
+	uint64_t start;
+	uint32_t i, bulk, bytewise;
+	int result = PASS;
+
+	if(snprintf(buf, 64, "%d|%5d|%-5d|%05d", -42, 7, 7, -7) != 21 ||
+		strncmp(buf, "-42|    7|7    |-0007", 64) != 0) result = FAIL;
+	if(snprintf(buf, 64, "%x %X %#x %p", 0xbeef, 0xbeef, 0x1f, (void*)0x1234) != 29 ||
+		strncmp(buf, "beef BEEF 0000001f 0x00001234", 64) != 0) result = FAIL;
+	if(snprintf(buf, 64, "%llu %lld", 18446744073709551615ULL, -9223372036854775807LL - 1) != 41 ||
+		strncmp(buf, "18446744073709551615 -9223372036854775808", 64) != 0) result = FAIL;
+	if(snprintf(buf, 64, "[%6s][%-6s][%.2s][%*u][%c]%%", "ab", "ab", "xyz", 4, 9, 'q') != 30 ||
+		strncmp(buf, "[    ab][ab    ][xy][   9][q]%", 64) != 0) result = FAIL;
+	if(snprintf(buf, 8, "hello world") != 11 || strncmp(buf, "hello w", 8) != 0) result = FAIL;
+	if(snprintf(buf, 0, "abc") != 3) result = FAIL;
+
+	start = rdtsc();
+	printf("%s", line);
+	bulk = (uint32_t)(rdtsc() - start);
+	start = rdtsc();
+	for(i = 0; line[i] != '\0'; i++) putc(line[i]);
+	bytewise = (uint32_t)(rdtsc() - start);
+	printf("one line: printf %d cycles, putc per char %d\n", bulk, bytewise);
+
+	return result;
+}
+
+/* elf_test
+ * 
+ * Check the headers of a linked program and of a program with .bss, and
+ * turn away a text file. Map the program and check its text is shared read
+ * only, and the page where its data ends is private with zeros after the
+ * data
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: uses and then releases the page directory of the last PCB number
+ * Coverage: elf_check, elf_map, user_tab_shared, user_dir_release
+ * Files: elf.h/c, paging.h/c
+ */
+int elf_test(){
+	TEST_HEADER;
+
+	static elf_image_t image;
+	static uint8_t buf[FS_BLOCK_SIZE];
+	dentry_t dentry;
+	elf_phdr_t* ph;
+	uint32_t pcb_number = MMAP_TAB_MAX - 1;
+	uint32_t free_before = frames_free;
+	uint32_t top = 0, page, end, off, i;
+	uint32_t* entry;
+	uint8_t* mem;
+	int result = PASS;
+
+	if(read_dentry_by_name("frame0.txt", &dentry) == -1) return FAIL;
+	if(elf_check(dentry.inode, &image) != -1) result = FAIL;
+
+	/* shell is linked, not flat: its section headers follow the last
+	 * segment, and each segment starts on the file block it is mapped from */
+	if(read_dentry_by_name("shell", &dentry) == -1) return FAIL;
+	if(elf_check(dentry.inode, &image) != 0) return FAIL;
+	for(i = 0; i < image.nload; i++){
+		if(image.load[i].p_vaddr + image.load[i].p_memsz > top) top = image.load[i].p_vaddr + image.load[i].p_memsz;
+		if((image.load[i].p_offset ^ image.load[i].p_vaddr) & (FRAME_SIZE - 1)) result = FAIL;
+	}
+	if(image.size <= top - ELF_FLAT_BASE) result = FAIL;
+
+	/* fish has .bss past its data, the heap starts right after it */
+	if(read_dentry_by_name("fish", &dentry) == -1) return FAIL;
+	if(elf_check(dentry.inode, &image) != 0) return FAIL;
+	for(i = 0, top = 0; i < image.nload; i++)
+		if(image.load[i].p_vaddr + image.load[i].p_memsz > top) top = image.load[i].p_vaddr + image.load[i].p_memsz;
+	if(image.heap_start != ((top + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1))) result = FAIL;
+
+	user_dir_init(pcb_number);
+	if(elf_map(pcb_number, &image) != 0) result = FAIL;
+	for(i = 0; i < image.nload; i++){
+		ph = &image.load[i];
+		entry = user_pte(pcb_number, ph->p_vaddr, 0);
+		if(entry == NULL || !(*entry & 0x1)) { result = FAIL; continue; }
+
+		/* Text in place, writes fault */
+		if(!(ph->p_flags & PF_W) && (*entry & (PTE_XIP | PTE_ANON | 0x2))) result = FAIL;
+
+		/* The last page of the data holds the file bytes, then zeros */
+		if(ph->p_memsz > ph->p_filesz){
+			end = ph->p_vaddr + ph->p_filesz;
+			page = end & ~(FRAME_SIZE - 1);
+			entry = user_pte(pcb_number, page, 0);
+			if((*entry & (PTE_ANON | 0x3)) != (PTE_ANON | 0x3)) { result = FAIL; continue; }
+			mem = phys_to_virt(*entry & 0xFFFFF000);
+			read_data(dentry.inode, ph->p_offset + (page - ph->p_vaddr), buf, end - page);
+			for(off = 0; off < end - page; off++)
+				if(mem[off] != buf[off]) result = FAIL;
+			for(; off < FRAME_SIZE; off++)
+				if(mem[off] != 0) result = FAIL;
+		}
+	}
+
+	user_dir_release(pcb_number);
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
+/* stack_args_test
+ * 
+ * Lay out a command line on a fresh stack and read it back through the
+ * direct map: argc at ESP on a 16 byte boundary, argv in order with its
+ * NULL, then an empty envp. Too many words and an empty command fail
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: uses and then releases the page directory of the last PCB number
+ * Coverage: stack_args
+ * Files: vmem.h/c
+ */
+int stack_args_test(){
+	TEST_HEADER;
+
+	static int8_t many[2 * ARGV_MAX + 3];
+	const int8_t* words[3] = {"cat", "frame0.txt", "x"};
+	uint32_t pcb_number = MMAP_TAB_MAX - 1;
+	uint32_t free_before = frames_free;
+	uint32_t base = USER_STACK_TOP - FRAME_SIZE;
+	uint32_t esp, argc, argv, i;
+	uint32_t* entry;
+	uint32_t* sp;
+	uint8_t* mem;
+	int result = PASS;
+
+	user_dir_init(pcb_number);
+	esp = stack_args(pcb_number, "  cat   frame0.txt x ", &argc, &argv);
+	if(esp == 0 || (esp & 0xF) || argc != 3 || argv != esp + 4) result = FAIL;
+	entry = user_pte(pcb_number, base, 0);
+	if(esp != 0 && entry != NULL){
+		mem = phys_to_virt(*entry & 0xFFFFF000);
+		sp = (uint32_t*)(mem + (esp - base));
+		if(sp[0] != 3) result = FAIL;
+		for(i = 0; i < 3; i++)
+			if(strncmp((int8_t*)mem + (sp[i + 1] - base), words[i], 16) != 0) result = FAIL;
+		/* argv's NULL, envp's NULL, AT_NULL */
+		if(sp[4] != 0 || sp[5] != 0 || sp[6] != AT_NULL) result = FAIL;
+	}
+
+	/* One word more than ARGV_MAX */
+	for(i = 0; i <= ARGV_MAX; i++){
+		many[2 * i] = 'a';
+		many[2 * i + 1] = ' ';
+	}
+	if(stack_args(pcb_number, many, &argc, &argv) != 0) result = FAIL;
+	if(stack_args(pcb_number, "   ", &argc, &argv) != 0) result = FAIL;
+
+	user_dir_release(pcb_number);
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
+/* waitpid_test
+ * 
+ * Fake a spawned child of the running code in a free PCB of the last
+ * terminal and reap it: WNOHANG finds it still running, then returns its
+ * PID once it is a zombie and frees the PCB, after which there is no child
+ * left
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: borrows a PCB, interrupts are off while it runs
+ * Coverage: waitpid, PCB_process_number, PCB_in_use
+ * Files: system_call.h/c
+ */
+int waitpid_test(){
+	TEST_HEADER;
+
+	int32_t pcb_number;
+	pcb_t* child;
+	uint32_t flags;
+	int result = PASS;
+
+	cli_and_save(flags);
+	pcb_number = PCB_process_number(TERM_MAX - 1);
+	if(pcb_number == -1 || !PCB_in_use(pcb_number)){
+		restore_flags(flags);
+		return FAIL;
+	}
+
+	child = get_pcb_from_id(pcb_number);
+	child->process_number = pcb_number;
+	child->parent_process_number = get_cur_pcb()->process_number;
+	child->spawned = 1;
+	child->state = PROC_RUNNING;
+	if(waitpid(pcb_number, NULL, WNOHANG) != 0) result = FAIL;
+	if(waitpid(-1, NULL, WNOHANG) != 0) result = FAIL;
+	if(waitpid(PCB_MAX, NULL, WNOHANG) != -1) result = FAIL;
+
+	child->state = PROC_ZOMBIE;
+	child->exit_status = 7;
+	if(waitpid(-1, NULL, WNOHANG) != pcb_number) result = FAIL;
+	if(PCB_in_use(pcb_number)) result = FAIL;
+	if(waitpid(-1, NULL, WNOHANG) != -1) result = FAIL;
+
+	restore_flags(flags);
+	return result;
+}
+
+/* pipe_test
+ * 
+ * Fill a fresh pipe, drain part of it and write again so the ring wraps,
+ * then read everything back and check the bytes come out in order. Closing
+ * both ends must give the frame back
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: None
+ * Coverage: pipe_alloc, pipe_put, pipe_get, pipe_release
+ * Files: pipe.h/c
+ */
+int pipe_test(){
+	TEST_HEADER;
+
+	static uint8_t in[PIPE_SIZE + 300];
+	static uint8_t out[PIPE_SIZE + 300];
+	uint32_t free_before = frames_free;
+	uint32_t i;
+	pipe_t* p;
+	int result = PASS;
+
+	for(i = 0; i < sizeof(in); i++) in[i] = (uint8_t)(i * 7 + 3);
+
+	p = pipe_alloc();
+	if(p == NULL) return FAIL;
+	if(pipe_get(p, out, 10) != 0) result = FAIL;
+
+	/* Only PIPE_SIZE bytes fit */
+	if(pipe_put(p, in, PIPE_SIZE + 100) != PIPE_SIZE) result = FAIL;
+	if(pipe_put(p, in, 1) != 0) result = FAIL;
+
+	/* Take 300 out and put the last 300 in, across the end of the ring */
+	if(pipe_get(p, out, 300) != 300) result = FAIL;
+	if(pipe_put(p, in + PIPE_SIZE, 300) != 300) result = FAIL;
+	if(pipe_get(p, out + 300, PIPE_SIZE + 100) != PIPE_SIZE) result = FAIL;
+	for(i = 0; i < sizeof(in); i++)
+		if(in[i] != out[i]) result = FAIL;
+	if(pipe_get(p, out, 1) != 0) result = FAIL;
+
+	pipe_release(p, PIPE_WRITER);
+	pipe_release(p, PIPE_READER);
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
+/* getargs_test
+ * 
+ * Lay out "cat frame0.txt x" on a user stack, point the running PCB's argv
+ * at it, and read the arguments back into a buffer on the same stack page.
+ * A kernel address or an empty buffer must be refused before any copy
+ * Inputs: None
+ * Outputs: PASS/FAIL
+ * Side Effects: uses and then releases the page directory of the last PCB
+ *               number, borrows the running PCB's argc and argv
+ * Coverage: getargs, user_range_writable
+ * Files: system_call.h/c, vmem.h/c
+ */
+int getargs_test(){
+	TEST_HEADER;
+
+	uint32_t pcb_number = MMAP_TAB_MAX - 1;
+	uint32_t free_before = frames_free;
+	uint8_t* buf = (uint8_t*)(USER_STACK_TOP - FRAME_SIZE);
+	uint8_t* kernel_buf = (uint8_t*)(KERNEL_VIRTUAL_BASE + 0x100000);
+	pcb_t* pcb = get_cur_pcb();
+	uint32_t old_argc = pcb->argc;
+	uint32_t old_argv = pcb->argv;
+	uint8_t kernel_byte = *kernel_buf;
+	uint32_t argc, argv;
+	int result = PASS;
+
+	user_dir_init(pcb_number);
+	user_dir_switch(pcb_number);
+	if(stack_args(pcb_number, "cat frame0.txt x", &argc, &argv) == 0) result = FAIL;
+	pcb->argc = argc;
+	pcb->argv = argv;
+
+	if(getargs(buf, 32) != 0 || strncmp((int8_t*)buf, "frame0.txt x", 32) != 0) result = FAIL;
+	if(getargs(buf, 12) != -1) result = FAIL;
+	if(getargs(buf, 0) != -1) result = FAIL;
+	if(getargs(kernel_buf, 32) != -1 || *kernel_buf != kernel_byte) result = FAIL;
+
+	pcb->argc = old_argc;
+	pcb->argv = old_argv;
+	user_dir_release(pcb_number);
+	load_page_dir(page_dir);
+	if(frames_free != free_before) result = FAIL;
+	return result;
+}
+
 /* Checkpoint 3 tests */
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
@@ -626,4 +1718,48 @@ void launch_tests()
 	// TEST_OUTPUT("rtc_general_test", rtc_general_test());
 	/* Sweep frequency from 2Hz to 1024Hz */
 	// TEST_OUTPUT("rtc_sweep_test", rtc_sweep_test());
+
+	/* Tickless idle test, should report far fewer than 100 PIT interrupts/s */
+	// TEST_OUTPUT("tickless_idle_test", tickless_idle_test());
+
+	/* Shared IRQ line test, prints the irqstat table */
+	// TEST_OUTPUT("shared_irq_test", shared_irq_test());
+	/* Deferred work test, the tasklet must run with interrupts enabled */
+	// TEST_OUTPUT("tasklet_test", tasklet_test());
+	/* irqsoff tracer test, prints the longest interrupts-off window */
+	// TEST_OUTPUT("irqsoff_test", irqsoff_test());
+	/* Vectored terminal write test */
+	// TEST_OUTPUT("term_writev_test", term_writev_test());
+	/* mmap window test, maps a file from the filesystem image */
+	// TEST_OUTPUT("fs_mmap_test", fs_mmap_test());
+	/* Execute in place test, shares an executable's pages until written */
+	// TEST_OUTPUT("xip_test", xip_test());
+	/* Buddy allocator test, every block must merge back */
+	// TEST_OUTPUT("buddy_test", buddy_test());
+	/* Slab allocator test, counters must return to zero */
+	// TEST_OUTPUT("slab_test", slab_test());
+	/* Heap and anonymous memory test, every frame must be freed at the end */
+	// TEST_OUTPUT("vmem_test", vmem_test());
+	/* Lazy FPU switching test, one #NM on first use and none after */
+	// TEST_OUTPUT("fpu_test", fpu_test());
+	/* Context switch benchmark, prints the cycles of one switch_to */
+	// TEST_OUTPUT("switch_bench_test", switch_bench_test());
+	/* -O0 against -O2 benchmark, prints cycles of the syscall, exec and read paths */
+	// TEST_OUTPUT("opt_bench_test", opt_bench_test());
+	/* memcpy and memset bandwidth from 64B to 4MB */
+	// TEST_OUTPUT("mem_bandwidth_test", mem_bandwidth_test());
+	/* Word at a time string functions against byte loops */
+	// TEST_OUTPUT("string_bench_test", string_bench_test());
+	/* snprintf formatting and truncation, printf against putc */
+	// TEST_OUTPUT("snprintf_test", snprintf_test());
+	/* ELF headers of linked and .bss images, segment mapping */
+	// TEST_OUTPUT("elf_test", elf_test());
+	/* argc, argv and envp on a new user stack */
+	// TEST_OUTPUT("stack_args_test", stack_args_test());
+	/* Reaping a spawned child with waitpid and WNOHANG */
+	// TEST_OUTPUT("waitpid_test", waitpid_test());
+	/* getargs from the user stack, refusing kernel buffers */
+	// TEST_OUTPUT("getargs_test", getargs_test());
+	/* Pipe ring buffer wrapping around, the frame must be freed at the end */
+	// TEST_OUTPUT("pipe_test", pipe_test());
 }
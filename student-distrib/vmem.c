@@ -0,0 +1,272 @@
+/* vmem.c - Heap, stack and anonymous memory of user processes, backed by
+ * the buddy allocator
+ * vim:ts=4 noexpandtab
+ */
+
+#include "vmem.h"
+#include "paging.h"
+#include "buddy.h"
+
+#define PAGE_UP(addr)   (((addr) + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1))
+
+static void heap_unmap(uint32_t pcb_number, uint32_t lo, uint32_t hi);
+
+/* int32_t heap_grow(uint32_t pcb_number, uint32_t old_brk, uint32_t new_brk)
+ * Input:  pcb_number -- process whose heap grows
+ *         old_brk, new_brk -- current and wanted end of the heap
+ * Return Value: 0 on success, -1 if memory ran out, with nothing changed
+ * Function: Map every page between the two ends that is not mapped yet */
+int32_t heap_grow(uint32_t pcb_number, uint32_t old_brk, uint32_t new_brk)
+{
+    uint32_t addr;
+    uint32_t* entry;
+
+    for(addr = PAGE_UP(old_brk); addr < new_brk; addr += FRAME_SIZE)
+    {
+        entry = user_pte(pcb_number, addr, 1);
+        if(entry == NULL || (!(*entry & 0x1) && anon_page_map(entry) == -1))
+        {
+            heap_unmap(pcb_number, old_brk, addr);
+            flush();
+            return -1;
+        }
+    }
+
+    flush();
+    return 0;
+}
+
+/* void heap_shrink(uint32_t pcb_number, uint32_t old_brk, uint32_t new_brk)
+ * Input:  pcb_number -- process whose heap shrinks
+ *         old_brk, new_brk -- current and wanted end of the heap
+ * Return Value: none
+ * Function: Free the pages that now lie past the end. Page tables stay
+ * until the process halts */
+void heap_shrink(uint32_t pcb_number, uint32_t old_brk, uint32_t new_brk)
+{
+    heap_unmap(pcb_number, new_brk, old_brk);
+    flush();
+}
+
+/* int32_t vmem_demand(uint32_t heap_start, uint32_t address, uint32_t len)
+ * Input:  heap_start -- where the process's program region ends
+ *         address, len -- a user range
+ * Return Value: 1 if the whole range lies in a region filled on first
+ *               touch, 0 otherwise
+ * Function: Those regions are the program region, after the image pages,
+ * and the stack above its guard page. The kernel may touch them without
+ * checking the page tables, a fault there fills the page */
+int32_t vmem_demand(uint32_t heap_start, uint32_t address, uint32_t len)
+{
+    if(len == 0) len = 1;
+    if(address + len < address) return 0;
+    if(address >= USER_VIRTUAL_START && address + len <= heap_start) return 1;
+    if(address >= USER_STACK_GUARD + FRAME_SIZE && address + len <= USER_STACK_TOP) return 1;
+    return 0;
+}
+
+/* int32_t vmem_writable(uint32_t heap_start, uint32_t address, uint32_t len)
+ * Input:  heap_start -- where the process's program region ends
+ *         address, len -- a user range the kernel is going to write
+ * Return Value: 1 if every page can take the write, 0 otherwise
+ * Function: The write variant of vmem_demand. Pages not mapped yet have to
+ * be in a region filled on first touch, which gives a writable page. Pages
+ * already mapped have to be writable or copy on write, so the read-only
+ * text of an executable is refused */
+int32_t vmem_writable(uint32_t heap_start, uint32_t address, uint32_t len)
+{
+    uint32_t page, last;
+
+    if(len == 0) len = 1;
+    if(address + len < address) return 0;
+
+    last = (address + len - 1) & ~(FRAME_SIZE - 1);
+    for(page = address & ~(FRAME_SIZE - 1); ; page += FRAME_SIZE)
+    {
+        if(user_mapped(page, 1, 0))
+        {
+            if(!user_mapped(page, 1, 1)) return 0;
+        }
+        else if(!vmem_demand(heap_start, page, FRAME_SIZE))
+        {
+            return 0;
+        }
+        if(page == last) break;
+    }
+    return 1;
+}
+
+/* int32_t vmem_fault(uint32_t pcb_number, uint32_t heap_start, uint32_t address, uint32_t error)
+ * Input:  pcb_number -- process that faulted
+ *         heap_start -- where its program region ends
+ *         address, error -- CR2 and the page fault error code
+ * Return Value: 0 if the page was filled or copied, -1 for a real fault
+ * Function: Grow the stack or fill the program region on first touch, and
+ * copy shared image pages on write. A fault on the stack guard page, or
+ * past USER_STACK_MAX, is left to kill the process */
+int32_t vmem_fault(uint32_t pcb_number, uint32_t heap_start, uint32_t address, uint32_t error)
+{
+    if(!vmem_demand(heap_start, address, 1)) return -1;
+    return user_page_fault(pcb_number, address, error);
+}
+
+/* uint32_t stack_args(uint32_t pcb_number, const int8_t* command, uint32_t* argc, uint32_t* argv)
+ * Input:  pcb_number -- process being started, with nothing on its stack
+ *         command -- program name and arguments, separated by spaces
+ *         argc, argv -- set to the number of words and the user address of
+ *                       the argv array
+ * Return Value: ESP to start the process with, pointing at argc. 0 if the
+ *               command is empty, has more than ARGV_MAX words or does not
+ *               fit in the top page of the stack, or memory ran out
+ * Function: Lay out the stack as the SysV i386 ABI has it at process
+ * start. From ESP up: argc, the argv pointers and a NULL, the envp pointers
+ * and a NULL, and an auxiliary vector holding only AT_NULL. The strings sit
+ * above them at the top of the page. There are no environment variables, so
+ * envp is empty. The page is written through the direct map, the process's
+ * page directory does not have to be loaded */
+uint32_t stack_args(uint32_t pcb_number, const int8_t* command, uint32_t* argc, uint32_t* argv)
+{
+    uint32_t base = USER_STACK_TOP - FRAME_SIZE;
+    uint32_t uargv[ARGV_MAX];
+    uint32_t top = FRAME_SIZE;
+    uint32_t n = 0, len, i;
+    const int8_t* end;
+    uint32_t* entry;
+    uint32_t* sp;
+    uint8_t* mem;
+
+    entry = user_pte(pcb_number, base, 1);
+    if(entry == NULL || (!(*entry & 0x1) && anon_page_map(entry) == -1)) return 0;
+    mem = phys_to_virt(*entry & 0xFFFFF000);
+
+    /* The words with their NULLs, from the top of the page down */
+    for(;;)
+    {
+        while(*command == ' ') command++;
+        if(*command == '\0') break;
+        end = strchrnul(command, ' ');
+        len = end - command;
+        if(n == ARGV_MAX || len + 1 > top) return 0;
+        top -= len + 1;
+        memcpy(mem + top, command, len);
+        mem[top + len] = '\0';
+        uargv[n++] = base + top;
+        command = end;
+    }
+    if(n == 0) return 0;
+
+    /* argc, argv and its NULL, envp's NULL and AT_NULL's two words, with
+     * ESP on a 16 byte boundary */
+    len = (n + 5) * sizeof(uint32_t);
+    if(len + 0xF > top) return 0;
+    top = (top - len) & ~0xF;
+
+    sp = (uint32_t*)(mem + top);
+    *sp++ = n;
+    for(i = 0; i < n; i++) *sp++ = uargv[i];
+    *sp++ = 0;
+    *sp++ = 0;
+    *sp++ = AT_NULL;
+    *sp = 0;
+
+    *argc = n;
+    *argv = base + top + sizeof(uint32_t);
+    return base + top;
+}
+
+/* uint32_t anon_mmap(uint32_t pcb_number, uint32_t length)
+ * Input:  pcb_number -- process asking for memory
+ *         length -- bytes wanted
+ * Return Value: address of the zeroed mapping, 0 on failure
+ * Function: Requests under 4MB take 4kB pages in the mmap window. Larger
+ * ones are rounded up to whole 4MB pages in the large anonymous region, one
+ * directory entry and no page table each */
+uint32_t anon_mmap(uint32_t pcb_number, uint32_t length)
+{
+    uint32_t* dir = page_proc_dir[pcb_number];
+    uint32_t first = ANON_LARGE_START / FRAME_LARGE_SIZE;
+    uint32_t end = ANON_LARGE_END / FRAME_LARGE_SIZE;
+    uint32_t addr, n, i, run = 0;
+
+    if(length < FRAME_LARGE_SIZE)
+    {
+        n = PAGE_UP(length) / FRAME_SIZE;
+        addr = mmap_reserve(pcb_number, n);
+        if(addr == 0) return 0;
+
+        for(i = 0; i < n; i++)
+        {
+            if(anon_page_map(user_pte(pcb_number, addr + i * FRAME_SIZE, 0)) == -1)
+            {
+                if(i > 0) munmap_pages(pcb_number, addr, i);
+                return 0;
+            }
+        }
+        flush();
+        return addr;
+    }
+
+    n = (length + FRAME_LARGE_SIZE - 1) / FRAME_LARGE_SIZE;
+    for(i = first; i < end; i++)
+    {
+        run = (dir[i] & 0x1) ? 0 : run + 1;
+        if(run == n) break;
+    }
+    if(run < n) return 0;
+    first = i + 1 - n;
+
+    for(i = first; i < first + n; i++)
+    {
+        if(anon_large_map(&dir[i]) == -1)
+        {
+            while(i-- > first) anon_unmap(&dir[i], 1);
+            flush();
+            return 0;
+        }
+    }
+    flush();
+    return first * FRAME_LARGE_SIZE;
+}
+
+/* int32_t anon_munmap_large(uint32_t pcb_number, uint32_t addr, uint32_t length)
+ * Input:  pcb_number -- process giving memory back
+ *         addr, length -- a range returned by anon_mmap of 4MB or more
+ * Return Value: 0 on success, -1 if the range is misaligned or not all mapped
+ * Function: Free whole 4MB pages of the large anonymous region */
+int32_t anon_munmap_large(uint32_t pcb_number, uint32_t addr, uint32_t length)
+{
+    uint32_t* dir = page_proc_dir[pcb_number];
+    uint32_t first = addr / FRAME_LARGE_SIZE;
+    uint32_t n = (length + FRAME_LARGE_SIZE - 1) / FRAME_LARGE_SIZE;
+    uint32_t i;
+
+    if(addr & (FRAME_LARGE_SIZE - 1)) return -1;
+    if(n == 0 || first + n > ANON_LARGE_END / FRAME_LARGE_SIZE) return -1;
+
+    for(i = first; i < first + n; i++)
+        if(!(dir[i] & 0x1)) return -1;
+    for(i = first; i < first + n; i++)
+        anon_unmap(&dir[i], 1);
+
+    flush();
+    return 0;
+}
+
+/* void heap_unmap(uint32_t pcb_number, uint32_t lo, uint32_t hi)
+ * Input:  pcb_number -- process owning the heap
+ *         lo -- new end of the heap
+ *         hi -- old end of the heap
+ * Return Value: none
+ * Function: Unmap the pages that start at or after lo and before hi, so
+ * nothing below lo is lost. The caller flushes */
+static void heap_unmap(uint32_t pcb_number, uint32_t lo, uint32_t hi)
+{
+    uint32_t addr;
+    uint32_t* entry;
+
+    for(addr = PAGE_UP(lo); addr < hi; addr += FRAME_SIZE)
+    {
+        entry = user_pte(pcb_number, addr, 0);
+        if(entry != NULL) anon_unmap(entry, 0);
+    }
+}
@@ -0,0 +1,33 @@
+/* vmem.h - Defines for the heap, stack and anonymous memory of user processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _VMEM_H
+#define _VMEM_H
+
+#include "types.h"
+
+/* Most words on a command line, the program name included */
+#define ARGV_MAX    64
+
+/* Auxiliary vector entry type ending the vector */
+#define AT_NULL     0
+
+/* Map zeroed memory for the heap between old_brk and new_brk */
+int32_t heap_grow(uint32_t pcb_number, uint32_t old_brk, uint32_t new_brk);
+/* Free heap pages that lie entirely past new_brk */
+void heap_shrink(uint32_t pcb_number, uint32_t old_brk, uint32_t new_brk);
+/* Check that a user range lies in a region filled on first touch */
+int32_t vmem_demand(uint32_t heap_start, uint32_t address, uint32_t len);
+/* Check that the kernel can write a user range without a fatal fault */
+int32_t vmem_writable(uint32_t heap_start, uint32_t address, uint32_t len);
+/* Fill a page of the program region or stack, or copy a shared page */
+int32_t vmem_fault(uint32_t pcb_number, uint32_t heap_start, uint32_t address, uint32_t error);
+/* Lay out argc, argv and envp at the top of a new process's stack */
+uint32_t stack_args(uint32_t pcb_number, const int8_t* command, uint32_t* argc, uint32_t* argv);
+/* Map zeroed anonymous memory, 4kB pages below 4MB and 4MB pages above */
+uint32_t anon_mmap(uint32_t pcb_number, uint32_t length);
+/* Unmap anonymous memory in 4MB pages */
+int32_t anon_munmap_large(uint32_t pcb_number, uint32_t addr, uint32_t length);
+
+#endif /* _VMEM_H */
@@ -0,0 +1,46 @@
+/* wait.c - Wait queues: a process sleeps on one until another process
+ * wakes everything sleeping there
+ * vim:ts=4 noexpandtab
+ */
+
+#include "wait.h"
+#include "system_call.h"
+#include "scheduling.h"
+
+/* void wait_sleep(wait_queue_t* q)
+ * Input:  q -- queue to sleep on
+ * Return Value: none
+ * Function: Put the running process on q and run others until wait_wake.
+ * A wake-up only means the condition may have changed, so callers loop.
+ * Called and returns with interrupts off, so nothing can wake the queue
+ * between the caller's check and the sleep */
+void wait_sleep(wait_queue_t* q)
+{
+    pcb_t* pcb = get_cur_pcb();
+
+    q->pcbs |= 1 << pcb->process_number;
+    pcb->state = PROC_WAIT_QUEUE;
+    sched_sleep();
+}
+
+/* void wait_wake(wait_queue_t* q)
+ * Input:  q -- queue to empty
+ * Return Value: none
+ * Function: Make every process on q runnable again. A process that halted
+ * while on it, or whose PCB has been reused since, is left alone unless it
+ * sleeps on a queue again, where waking it early does no harm */
+void wait_wake(wait_queue_t* q)
+{
+    uint32_t i;
+    pcb_t* pcb;
+
+    if(q->pcbs == 0) return;
+    for(i = 0; i < PCB_MAX; i++)
+    {
+        if(!(q->pcbs & (1 << i))) continue;
+        pcb = get_pcb_from_id(i);
+        if(PCB_in_use(i) && pcb->state == PROC_WAIT_QUEUE) pcb->state = PROC_RUNNING;
+    }
+    q->pcbs = 0;
+    tick_restart();
+}
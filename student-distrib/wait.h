@@ -0,0 +1,22 @@
+/* wait.h - Defines for wait queues, which processes sleep on until some
+ * other process wakes them
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _WAIT_H
+#define _WAIT_H
+
+#include "types.h"
+
+/* Struct wait_queue_t
+ * pcbs : bit n set while process n sleeps on the queue */
+typedef struct {
+    volatile uint32_t pcbs;
+} wait_queue_t;
+
+/* Sleep on q until woken. The caller checks its condition again after */
+void wait_sleep(wait_queue_t* q);
+/* Wake every process sleeping on q */
+void wait_wake(wait_queue_t* q);
+
+#endif /* _WAIT_H */
@@ -16,6 +16,13 @@
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
 
+/* The kernel is linked at KERNEL_VIRTUAL_BASE + 4MB, and every page
+ * directory maps all of it from there, leaving the low 3GB to user space */
+#define KERNEL_VIRTUAL_BASE 0xC0000000
+
+/* Top of the boot stack and of the PCB and kernel stack area, 8MB physical */
+#define KERNEL_STACK_TOP    (KERNEL_VIRTUAL_BASE + 0x800000)
+
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
 
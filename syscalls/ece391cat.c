@@ -3,21 +3,117 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-int main ()
+#define BUFSIZE 1024
+#define BATCH 4			/* read/write pairs per kernel entry */
+#define RING_SIZE (2 * BATCH)
+
+static uint8_t bufs[BATCH][BUFSIZE];
+static ece391_sqe_t sqes[RING_SIZE];
+static ece391_cqe_t cqes[RING_SIZE];
+static ece391_ring_t ring;
+
+static void queue (uint8_t opcode, uint8_t flags, int32_t fd, uint8_t* buf, int32_t len, uint32_t user_data)
+{
+    ece391_sqe_t* sqe = &sqes[ring.sq_tail & (RING_SIZE - 1)];
+
+    sqe->opcode = opcode;
+    sqe->flags = flags;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)buf;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    ring.sq_tail++;
+}
+
+/*
+ * Copy fd to stdout BATCH buffers at a time, one kernel entry per batch:
+ * each read is linked to the write that follows it.  Returns 0 at end of
+ * file, -1 on a failed read or write, -2 if the kernel has no rings.
+ */
+static int32_t cat_ring (int32_t fd)
+{
+    ece391_cqe_t* cqe;
+    int32_t i, eof = 0;
+
+    ring.sq_head = ring.sq_tail = ring.cq_head = ring.cq_tail = 0;
+    ring.sq_entries = ring.cq_entries = RING_SIZE;
+    ring.sqes = sqes;
+    ring.cqes = cqes;
+    if (0 != ece391_ring_setup (&ring))
+	return -2;
+
+    while (!eof) {
+        for (i = 0; i < BATCH; i++) {
+	    queue (RING_OP_READ, 0, fd, bufs[i], BUFSIZE, 0);
+	    queue (RING_OP_WRITE, RING_F_LINK_LEN, 1, bufs[i], 0, 1);
+	}
+	if (RING_SIZE != ece391_ring_enter (RING_SIZE))
+	    return -1;
+
+	while (ring.cq_head != ring.cq_tail) {
+	    cqe = &cqes[ring.cq_head & (RING_SIZE - 1)];
+	    ring.cq_head++;
+	    if (-1 == cqe->res)
+		return -1;
+	    if (0 == cqe->user_data && 0 == cqe->res)
+		eof = 1;
+	}
+    }
+
+    return 0;
+}
+
+/*
+ * Write a regular file straight from an ece391_mmap mapping, BUFSIZE bytes
+ * per write so the kernel's terminal copy stays small.  Returns 0 when done,
+ * -1 on a failed write, -2 if the file cannot be mapped.
+ */
+static int32_t cat_mapped (int32_t fd)
+{
+    uint8_t* map;
+    uint32_t size, off, n;
+
+    if ((void*)-1 == (map = ece391_mmap (fd, &size)))
+	return -2;
+
+    for (off = 0; off < size; off += n) {
+	n = size - off < BUFSIZE ? size - off : BUFSIZE;
+	if (-1 == ece391_write (1, map + off, n)) {
+	    ece391_munmap (map, size);
+	    return -1;
+	}
+    }
+
+    ece391_munmap (map, size);
+    return 0;
+}
+
+int main (int argc, uint8_t* argv[])
 {
     int32_t fd, cnt;
     uint8_t buf[1024];
 
-    if (0 != ece391_getargs (buf, 1024)) {
+    if (argc < 2) {
         ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
 	return 3;
     }
 
-    if (-1 == (fd = ece391_open (buf))) {
+    if (-1 == (fd = ece391_open (argv[1]))) {
         ece391_fdputs (1, (uint8_t*)"file not found\n");
 	return 2;
     }
 
+    cnt = cat_mapped (fd);
+    if (-2 == cnt)
+	cnt = cat_ring (fd);
+    if (0 == cnt)
+	return 0;
+    if (-1 == cnt) {
+	ece391_fdputs (1, (uint8_t*)"file read failed\n");
+	return 3;
+    }
+
+    /* No rings: one read and one write per buffer */
     while (0 != (cnt = ece391_read (fd, buf, 1024))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
@@ -29,4 +125,3 @@ int main ()
 
     return 0;
 }
-
@@ -50,12 +50,19 @@ DO_CALL(__ece391_read,3 /* SYS_READ */);
 DO_CALL(__ece391_write,4 /* SYS_WRITE */);
 DO_CALL(__ece391_close,6 /* SYS_CLOSE */);
 
-/* Call the main() function, then halt with its return value. */
+/* Call main (argc, argv, envp) from what Linux left on the stack, then
+ * halt with its return value. */
 
 asm volatile ("                         \n\
 .GLOBAL _start                          \n\
 _start:                                 \n\
 	MOVL	%ESP,start_esp          \n\
+	MOVL	(%ESP),%EAX             \n\
+	LEAL	4(%ESP),%ECX            \n\
+	LEAL	8(%ESP,%EAX,4),%EDX     \n\
+	PUSHL	%EDX                    \n\
+	PUSHL	%ECX                    \n\
+	PUSHL	%EAX                    \n\
         CALL	main                    \n\
 	PUSHL	%EAX                    \n\
 	CALL	ece391_halt             \n\
@@ -6,19 +6,82 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
+/* Print "fname:line" with one system call, just the line for stdin */
+static void
+print_match (const char* fname, const uint8_t* line, int32_t len)
+{
+    ece391_iovec_t iov[4];
+
+    if (0 == ece391_strcmp ((uint8_t*)fname, (uint8_t*)"-")) {
+	iov[0].base = (void*)line;
+	iov[0].len = len;
+	iov[1].base = "\n";
+	iov[1].len = 1;
+	ece391_writev (1, iov, 2);
+	return;
+    }
+
+    iov[0].base = (void*)fname;
+    iov[0].len = ece391_strlen ((uint8_t*)fname);
+    iov[1].base = ":";
+    iov[1].len = 1;
+    iov[2].base = (void*)line;
+    iov[2].len = len;
+    iov[3].base = "\n";
+    iov[3].len = 1;
+    ece391_writev (1, iov, 4);
+}
+
+/* Search a file mapped with ece391_mmap in place; the mapping is read-only,
+ * so lines are delimited by length instead of by a written NUL */
+static void
+grep_mapped (const char* s, int32_t s_len, const char* fname,
+	     const uint8_t* data, int32_t size)
+{
+    int32_t line_start, line_end, check;
+
+    line_start = 0;
+    while (line_start < size) {
+	line_end = line_start;
+	while (line_end < size && '\n' != data[line_end])
+	    line_end++;
+	for (check = line_start; check + s_len <= line_end; check++) {
+	    if (s[0] == data[check] &&
+		0 == ece391_strncmp (data + check, (uint8_t*)s, s_len)) {
+		print_match (fname, data + line_start, line_end - line_start);
+		break;
+	    }
+	}
+	line_start = line_end + 1;
+    }
+}
+
 int32_t
 do_one_file (const char* s, const char* fname) 
 {
     int32_t fd, cnt, last, line_start, line_end, check, s_len;
     uint8_t data[BUFSIZE+1];
+    uint8_t* map;
+    uint32_t size;
 
     s_len = ece391_strlen ((uint8_t*)s);
-    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+    /* "-" is stdin, a pipe in "ls | grep name -" */
+    if (0 == ece391_strcmp ((uint8_t*)fname, (uint8_t*)"-")) {
+	fd = 0;
+    } else if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
         ece391_fdputs (1, (uint8_t*)"file open failed\n");
         return -1;
     }
+    if ((void*)-1 != (map = ece391_mmap (fd, &size))) {
+	grep_mapped (s, s_len, fname, map, size);
+	ece391_munmap (map, size);
+	cnt = 0;
+    } else {
+	cnt = 1;
+    }
     last = 0;
-    while (1) {
+    /* Not mappable (a device or directory): read it a buffer at a time */
+    while (0 != cnt) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
 	if (-1 == cnt) {
             ece391_fdputs (1, (uint8_t*)"file read failed\n");
@@ -42,10 +105,7 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    print_match (fname, data + line_start, line_end - line_start);
 		    break;
 		}
 	    }
@@ -58,24 +118,32 @@ do_one_file (const char* s, const char* fname)
 	if (0 == cnt)
 	    break;
     }
-    if (-1 == ece391_close (fd)) {
+    if (0 != fd && -1 == ece391_close (fd)) {
         ece391_fdputs (1, (uint8_t*)"file close failed\n");
         return -1;
     }
     return 0;
 }
 
-int main ()
+int main (int argc, uint8_t* argv[])
 {
     int32_t fd, cnt;
     uint8_t buf[SBUFSIZE];
-    uint8_t search[BUFSIZE];
+    uint8_t* search = argv[1];
 
-    if (0 != ece391_getargs (search, BUFSIZE)) {
+    if (argc < 2) {
         ece391_fdputs (1, (uint8_t*)"could not read argument\n");
         return 3;
     }
 
+    /* grep pattern file... searches just those files */
+    if (argc > 2) {
+	for (cnt = 2; cnt < argc; cnt++)
+	    if (0 != do_one_file ((char*)search, (char*)argv[cnt]))
+		return 3;
+	return 0;
+    }
+
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
 	return 2;
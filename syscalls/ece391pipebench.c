@@ -0,0 +1,135 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define TOTAL (1024 * 1024)	/* bytes per chunk size, short enough for 32 bits of TSC */
+#define MAX_CHUNK 16384
+#define RTC_HZ 8		/* the TSC is timed over one RTC period */
+#define BUFSIZE 16
+
+static uint8_t chunk_buf[MAX_CHUNK];
+static const uint32_t chunks[] = {64, 256, 1024, 4096, 16384};
+
+/* Read the time stamp counter (low 32 bits are plenty for one run) */
+static inline uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static uint32_t atou (const uint8_t* s)
+{
+    uint32_t n = 0;
+
+    while (*s >= '0' && *s <= '9')
+	n = n * 10 + (*s++ - '0');
+    return n;
+}
+
+/* TSC ticks per microsecond, from one period of the RTC, 0 without one */
+static uint32_t tsc_per_us (void)
+{
+    int32_t fd, freq = RTC_HZ, garbage;
+    uint32_t start;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"rtc")))
+	return 0;
+    ece391_write (fd, &freq, 4);
+    ece391_read (fd, &garbage, 4);
+    start = rdtsc_lo();
+    ece391_read (fd, &garbage, 4);
+    start = rdtsc_lo() - start;
+    ece391_close (fd);
+    return start / (1000000 / RTC_HZ);
+}
+
+/* Writer side, "pipebench w chunk": TOTAL bytes to stdout, chunk at a time */
+static int32_t writer (uint32_t chunk)
+{
+    uint32_t done;
+
+    if (0 == chunk || chunk > MAX_CHUNK)
+	return 2;
+    for (done = 0; done < TOTAL; done += chunk)
+	if ((int32_t)chunk != ece391_write (1, chunk_buf, chunk))
+	    return 3;
+    return 0;
+}
+
+/* Move TOTAL bytes from a spawned writer through a pipe; returns the
+   microseconds from the first byte to the last, 0 on failure */
+static uint32_t run (uint32_t chunk, uint32_t per_us)
+{
+    uint8_t cmd[32];
+    uint8_t num[BUFSIZE];
+    int32_t fds[2], pid, cnt, status;
+    uint32_t got, start;
+
+    ece391_strcpy (cmd, (uint8_t*)"pipebench w ");
+    ece391_strcpy (cmd + ece391_strlen (cmd), ece391_itoa (chunk, num, 10));
+
+    /* The writer inherits the write end as its stdout */
+    if (-1 == ece391_pipe (fds))
+	return 0;
+    ece391_dup2 (1, 7);
+    ece391_dup2 (fds[1], 1);
+    pid = ece391_spawn (cmd);
+    ece391_dup2 (7, 1);
+    ece391_close (7);
+    ece391_close (fds[1]);
+    if (-1 == pid) {
+	ece391_close (fds[0]);
+	return 0;
+    }
+
+    /* Start the clock once the writer is running */
+    got = ece391_read (fds[0], chunk_buf, chunk);
+    start = rdtsc_lo();
+    while (0 < (cnt = ece391_read (fds[0], chunk_buf, chunk)))
+	got += cnt;
+    start = rdtsc_lo() - start;
+
+    ece391_close (fds[0]);
+    ece391_waitpid (pid, &status, 0);
+    if (TOTAL != got || 0 != status)
+	return 0;
+    start /= per_us;
+    return start ? start : 1;
+}
+
+static void print_num (uint32_t n)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, ece391_itoa (n, buf, 10));
+}
+
+int main (int argc, uint8_t* argv[])
+{
+    uint32_t per_us, us, i;
+
+    if (argc > 2 && 0 == ece391_strcmp (argv[1], (uint8_t*)"w"))
+	return writer (atou (argv[2]));
+
+    if (0 == (per_us = tsc_per_us ())) {
+	ece391_fdputs (1, (uint8_t*)"could not time the TSC\n");
+	return 2;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"chunk\tMB/s\n");
+    for (i = 0; i < sizeof (chunks) / sizeof (chunks[0]); i++) {
+	print_num (chunks[i]);
+	ece391_fdputs (1, (uint8_t*)"\t");
+	if (0 == (us = run (chunks[i], per_us))) {
+	    ece391_fdputs (1, (uint8_t*)"failed\n");
+	    continue;
+	}
+	/* bytes per microsecond is MB/s */
+	print_num (TOTAL / us);
+	ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
@@ -4,15 +4,30 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 3		/* a terminal has 4 processes, one is the shell */
+#define TOO_MANY (-2)
+#define SAVE_IN 6		/* where the shell keeps its own stdin and */
+#define SAVE_OUT 7		/* stdout while it wires up a pipeline */
+
+static void report (int32_t rval);
+static void job_done (int32_t pid, int32_t rval);
+static int32_t background (uint8_t* buf, int32_t cnt);
+static int32_t split (uint8_t* buf, uint8_t* stage[]);
+static void pipeline (uint8_t* stage[], int32_t n, int32_t bg);
 
 int main ()
 {
 
-    int32_t cnt, rval;
+    int32_t cnt, rval, pid, n, bg;
     uint8_t buf[BUFSIZE];
+    uint8_t* stage[MAX_STAGES];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+	/* Report the background jobs that finished since the last prompt */
+	while (0 < (pid = ece391_waitpid (-1, &rval, WNOHANG)))
+	    job_done (pid, rval);
+
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -23,15 +38,183 @@ int main ()
 	buf[cnt] = '\0';
 	if (0 == ece391_strcmp (buf, (uint8_t*)"exit"))
 	    return 0;
+	if (0 == ece391_strcmp (buf, (uint8_t*)"wait")) {
+	    while (0 < (pid = ece391_waitpid (-1, &rval, 0)))
+		job_done (pid, rval);
+	    continue;
+	}
 	if ('\0' == buf[0])
 	    continue;
+
+	/* "cmd args &" runs in the background, the prompt comes back at once */
+	bg = background (buf, cnt);
+
+	/* "a | b | c" runs the stages at the same time, joined by pipes */
+	if (1 < (n = split (buf, stage))) {
+	    pipeline (stage, n, bg);
+	    continue;
+	}
+	if (-1 == n) {
+	    ece391_fdputs (1, (uint8_t*)"bad pipeline\n");
+	    continue;
+	}
+	if (TOO_MANY == n) {
+	    ece391_fdputs (1, (uint8_t*)"too many stages\n");
+	    continue;
+	}
+
+	if (bg) {
+	    if ('\0' == buf[0])
+		continue;
+	    if (-1 == (pid = ece391_spawn (buf))) {
+		ece391_fdputs (1, (uint8_t*)"no such command\n");
+		continue;
+	    }
+	    ece391_fdputs (1, (uint8_t*)"[");
+	    ece391_fdputs (1, ece391_itoa (pid, buf, 10));
+	    ece391_fdputs (1, (uint8_t*)"]\n");
+	    continue;
+	}
+
 	rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
-	else if (256 == rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
-	else if (0 != rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+	else
+	    report (rval);
+    }
+}
+
+/* Strip a trailing '&' and the spaces around it; nonzero if there was one */
+static int32_t
+background (uint8_t* buf, int32_t cnt)
+{
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+	cnt--;
+    if (0 == cnt || '&' != buf[cnt - 1])
+	return 0;
+    cnt--;
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+	cnt--;
+    buf[cnt] = '\0';
+    return 1;
+}
+
+/* Cut buf at each '|' with the spaces around it; returns the number of
+   stages, -1 if one is empty, or TOO_MANY past MAX_STAGES */
+static int32_t
+split (uint8_t* buf, uint8_t* stage[])
+{
+    int32_t n = 0;
+    uint8_t* end;
+
+    while (1) {
+	while (' ' == *buf)
+	    buf++;
+	if (MAX_STAGES == n)
+	    return TOO_MANY;
+	stage[n++] = buf;
+	while ('\0' != *buf && '|' != *buf)
+	    buf++;
+	for (end = buf; end > stage[n - 1] && ' ' == end[-1]; end--);
+	if (end == stage[n - 1] && (1 < n || '|' == *buf))
+	    return -1;
+	if ('\0' == *buf) {
+	    *end = '\0';
+	    return n;
+	}
+	*end = '\0';
+	buf++;
     }
 }
 
+/* Run the stages with each one's stdout piped into the next one's stdin.
+   The shell points its own fds 0 and 1 at the right ends before starting
+   each stage, which the stage inherits, and keeps none of them after.
+   All but the last are spawned; the last runs with execute unless the
+   whole pipeline is in the background. If a stage cannot be started the
+   ones before it lose their pipe ends, run out, and are reaped. */
+static void
+pipeline (uint8_t* stage[], int32_t n, int32_t bg)
+{
+    int32_t pid[MAX_STAGES];
+    int32_t fds[2];
+    int32_t i, rval;
+    uint8_t num[12];
+
+    ece391_dup2 (0, SAVE_IN);
+    ece391_dup2 (1, SAVE_OUT);
+    for (i = 0; i < n; i++) {
+	pid[i] = -1;
+	if (i < n - 1) {
+	    if (-1 == ece391_pipe (fds)) {
+		ece391_fdputs (SAVE_OUT, (uint8_t*)"pipe failed\n");
+		n = i;
+		break;
+	    }
+	    ece391_dup2 (fds[1], 1);
+	    ece391_close (fds[1]);
+	} else {
+	    ece391_dup2 (SAVE_OUT, 1);
+	}
+
+	if (i < n - 1 || bg) {
+	    if (-1 == (pid[i] = ece391_spawn (stage[i]))) {
+		ece391_fdputs (SAVE_OUT, (uint8_t*)"no such command, or no free process\n");
+		if (i < n - 1)
+		    ece391_close (fds[0]);
+		n = i;
+		bg = 0;
+		break;
+	    }
+	} else {
+	    rval = ece391_execute (stage[i]);
+	    if (-1 == rval)
+		ece391_fdputs (SAVE_OUT, (uint8_t*)"no such command\n");
+	    else
+		report (rval);
+	}
+
+	if (i < n - 1) {
+	    ece391_dup2 (fds[0], 0);
+	    ece391_close (fds[0]);
+	}
+    }
+    ece391_dup2 (SAVE_IN, 0);
+    ece391_dup2 (SAVE_OUT, 1);
+    ece391_close (SAVE_IN);
+    ece391_close (SAVE_OUT);
+
+    for (i = 0; i < n; i++) {
+	if (-1 == pid[i])
+	    continue;
+	if (bg) {
+	    ece391_fdputs (1, (uint8_t*)"[");
+	    ece391_fdputs (1, ece391_itoa (pid[i], num, 10));
+	    ece391_fdputs (1, (uint8_t*)"]\n");
+	} else if (-1 != ece391_waitpid (pid[i], &rval, 0)) {
+	    report (rval);
+	}
+    }
+}
+
+/* Print how a background job ended */
+static void
+job_done (int32_t pid, int32_t rval)
+{
+    uint8_t num[12];
+
+    ece391_fdputs (1, (uint8_t*)"[");
+    ece391_fdputs (1, ece391_itoa (pid, num, 10));
+    ece391_fdputs (1, (uint8_t*)"] done\n");
+    report (rval);
+}
+
+/* Complain about a program that did not return 0 */
+static void
+report (int32_t rval)
+{
+    if (256 == rval)
+	ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
+    else if (0 != rval)
+	ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+}
@@ -10,17 +10,17 @@ static volatile uint8_t* badbuf = 0;
 void segfault_sighandler (int signum);
 void alarm_sighandler (int signum);
 
-int main ()
+int main (int argc, uint8_t* argv[])
 {
     int32_t cnt;
     uint8_t buf[BUFSIZE];
 
-    if (0 != ece391_getargs (buf, BUFSIZE)) {
+    if (argc < 2) {
         ece391_fdputs (1, (uint8_t*)"could not read argument\n");
 	return 3;
     }
 
-	if (buf[0] == '1') {
+	if (argv[1][0] == '1') {
 		ece391_fdputs(1, (uint8_t*)"Installing signal handlers\n");
 		ece391_set_handler(SEGFAULT, segfault_sighandler);
 		ece391_set_handler(ALARM, alarm_sighandler);
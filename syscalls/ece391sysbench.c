@@ -0,0 +1,58 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ITERATIONS 10000
+#define BUFSIZE 16
+
+/* Read the time stamp counter (low 32 bits are plenty for one run) */
+static inline uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* Average cycles of one null system call on the current entry path */
+static uint32_t time_null_call (void)
+{
+    uint32_t i, start;
+
+    start = rdtsc_lo();
+    for (i = 0; i < ITERATIONS; i++)
+        ece391_null();
+    return (rdtsc_lo() - start) / ITERATIONS;
+}
+
+static void print_result (const char* label, uint32_t cycles)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs(1, (uint8_t*)label);
+    ece391_itoa(cycles, buf, 10);
+    ece391_fdputs(1, buf);
+    ece391_fdputs(1, (uint8_t*)" cycles\n");
+}
+
+int main ()
+{
+    uint8_t have_sysenter = ece391_sysenter_ok;
+    uint32_t int80, fast;
+
+    ece391_sysenter_ok = 0;
+    int80 = time_null_call();
+    print_result("int $0x80 null call: ", int80);
+
+    if (!have_sysenter) {
+        ece391_fdputs(1, (uint8_t*)"sysenter not supported by this CPU\n");
+        return 0;
+    }
+
+    ece391_sysenter_ok = 1;
+    fast = time_null_call();
+    print_result("sysenter null call:  ", fast);
+    print_result("saved per call:      ", int80 > fast ? int80 - fast : 0);
+
+    return 0;
+}
@@ -17,10 +17,133 @@ extern int32_t ece391_read (int32_t fd, void* buf, int32_t nbytes);
 extern int32_t ece391_write (int32_t fd, const void* buf, int32_t nbytes);
 extern int32_t ece391_open (const uint8_t* filename);
 extern int32_t ece391_close (int32_t fd);
+/*
+ * _start calls main (int argc, uint8_t* argv[], uint8_t* envp[]). argv[0]
+ * is the program name, argv[argc] and the end of envp are NULL. There are
+ * no environment variables yet, so envp is empty. ece391_getargs is kept
+ * for older programs: it joins argv[1] on with single spaces, and fails if
+ * there are none or they do not fit in nbytes with the NULL.
+ */
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_null (void);
+
+/*
+ * Batched I/O. The program fills in an ece391_ring_t with two power-of-two
+ * arrays in its own memory and registers it with ece391_ring_setup. It then
+ * queues operations at sq_tail and calls ece391_ring_enter, which runs up to
+ * to_submit of them in order and posts one completion each at cq_tail.
+ * Returns the number of submissions consumed.
+ */
+#define RING_OP_NOP     0
+#define RING_OP_READ    1
+#define RING_OP_WRITE   2
+#define RING_OP_OPEN    3
+#define RING_OP_CLOSE   4
+
+/* Take the length (or fd) from the previous entry's result in the same
+ * ece391_ring_enter; a length link after a result of 0 or less completes
+ * with 0 without running, an fd link after a failure completes with -1. */
+#define RING_F_LINK_LEN 0x1
+#define RING_F_LINK_FD  0x2
+
+typedef struct {
+	uint8_t  opcode;
+	uint8_t  flags;
+	uint16_t reserved;
+	int32_t  fd;
+	uint32_t addr;
+	int32_t  len;
+	uint32_t user_data;
+} ece391_sqe_t;
+
+typedef struct {
+	uint32_t user_data;
+	int32_t  res;
+} ece391_cqe_t;
+
+typedef struct {
+	volatile uint32_t sq_head;	/* advanced by the kernel */
+	volatile uint32_t sq_tail;	/* advanced by the program */
+	volatile uint32_t cq_head;	/* advanced by the program */
+	volatile uint32_t cq_tail;	/* advanced by the kernel */
+	uint32_t sq_entries;
+	uint32_t cq_entries;
+	ece391_sqe_t* sqes;
+	ece391_cqe_t* cqes;
+} ece391_ring_t;
+
+extern int32_t ece391_ring_setup (ece391_ring_t* ring);
+extern int32_t ece391_ring_enter (uint32_t to_submit);
+
+/*
+ * Vectored I/O. ece391_readv fills the buffers in order and ece391_writev
+ * writes them in order, each with one system call. At most IOV_MAX buffers;
+ * both return the total number of bytes moved, -1 on error.
+ */
+#define IOV_MAX 16
+
+typedef struct {
+	void*    base;
+	uint32_t len;
+} ece391_iovec_t;
+
+extern int32_t ece391_readv (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const ece391_iovec_t* iov, int32_t iovcnt);
+
+/*
+ * Map an open file read-only, without copying, and store its size in
+ * *length. Returns the address of the mapping, or (void*)-1 on failure
+ * (the file is not a regular file or the mapping window is full). Reading
+ * past the size but inside the last 4kB page is allowed; the contents there
+ * are unspecified. Mappings are dropped by ece391_munmap or at halt.
+ *
+ * With fd MAP_ANONYMOUS, maps *length bytes of zeroed read/write memory
+ * instead (in 4MB pages when *length is at least 4MB).
+ */
+#define MAP_ANONYMOUS (-1)
+extern void* ece391_mmap (int32_t fd, uint32_t* length);
+extern int32_t ece391_munmap (void* addr, uint32_t length);
+
+/*
+ * Move the end of the heap by increment bytes and return the old end, or
+ * (void*)-1 on failure. ece391_sbrk(0) returns the current end. New heap
+ * memory is zeroed. The heap starts after the program's .bss and can grow
+ * up to 1GB (HEAP_END, 0x40000000), nearly 900MB for a program at 0x08048000.
+ */
+extern void* ece391_sbrk (int32_t increment);
+
+/*
+ * Start a program like ece391_execute, but return its PID at once. It runs
+ * alongside the caller in the same terminal; its reads of stdin return 0.
+ * ece391_waitpid reaps a spawned child that has halted (pid -1 for any) and
+ * returns its PID, storing what ece391_execute would have returned in
+ * *status unless status is NULL. It sleeps until one halts, unless options
+ * is WNOHANG, in which case it returns 0 if none has. It returns -1 if
+ * there is no such child. Children left by a halting parent are freed when
+ * they halt.
+ */
+#define WNOHANG 1
+extern int32_t ece391_spawn (const uint8_t* command);
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+
+/*
+ * ece391_pipe opens the read end of a new 4kB pipe in fds[0] and the write
+ * end in fds[1]. A read sleeps while the pipe is empty and returns what is
+ * there; it returns 0 once every write end is closed. A write sleeps while
+ * the pipe is full until all of it is in, and fails once every read end is
+ * closed. ece391_dup2 closes newfd if it is open, stdin and stdout
+ * included, and makes it a copy of oldfd. Children from ece391_execute and
+ * ece391_spawn start with the caller's fds 0 and 1.
+ */
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_dup2 (int32_t oldfd, int32_t newfd);
+
+/* Nonzero when the wrappers enter the kernel with SYSENTER instead of
+ * INT $0x80; a program may clear it to force the old path. */
+extern uint8_t ece391_sysenter_ok;
 
 enum signums {
 	DIV_ZERO = 0,
@@ -11,5 +11,20 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_RING_SETUP 11
+#define SYS_RING_ENTER 12
+#define SYS_READV 13
+#define SYS_WRITEV 14
+#define SYS_MMAP 15
+#define SYS_MUNMAP 16
+#define SYS_SBRK 17
+#define SYS_SPAWN 18
+#define SYS_WAITPID 19
+#define SYS_PIPE 20
+#define SYS_DUP2 21
+
+/* Not a system call: the kernel rejects number 0 right after entry, which
+ * makes it a null call for timing the entry and exit paths */
+#define SYS_NULL    0
 
 #endif /* ECE391SYSNUM_H */